@@ -30,9 +30,29 @@
 #include "hd-clutter-cache.h"
 #include "hd-render-manager.h"
 
-struct _HdClutterCachePrivate
+/* Cached textures are indexed by their resolved (interned) path. Each
+ * entry counts the actors (clones, sub-textures, groups) we have handed
+ * out that still use its texture; once that drops to zero the entry
+ * moves to the unused queue and may be evicted. */
+typedef struct
 {
+  const gchar  *path;
+  ClutterActor *texture;
+  guint         refcount;
+} HdClutterCacheEntry;
 
+struct _HdClutterCachePrivate
+{
+  /* interned path -> HdClutterCacheEntry */
+  GHashTable *entries;
+  /* interned theme filename -> interned path it resolved to, so the
+   * theme/fallback decision is only made once per filename */
+  GHashTable *theme_paths;
+  /* entries nobody references, most recently released first */
+  GQueue      unused;
+  guint       trim_cb;
+
+  guint       hits, misses, evictions;
 };
 
 /* ------------------------------------------------------------------------- */
@@ -49,14 +69,31 @@ static HdClutterCache *the_clutter_cache = 0;
 #define HD_CLUTTER_CACHE_THEME_PATH "/etc/hildon/theme/images/"
 #define HD_CLUTTER_CACHE_FALLBACK_THEME_PATH "/usr/share/themes/default/images/"
 
+/* How many unreferenced textures we keep around in case they are asked
+ * for again (eg. when the switcher is reopened). */
+#define HD_CLUTTER_CACHE_MAX_UNUSED 16
+
 /* ------------------------------------------------------------------------- */
 
+static void
+hd_clutter_cache_entry_free (HdClutterCacheEntry *entry)
+{
+  if (entry->texture)
+    clutter_actor_destroy (entry->texture);
+  g_slice_free (HdClutterCacheEntry, entry);
+}
+
 static void
 hd_clutter_cache_init (HdClutterCache *cache)
 {
   ClutterActor *stage;
- /* HdClutterCachePrivate *priv = cache->priv =
-    HD_CLUTTER_CACHE_GET_PRIVATE(cache);*/
+  HdClutterCachePrivate *priv = cache->priv =
+    HD_CLUTTER_CACHE_GET_PRIVATE(cache);
+
+  priv->entries = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                       (GDestroyNotify)hd_clutter_cache_entry_free);
+  priv->theme_paths = g_hash_table_new (g_direct_hash, g_direct_equal);
+  g_queue_init (&priv->unused);
 
   clutter_actor_hide(CLUTTER_ACTOR(cache));
   clutter_actor_set_name(CLUTTER_ACTOR(cache), "HdClutterCache");
@@ -70,6 +107,25 @@ hd_clutter_cache_init (HdClutterCache *cache)
 static void
 hd_clutter_cache_dispose (GObject *obj)
 {
+  HdClutterCachePrivate *priv = HD_CLUTTER_CACHE (obj)->priv;
+
+  if (priv->trim_cb)
+    {
+      g_source_remove (priv->trim_cb);
+      priv->trim_cb = 0;
+    }
+  g_queue_clear (&priv->unused);
+  if (priv->entries)
+    {
+      g_hash_table_destroy (priv->entries);
+      priv->entries = NULL;
+    }
+  if (priv->theme_paths)
+    {
+      g_hash_table_destroy (priv->theme_paths);
+      priv->theme_paths = NULL;
+    }
+
   G_OBJECT_CLASS (hd_clutter_cache_parent_class)->dispose (obj);
 }
 
@@ -78,6 +134,8 @@ hd_clutter_cache_class_init (HdClutterCacheClass *klass)
 {
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
 
+  g_type_class_add_private (klass, sizeof (HdClutterCachePrivate));
+
   gobject_class->dispose = hd_clutter_cache_dispose;
 }
 
@@ -89,87 +147,152 @@ static HdClutterCache *hd_get_clutter_cache()
   return the_clutter_cache;
 }
 
-static ClutterActor *
-hd_clutter_cache_get_real_texture(const char *filename, gboolean from_theme)
+static void
+hd_clutter_cache_evict (HdClutterCache *cache, HdClutterCacheEntry *entry)
+{
+  g_queue_remove (&cache->priv->unused, entry);
+  cache->priv->evictions++;
+  /* Frees @entry and destroys its texture. */
+  g_hash_table_remove (cache->priv->entries, entry->path);
+}
+
+static gboolean
+hd_clutter_cache_trim (gpointer data)
+{
+  HdClutterCache *cache = HD_CLUTTER_CACHE (data);
+
+  cache->priv->trim_cb = 0;
+  while (g_queue_get_length (&cache->priv->unused)
+         > HD_CLUTTER_CACHE_MAX_UNUSED)
+    hd_clutter_cache_evict (cache, g_queue_peek_tail (&cache->priv->unused));
+
+  return FALSE;
+}
+
+/* Called when an actor built on a cached texture goes away.  We're given
+ * the interned path rather than the entry, so it's safe even if the entry
+ * (or the whole cache) is gone by then. */
+static void
+hd_clutter_cache_actor_gone (gpointer path, GObject *actor)
+{
+  HdClutterCacheEntry *entry;
+  HdClutterCachePrivate *priv;
+
+  if (!the_clutter_cache)
+    return;
+  priv = the_clutter_cache->priv;
+  if (!priv->entries || !(entry = g_hash_table_lookup (priv->entries, path)))
+    return;
+
+  g_return_if_fail (entry->refcount > 0);
+  if (--entry->refcount > 0)
+    return;
+
+  g_queue_push_head (&priv->unused, entry);
+  /* Don't destroy textures from within someone else's destruction. */
+  if (!priv->trim_cb
+      && g_queue_get_length (&priv->unused) > HD_CLUTTER_CACHE_MAX_UNUSED)
+    priv->trim_cb = g_idle_add (hd_clutter_cache_trim, the_clutter_cache);
+}
+
+/* Account @actor as a user of @entry's texture until it's finalized. */
+static void
+hd_clutter_cache_entry_ref_for (HdClutterCacheEntry *entry,
+                                ClutterActor *actor)
+{
+  if (entry->refcount++ == 0)
+    g_queue_remove (&the_clutter_cache->priv->unused, entry);
+  g_object_weak_ref (G_OBJECT (actor), hd_clutter_cache_actor_gone,
+                     (gpointer)entry->path);
+}
+
+/* Returns the entry cached for @path or loads it.  @path must be interned. */
+static HdClutterCacheEntry *
+hd_clutter_cache_load (HdClutterCache *cache, const gchar *path)
+{
+  HdClutterCacheEntry *entry;
+  ClutterActor *texture;
+
+  if ((entry = g_hash_table_lookup (cache->priv->entries, path)) != NULL)
+    return entry;
+
+  texture = clutter_texture_new_from_file(path, 0);
+  if (!texture)
+    return NULL;
+
+  clutter_actor_set_name(texture, path);
+  clutter_actor_add_child (CLUTTER_ACTOR(cache), texture);
+
+  entry = g_slice_new0 (HdClutterCacheEntry);
+  entry->path = path;
+  entry->texture = texture;
+  g_hash_table_insert (cache->priv->entries, (gpointer)path, entry);
+
+  /* Nobody uses it yet. */
+  g_queue_push_head (&cache->priv->unused, entry);
+  return entry;
+}
+
+static const gchar *
+hd_clutter_cache_intern_path (const char *dir, const char *filename)
+{
+  gchar *path;
+  const gchar *interned;
+
+  path = g_strconcat (dir, filename, NULL);
+  interned = g_intern_string (path);
+  g_free (path);
+  return interned;
+}
+
+static HdClutterCacheEntry *
+hd_clutter_cache_get_entry(const char *filename, gboolean from_theme)
 {
   HdClutterCache *cache = hd_get_clutter_cache();
-  gint i;
-  ClutterActor *texture, *actor;
-  const char *filename_real = filename;
-  char *filename_alloc = 0;
+  HdClutterCachePrivate *priv;
+  HdClutterCacheEntry *entry;
+  const gchar *key, *path;
 
   if (!cache)
     return 0;
+  priv = cache->priv;
 
-  if (from_theme)
-    {
-      const char *theme_path;
-
-      /*
-       * If the theme is broken we have to use the fallback theme path.
-       */
-      theme_path = mb_wm_theme_is_broken () ?
-	      HD_CLUTTER_CACHE_FALLBACK_THEME_PATH :
-	      HD_CLUTTER_CACHE_THEME_PATH;
-
-      filename_alloc = g_malloc(strlen(theme_path) + strlen(filename) + 1);
-      if (!filename_alloc)
-        return 0;
-      strcpy(filename_alloc, theme_path);
-      strcat(filename_alloc, filename);
-      filename_real = filename_alloc;
-    }
-
-  for (i = 0, actor = clutter_group_get_nth_child(CLUTTER_GROUP(cache), 0);
-       actor; actor = clutter_group_get_nth_child(CLUTTER_GROUP(cache), ++i))
+  key = g_intern_string (filename);
+  path = from_theme ? g_hash_table_lookup (priv->theme_paths, key) : key;
+  if (path && (entry = g_hash_table_lookup (priv->entries, path)) != NULL)
     {
-      const char *name = clutter_actor_get_name(actor);
-      if (name && g_str_equal(name, filename_real))
-        {
-          if (filename_alloc)
-	    g_free(filename_alloc);
-          return actor;
-        }
+      priv->hits++;
+      return entry;
     }
 
-  texture = clutter_texture_new_from_file(filename_real, 0);
-  if (!texture)
+  priv->misses++;
+  if (!from_theme || path)
+    return hd_clutter_cache_load (cache, path);
+
+  /*
+   * If the theme is broken we have to use the fallback theme path.
+   */
+  path = hd_clutter_cache_intern_path (mb_wm_theme_is_broken ()
+                                       ? HD_CLUTTER_CACHE_FALLBACK_THEME_PATH
+                                       : HD_CLUTTER_CACHE_THEME_PATH,
+                                       filename);
+  entry = hd_clutter_cache_load (cache, path);
+
+  /*
+   * If this was the fallback theme path we can not anything else,
+   * othwerwise we still can try to load from the fallback path.
+   */
+  if (!entry && !mb_wm_theme_is_broken ())
     {
-      if (filename_alloc)
-        g_free(filename_alloc);
-
-      /*
-       * If this was the fallback theme path we can not anything else,
-       * othwerwise we still can try to load from the fallback path.
-       */
-      if (mb_wm_theme_is_broken())
-        return 0;
-
-      filename_alloc = g_malloc (strlen(HD_CLUTTER_CACHE_FALLBACK_THEME_PATH) +
-                                 strlen(filename) + 1);
-      if (!filename_alloc)
-        return 0;
-
-      strcpy(filename_alloc, HD_CLUTTER_CACHE_FALLBACK_THEME_PATH);
-      strcat(filename_alloc, filename);
-      filename_real = filename_alloc;
-
-      texture = clutter_texture_new_from_file(filename_real, 0);
-      if (!texture)
-        {
-          if (filename_alloc)
-            g_free(filename_alloc);
-          return 0;
-        }
+      path = hd_clutter_cache_intern_path (HD_CLUTTER_CACHE_FALLBACK_THEME_PATH,
+                                           filename);
+      entry = hd_clutter_cache_load (cache, path);
     }
 
-  clutter_actor_set_name(texture, filename_real);
-  clutter_actor_add_child (CLUTTER_ACTOR(cache), texture);
+  if (entry)
+    g_hash_table_insert (priv->theme_paths, (gpointer)key, (gpointer)path);
 
-  if (filename_alloc)
-    g_free(filename_alloc);
-
-  return texture;
+  return entry;
 }
 
 /* Returns an actor representing a broken texture.
@@ -185,12 +308,17 @@ hd_clutter_cache_get_broken_texture()
 ClutterActor *
 hd_clutter_cache_get_texture(const char *filename, gboolean from_theme)
 {
-  ClutterActor *texture = hd_clutter_cache_get_real_texture(filename,
-                                                            from_theme);
-  if (!texture)
+  HdClutterCacheEntry *entry;
+  ClutterActor *texture;
+
+  entry = hd_clutter_cache_get_entry(filename, from_theme);
+  if (!entry)
     texture = hd_clutter_cache_get_broken_texture();
   else
-    texture = clutter_clone_new(texture);
+    {
+      texture = clutter_clone_new(entry->texture);
+      hd_clutter_cache_entry_ref_for(entry, texture);
+    }
   clutter_actor_set_name(texture, filename);
   return texture;
 }
@@ -202,12 +330,10 @@ hd_clutter_cache_get_sub_texture(const char *filename,
 {
   ClutterActor *texture;
   TidySubTexture *tex;
-  HdClutterCache *cache = hd_get_clutter_cache();
-  if (!cache)
-    return 0;
+  HdClutterCacheEntry *entry;
 
-  texture = hd_clutter_cache_get_real_texture(filename, from_theme);
-  if (!texture)
+  entry = hd_clutter_cache_get_entry(filename, from_theme);
+  if (!entry)
     {
       texture = hd_clutter_cache_get_broken_texture(filename);
       clutter_actor_set_name(texture, filename);
@@ -215,7 +341,8 @@ hd_clutter_cache_get_sub_texture(const char *filename,
       return texture;
     }
 
-  tex = tidy_sub_texture_new(CLUTTER_TEXTURE(texture));
+  tex = tidy_sub_texture_new(CLUTTER_TEXTURE(entry->texture));
+  hd_clutter_cache_entry_ref_for(entry, CLUTTER_ACTOR(tex));
   tidy_sub_texture_set_region(tex, geo);
   clutter_actor_set_name(CLUTTER_ACTOR(tex), filename);
   clutter_actor_set_position(CLUTTER_ACTOR(tex), 0, 0);
@@ -249,14 +376,14 @@ hd_clutter_cache_get_sub_texture_for_area(const char *filename,
 {
   gboolean extend_x, extend_y;
   gint low_x, low_y, high_x, high_y;
+  HdClutterCacheEntry *entry;
   ClutterTexture *texture = 0;
   ClutterGroup *group = 0;
   ClutterGeometry geo = *geo_;
   gint x,y;
 
-  texture = CLUTTER_TEXTURE(hd_clutter_cache_get_real_texture(filename,
-                                                              from_theme));
-  if (!texture)
+  entry = hd_clutter_cache_get_entry(filename, from_theme);
+  if (!entry)
     {
       ClutterActor *actor = hd_clutter_cache_get_broken_texture();
       clutter_actor_set_name(actor, filename);
@@ -264,6 +391,7 @@ hd_clutter_cache_get_sub_texture_for_area(const char *filename,
       clutter_actor_set_size(actor, area->width, area->height);
       return actor;
     }
+  texture = CLUTTER_TEXTURE(entry->texture);
 
   if (geo.width==0 || geo.height==0)
     {
@@ -291,6 +419,7 @@ hd_clutter_cache_get_sub_texture_for_area(const char *filename,
 
   group = CLUTTER_GROUP(clutter_group_new());
   clutter_actor_set_name(CLUTTER_ACTOR(group), filename);
+  hd_clutter_cache_entry_ref_for(entry, CLUTTER_ACTOR(group));
   if (extend_x)
     {
       low_x = geo.x + (geo.width/4);
@@ -375,28 +504,49 @@ hd_clutter_cache_get_sub_texture_for_area(const char *filename,
   return CLUTTER_ACTOR(group);
 }
 
-static void
-reload_texture_cb (ClutterActor *child,
-                   gpointer      data)
-{
-  gchar *filename;
-  if (!CLUTTER_IS_TEXTURE(child))
-    return;
-
-  /* filename is set in the child's name. clutter_texture_set_from_file sets
-   * the anme to this string, but the string is from the actor in the first
-   * place and it just breaks... */
-  filename = g_strdup(clutter_actor_get_name(child));
-  clutter_texture_set_from_file(CLUTTER_TEXTURE(child), filename, 0);
-  g_free(filename);
-}
-
 void hd_clutter_cache_theme_changed(void) {
+  HdClutterCachePrivate *priv;
+  HdClutterCacheEntry *entry;
+  GHashTableIter iter;
+
   /* If there is no clutter cache yet then we definitely
    * don't care about reloading stuff */
   if (!the_clutter_cache)
     return;
+  priv = the_clutter_cache->priv;
 
-  clutter_container_foreach (CLUTTER_CONTAINER(the_clutter_cache),
-                             reload_texture_cb, 0);
+  /* Nobody would see the unused ones, so rather than reloading them
+   * just drop them.  They'll be loaded again if needed. */
+  while ((entry = g_queue_peek_head (&priv->unused)) != NULL)
+    hd_clutter_cache_evict (the_clutter_cache, entry);
+
+  /* The theme may have become (un)broken, so resolve filenames again. */
+  g_hash_table_remove_all (priv->theme_paths);
+
+  g_hash_table_iter_init (&iter, priv->entries);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&entry))
+    clutter_texture_set_from_file(CLUTTER_TEXTURE(entry->texture),
+                                  entry->path, 0);
+}
+
+#ifndef G_DEBUG_DISABLE
+void
+hd_clutter_cache_dump_debug_info (void)
+{
+  HdClutterCachePrivate *priv;
+  HdClutterCacheEntry *entry;
+  GHashTableIter iter;
+
+  if (!the_clutter_cache)
+    return;
+  priv = the_clutter_cache->priv;
+
+  g_debug ("%s: %u textures (%u unused), %u hits, %u misses, %u evictions",
+           __FUNCTION__, g_hash_table_size (priv->entries),
+           g_queue_get_length (&priv->unused),
+           priv->hits, priv->misses, priv->evictions);
+  g_hash_table_iter_init (&iter, priv->entries);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&entry))
+    g_debug ("\t%s: refcount=%u", entry->path, entry->refcount);
 }
+#endif /* G_DEBUG_DISABLE */
@@ -90,4 +90,9 @@ hd_clutter_cache_get_sub_texture_for_area(const char *filename,
                                           ClutterGeometry *geo,
                                           ClutterGeometry *area);
 
+#ifndef G_DEBUG_DISABLE
+/* Logs the cached textures and the hit/miss/eviction counters. */
+void hd_clutter_cache_dump_debug_info (void);
+#endif /* G_DEBUG_DISABLE */
+
 #endif
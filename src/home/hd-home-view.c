@@ -35,6 +35,7 @@
 #include "hd-render-manager.h"
 #include "hd-clutter-cache.h"
 #include "hd-transition.h"
+#include "hd-image-loader.h"
 
 #include "hildon-desktop.h"
 #include "../tidy/tidy-sub-texture.h"
@@ -110,6 +111,8 @@ struct _HdHomeViewPrivate
   guint                     id;
 
   guint load_background_source;
+  HdImageLoaderJob *load_background_job;
+  gboolean load_background_portrait;
 
   GConfClient *gconf_client;
 
@@ -444,6 +447,8 @@ hd_home_view_dispose (GObject *object)
   /* Remove idle/timeout handlers */
   if (priv->load_background_source)
     priv->load_background_source = (g_source_remove (priv->load_background_source), 0);
+  if (priv->load_background_job)
+    priv->load_background_job = (hd_image_loader_cancel (priv->load_background_job), NULL);
 
   if (priv->gconf_client)
     priv->gconf_client = (g_object_unref (priv->gconf_client), NULL);
@@ -558,182 +563,122 @@ set_background_common (HdHomeView *hview, ClutterActor *new_bg)
     
 }
 
-static gboolean
-load_background_idle (gpointer data)
+static void load_background (HdHomeView *self, gboolean portrait);
+
+/* Sets @new_bg as the landscape or @portrait background, then starts
+ * loading the portrait one if it's needed. */
+static void
+background_loaded (HdHomeView *self, gboolean portrait,
+                   ClutterActor *new_bg, const gchar *fname,
+                   const GError *error)
+{
+  HdHomeViewPrivate *priv = self->priv;
+
+  if (!new_bg)
+    g_warning ("Error loading cached %sbackground image %s. %s",
+               portrait ? "portrait " : "", fname,
+               error ? error->message : "");
+
+  priv->is_portrait = portrait;
+  set_background_common (self, new_bg);
+  priv->is_portrait = FALSE;
+
+  if (!portrait && hd_home_is_portrait_wallpaper_enabled (priv->home))
+    load_background (self, TRUE);
+}
+
+/* Called when a cached PNG background has been decoded. */
+static void
+background_decoded (HdImageLoaderJob *job, GdkPixbuf *pixbuf,
+                    const GError *error, gpointer data)
 {
   HdHomeView *self = HD_HOME_VIEW (data);
   HdHomeViewPrivate *priv = self->priv;
+  gboolean portrait = priv->load_background_portrait;
   gchar *cached_background_image_file;
-  ClutterActor *new_bg = 0;
-  GError *error = NULL;
-  GError *error_portrait = NULL;
-  int i;
-  int max_value;
+  ClutterActor *new_bg = NULL;
+  GError *err = NULL;
 
-  if (g_source_is_destroyed (g_main_current_source ()))
-    return FALSE;
+  g_assert (priv->load_background_job == job);
+  priv->load_background_job = NULL;
 
-  if(hd_home_is_portrait_wallpaper_enabled (priv->home))
-    max_value = 2;
+  if (pixbuf)
+    {
+      new_bg = hd_image_loader_pixbuf_to_texture (pixbuf, &err);
+      error = err;
+    }
+
+  cached_background_image_file =
+    g_strdup_printf (portrait ? CACHED_BACKGROUND_IMAGE_FILE_PNG_PORTRAIT
+                              : CACHED_BACKGROUND_IMAGE_FILE_PNG,
+                     g_get_home_dir (), priv->id + 1);
+  background_loaded (self, portrait, new_bg,
+                     cached_background_image_file, error);
+  g_free (cached_background_image_file);
+  if (err)
+    g_error_free (err);
+}
+
+/* Loads the cached landscape or @portrait background.  PNGs are decoded
+ * on a worker thread, PVRs are compressed textures uploaded as they are,
+ * so they're loaded right away. */
+static void
+load_background (HdHomeView *self, gboolean portrait)
+{
+  HdHomeViewPrivate *priv = self->priv;
+  gchar *cached_background_image_file;
+  gint priority = G_PRIORITY_DEFAULT_IDLE;
+
+  cached_background_image_file =
+    g_strdup_printf (portrait ? CACHED_BACKGROUND_IMAGE_FILE_PNG_PORTRAIT
+                              : CACHED_BACKGROUND_IMAGE_FILE_PNG,
+                     g_get_home_dir (), priv->id + 1);
+
+  if (g_file_test (cached_background_image_file, G_FILE_TEST_EXISTS))
+    {
+      /* Check current home view and increase priority
+       * if this is the current one */
+      if (hd_home_view_container_get_current_view (priv->view_container)
+          == priv->id)
+        priority = G_PRIORITY_HIGH_IDLE;
+
+      priv->load_background_portrait = portrait;
+      priv->load_background_job =
+        hd_image_loader_load (cached_background_image_file, NULL, 0, 0,
+                              priority, background_decoded, self);
+    }
   else
-    max_value = 1;
+    {
+      ClutterActor *new_bg;
+      GError *error = NULL;
 
-  for(i = 0; i < max_value; i++){
-    if(!i)
-      {
-        cached_background_image_file = g_strdup_printf (CACHED_BACKGROUND_IMAGE_FILE_PNG,
-                                                        g_get_home_dir (),
-                                                        priv->id + 1);
-        priv->is_portrait = FALSE;
-      }
-    else
-      {
-        cached_background_image_file = g_strdup_printf (CACHED_BACKGROUND_IMAGE_FILE_PNG_PORTRAIT,
-                                                        g_get_home_dir (),
-                                                        priv->id + 1);
-        priv->is_portrait = TRUE;
-      }
+      g_free (cached_background_image_file);
+      cached_background_image_file =
+        g_strdup_printf (portrait ? CACHED_BACKGROUND_IMAGE_FILE_PVR_PORTRAIT
+                                  : CACHED_BACKGROUND_IMAGE_FILE_PVR,
+                         g_get_home_dir (), priv->id + 1);
+
+      new_bg = clutter_texture_new_from_file (cached_background_image_file,
+                                              &error);
+      background_loaded (self, portrait, new_bg,
+                         cached_background_image_file, error);
+      if (error)
+        g_error_free (error);
+    }
 
-    if (!g_file_test (cached_background_image_file,
-                      G_FILE_TEST_EXISTS))
-      {
-        g_free (cached_background_image_file);
-        if(!i) 
-          {
-            cached_background_image_file = g_strdup_printf (CACHED_BACKGROUND_IMAGE_FILE_PVR,
-                                                            g_get_home_dir (),
-                                                            priv->id + 1);
-
-            new_bg = clutter_texture_new_from_file (cached_background_image_file,
-                                                      &error);
-          }
-        else 
-          {
-            cached_background_image_file = g_strdup_printf (CACHED_BACKGROUND_IMAGE_FILE_PVR_PORTRAIT,
-                                                            g_get_home_dir (),
-                                                            priv->id + 1);
-
-            new_bg = clutter_texture_new_from_file (cached_background_image_file,
-                                                    &error_portrait);
-          }
-      }
-    else
-      {
-#if defined(MAEMO_CHANGES) && defined(UPSTREAM_DISABLED)
-        GdkPixbuf        *pixbuf;
-
-        /* Load image directly. We actually want to dither it on the fly to
-         * 16 bit, and clutter doesn't do this for us so we implement a very
-         * quick dither here. */
-        if(!i) 
-          pixbuf = gdk_pixbuf_new_from_file (cached_background_image_file, &error);
-        else
-          pixbuf = gdk_pixbuf_new_from_file (cached_background_image_file, &error_portrait);
-          
-        if (pixbuf != NULL)
-          {
-            gboolean          has_alpha;
-            gint              width;
-            gint              height;
-            gint              rowstride;
-            gint              n_channels;
-            guchar           *pixels;
-            gushort          *out_pixels, *out;
-            guint             lfsr = 1;
-            gint x,y;
-
-            /* Get pixbuf properties */
-            has_alpha       = gdk_pixbuf_get_has_alpha (pixbuf);
-            width           = gdk_pixbuf_get_width (pixbuf);
-            height          = gdk_pixbuf_get_height (pixbuf);
-            rowstride       = gdk_pixbuf_get_rowstride (pixbuf);
-            n_channels      = gdk_pixbuf_get_n_channels (pixbuf);
-            pixels          = gdk_pixbuf_get_pixels (pixbuf);
-
-            if (gdk_pixbuf_get_bits_per_sample (pixbuf)==8 &&
-                (n_channels==3 || n_channels==4))
-              {
-                out_pixels = g_malloc(width*height*2);
-                out = out_pixels;
-                for (y=0;y<height;y++) {
-                  for (x=0;x<width;x++) {
-                    /* http://en.wikipedia.org/wiki/Linear_feedback_shift_register */
-                    lfsr = (lfsr >> 1) ^ (unsigned int)((0 - (lfsr & 1u)) & 0xd0000001u);
-  
-                    /* dither 565 - by adding random noise and then truncating
-                     * (r>>8)*0xFF makes sure our bottom 8 bits are 0xFF if we
-                     * overflow.
-                     */
-                    guint r,g,b;
-                    r = pixels[0] + (lfsr&7);
-                    r |= (r>>8)*0xFF;
-                    g = pixels[1] + ((lfsr>>3)&3);
-                    g |= (g>>8)*0xFF;
-                    b = pixels[2] + ((lfsr>>5)&7);
-                    b |= (b>>8)*0xFF;
-                    *out = ((r<<8)&0xF800) |
-                           ((g<<3)&0x07E0) |
-                           ((b>>3)&0x001F);
-
-                    pixels += n_channels;
-                    out++;
-                  }
-                  pixels += rowstride - width*n_channels;
-                }
-                new_bg = clutter_texture_new();
-
-                if(!i) 
-                  {
-                    clutter_texture_set_from_rgb_data(CLUTTER_TEXTURE(new_bg),
-                          (guchar*)out_pixels, FALSE,
-                          width, height, width*2, 2, CLUTTER_TEXTURE_NONE, &error);
-                  }
-                else 
-                  {
-                    clutter_texture_set_from_rgb_data(CLUTTER_TEXTURE(new_bg),
-                          (guchar*)out_pixels, FALSE,
-                          width, height, width*2, 2, CLUTTER_TEXTURE_NONE, &error_portrait);
-                  }
-
-                g_free(out_pixels);
-              }
-            g_object_unref (pixbuf);
-          }
-#else
-      new_bg = clutter_texture_new_from_file (cached_background_image_file, &error);
-#endif
-      }
+  g_free (cached_background_image_file);
+}
 
-    if(!i) 
-      {
-        if (!new_bg)
-          {
-            g_warning ("Error loading cached background image %s. %s",
-                       cached_background_image_file,
-                       error?error->message:"");
-            if (error)
-              g_error_free (error);
-          }
-      }
-    else
-      {
-        if (!new_bg)
-          {
-            g_warning ("Error loading cached portrait background image %s. %s",
-                       cached_background_image_file,
-                       error_portrait?error_portrait->message:"");
-            if (error_portrait)
-              g_error_free (error_portrait);
-          }
-      }
-  
-    g_free (cached_background_image_file);
+static gboolean
+load_background_idle (gpointer data)
+{
+  HdHomeView *self = HD_HOME_VIEW (data);
 
-    set_background_common (self, new_bg);  
-    priv->load_background_source = 0;
-  }
+  if (g_source_is_destroyed (g_main_current_source ()))
+    return FALSE;
 
-  priv->is_portrait = FALSE;
+  self->priv->load_background_source = 0;
+  load_background (self, FALSE);
 
   return FALSE;
 }
@@ -750,12 +695,20 @@ hd_home_view_set_live_bg (HdHomeView *view,
   ClutterActor *new_bg = 0;
   MBWMCompMgrClutterClient *cclient;
 
-  if (priv->load_background_source && !above_applets)
+  if (!above_applets)
     {
       /* cancel ongoing background loading job unless we have transparent
        * live background */
-      g_source_remove (priv->load_background_source);
-      priv->load_background_source = 0;
+      if (priv->load_background_source)
+        {
+          g_source_remove (priv->load_background_source);
+          priv->load_background_source = 0;
+        }
+      if (priv->load_background_job)
+        {
+          hd_image_loader_cancel (priv->load_background_job);
+          priv->load_background_job = NULL;
+        }
     }
 
   if (client) 
@@ -814,6 +767,15 @@ hd_home_view_load_background (HdHomeView *view)
   if (hd_home_view_container_get_current_view (priv->view_container) == priv->id)
     priority = G_PRIORITY_HIGH_IDLE;
 
+  /* Restart if we're already loading. */
+  if (priv->load_background_source)
+    g_source_remove (priv->load_background_source);
+  if (priv->load_background_job)
+    {
+      hd_image_loader_cancel (priv->load_background_job);
+      priv->load_background_job = NULL;
+    }
+
   priv->load_background_source = g_idle_add_full (priority,
                                                   load_background_idle,
                                                   view,
@@ -42,6 +42,7 @@
 #include "hd-launcher-app.h"
 #include "hd-dbus.h"
 #include "hd-title-bar.h"
+#include "hd-stats.h"
 
 #include <clutter/clutter.h>
 #include <clutter/x11/clutter-x11.h>
@@ -2835,3 +2836,15 @@ hd_home_is_desktop_in_portrait_mode (void)
 	return STATE_IS_PORTRAIT (hd_render_manager_get_state ());
 }
 
+/* D-Bus method returning the compositor's frame timing statistics,
+ * optionally starting a new measurement period. */
+gchar *
+hd_home_get_frame_stats (HdHome *home, gboolean reset)
+{
+  gchar *stats;
+
+  stats = hd_stats_to_string ();
+  if (reset)
+    hd_stats_reset ();
+  return stats;
+}
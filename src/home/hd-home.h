@@ -113,6 +113,8 @@ gboolean hd_home_is_portrait_wallpaper_enabled (HdHome *home);
 
 gboolean hd_home_is_desktop_in_portrait_mode (void);
 
+gchar *hd_home_get_frame_stats (HdHome *home, gboolean reset);
+
 extern gboolean in_alt_tab;
 
 G_END_DECLS
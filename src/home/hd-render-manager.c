@@ -42,6 +42,7 @@
 #include "hd-transition.h"
 #include "hd-wm.h"
 #include "hd-util.h"
+#include "hd-stats.h"
 #include "hd-title-bar.h"
 #include "hd-app.h"
 #include "hd-dialog.h"
@@ -246,8 +247,25 @@ struct _HdRenderManagerPrivate {
   cairo_region_t           *current_input_viewport;
   cairo_region_t           *new_input_viewport;
   guint                input_viewport_callback;
+
+  /* The HdRmStackEntry:s hd_render_manager_restack() placed last time,
+   * bottom to top.  Used to only touch what changed since then. */
+  GArray       *stacking;
+
+  /* The actors whose geometry the occlusion clips of the last
+   * hd_render_manager_set_visibilities() depend on. */
+  GPtrArray    *occlusion_watched;
 };
 
+/* An actor hd_render_manager_restack() raises to the top of its parent. */
+typedef struct
+{
+  ClutterActor *actor;
+  /* The desktop group of the client; if @actor is found there or in
+   * %app_top it is moved to %home_blur.  %NULL if it shouldn't be. */
+  ClutterActor *desktop;
+} HdRmStackEntry;
+
 /* ------------------------------------------------------------------------- */
 static void
 stage_allocation_changed(ClutterActor *actor, GParamSpec *unused,
@@ -266,6 +284,8 @@ on_timeline_blur_completed(ClutterTimeline *timeline, gpointer data);
 static void
 hd_render_manager_sync_clutter_before(void);
 static void
+hd_render_manager_unwatch_occlusion(HdRenderManagerPrivate *priv);
+static void
 hd_render_manager_sync_clutter_after(void);
 
 static const char *
@@ -286,6 +306,8 @@ static
 gboolean hd_render_manager_should_ignore_cm_client(MBWMCompMgrClutterClient *cm_client);
 static
 gboolean hd_render_manager_should_ignore_actor(ClutterActor *actor);
+static void
+hd_render_manager_free_stacking(GArray *stacking);
 /* ------------------------------------------------------------------------- */
 /* -------------------------------------------------------------  RANGE      */
 /* ------------------------------------------------------------------------- */
@@ -428,6 +450,7 @@ hd_render_manager_finalize (GObject *gobject)
   g_object_unref(priv->home);
   g_object_unref(priv->task_nav);
   g_object_unref(priv->title_bar);
+  hd_render_manager_free_stacking(priv->stacking);
   G_OBJECT_CLASS (hd_render_manager_parent_class)->finalize (gobject);
 }
 
@@ -440,6 +463,9 @@ hd_render_manager_dispose (GObject *gobject)
     return;
 
   priv->disposed = TRUE;
+  hd_render_manager_unwatch_occlusion(priv);
+  if (priv->occlusion_watched)
+    g_ptr_array_free(priv->occlusion_watched, TRUE);
   G_OBJECT_CLASS(hd_render_manager_parent_class)->dispose(gobject);
 }
 
@@ -1429,6 +1455,7 @@ void hd_render_manager_set_state(HDRMStateEnum state)
     {
       HDRMStateEnum oldstate = priv->state;
       priv->previous_state = priv->state;
+      hd_stats_count(HD_STATS_STATE_CHANGES);
 
       if (hd_dbus_state_before_tklock != HDRM_STATE_UNDEFINED
           && state != hd_dbus_state_before_tklock && !hd_dbus_tklock_on)
@@ -2123,6 +2150,130 @@ hd_render_manager_get_geo_for_current_screen(ClutterActor *actor,
     *geo = rgeo;
 }
 
+static void
+hd_render_manager_free_stacking(GArray *stacking)
+{
+  guint i;
+
+  if (!stacking)
+    return;
+  for (i = 0; i < stacking->len; i++)
+    g_object_unref(g_array_index(stacking, HdRmStackEntry, i).actor);
+  g_array_free(stacking, TRUE);
+}
+
+/* Adds @actor to the top of @stacking.  Only actors which may not be
+ * reparented (the live background) can be added more than once, in which
+ * case only the last one counts. */
+static void
+hd_render_manager_stacking_append(GArray *stacking, ClutterActor *actor,
+                                  ClutterActor *desktop)
+{
+  HdRmStackEntry entry;
+
+  if (!desktop)
+    {
+      guint i;
+
+      for (i = 0; i < stacking->len; i++)
+        if (g_array_index(stacking, HdRmStackEntry, i).actor == actor)
+          {
+            g_array_remove_index(stacking, i);
+            break;
+          }
+    }
+
+  entry.actor = actor;
+  entry.desktop = desktop;
+  g_array_append_val(stacking, entry);
+}
+
+/* Whether @actor is in @stacking after the @from:th entry. */
+static gboolean
+hd_render_manager_stacking_has(GArray *stacking, guint from,
+                               ClutterActor *actor)
+{
+  for (; from < stacking->len; from++)
+    if (g_array_index(stacking, HdRmStackEntry, from).actor == actor)
+      return TRUE;
+  return FALSE;
+}
+
+/*
+ * Returns how many entries at the bottom of @stacking are already placed
+ * in their parents exactly as if we raised them one by one, ie. as we
+ * left them in the previous restack: they're still where the previous
+ * @last stacking put them, they're consecutive siblings within their
+ * parents, and nothing but actors we are about to raise anyway is above
+ * them.  Raising the rest is then equivalent to raising all of them.
+ */
+static guint
+hd_render_manager_stacking_unchanged(GArray *stacking, GArray *last)
+{
+  typedef struct { ClutterActor *parent; guint first, last; } Parent;
+  HdRenderManagerPrivate *priv = render_manager->priv;
+  Parent parents[8];
+  guint i, j, n, nparents;
+
+  if (!last)
+    return 0;
+
+  nparents = 0;
+  n = MIN(stacking->len, last->len);
+  for (i = 0; i < n; i++)
+    {
+      const HdRmStackEntry *e = &g_array_index(stacking, HdRmStackEntry, i);
+      const HdRmStackEntry *l = &g_array_index(last, HdRmStackEntry, i);
+      ClutterActor *parent;
+
+      if (e->actor != l->actor || e->desktop != l->desktop)
+        break;
+      if (!(parent = clutter_actor_get_parent(e->actor)))
+        break;
+      if (e->desktop && (parent == e->desktop
+                         || parent == CLUTTER_ACTOR(priv->app_top)))
+        /* It needs to be reparented. */
+        break;
+
+      for (j = 0; j < nparents; j++)
+        if (parents[j].parent == parent)
+          break;
+      if (j < nparents)
+        { /* Is it right above the previous one in @parent? */
+          ClutterActor *prev = g_array_index(stacking, HdRmStackEntry,
+                                             parents[j].last).actor;
+          if (clutter_actor_get_next_sibling(prev) != e->actor)
+            break;
+          parents[j].last = i;
+        }
+      else if (nparents < G_N_ELEMENTS(parents))
+        {
+          parents[nparents].parent = parent;
+          parents[nparents].first = parents[nparents].last = i;
+          nparents++;
+        }
+      else
+        break;
+    }
+  n = i;
+
+  /* Check that nothing got above the unchanged ones in their parents. */
+  for (j = 0; j < nparents; j++)
+    {
+      ClutterActor *above;
+
+      above = g_array_index(stacking, HdRmStackEntry, parents[j].last).actor;
+      while ((above = clutter_actor_get_next_sibling(above)) != NULL)
+        if (above != CLUTTER_ACTOR(priv->blur_front)
+            && !hd_render_manager_stacking_has(stacking, n, above))
+          break;
+      if (above && parents[j].first < n)
+        n = parents[j].first;
+    }
+
+  return n;
+}
+
 /* Called to restack the windows in the way we use for rendering... */
 void hd_render_manager_restack()
 {
@@ -2137,8 +2288,12 @@ void hd_render_manager_restack()
   int curr_view;
   ClutterActor *live_bg_actor = NULL;
   ClutterActor *child;
+  GArray *stacking;
+  guint unchanged;
+  gint64 start = hd_stats_now();
 
   wm = MB_WM_COMP_MGR(priv->comp_mgr)->wm;
+  stacking = g_array_new(FALSE, FALSE, sizeof(HdRmStackEntry));
   /* Add all actors currently in the home_blur group */
 
   for (i = 0,
@@ -2195,7 +2350,10 @@ void hd_render_manager_restack()
                   ClutterActor *parent = clutter_actor_get_parent (actor);
                   if (parent == CLUTTER_ACTOR (priv->app_top) ||
                       parent == CLUTTER_ACTOR (priv->home_blur))
-                    clutter_actor_reparent (actor, CLUTTER_ACTOR (desktop));
+                    {
+                      hd_render_manager_remove_occlusion_clip (actor);
+                      clutter_actor_reparent (actor, CLUTTER_ACTOR (desktop));
+                    }
                 }
               g_debug ("%s: skip unmapped client '%s' (actor '%s')\n",
                        __func__, mb_wm_client_get_name (c),
@@ -2228,28 +2386,22 @@ void hd_render_manager_restack()
                    * were */
                   if (parent)
                     {
-                      if (parent == CLUTTER_ACTOR(desktop) ||
-                          parent == CLUTTER_ACTOR(priv->app_top))
-                        {
-                          clutter_actor_reparent(actor,
-                                                 CLUTTER_ACTOR(priv->home_blur));
-                        }
 #if STACKING_DEBUG
-                      else
+                      if (parent != CLUTTER_ACTOR(desktop) &&
+                          parent != CLUTTER_ACTOR(priv->app_top) &&
+                          parent != CLUTTER_ACTOR(priv->home_blur))
                         g_debug("%s NOT MOVED - OWNED BY %s",
                             clutter_actor_get_name(actor)?clutter_actor_get_name(actor):"?",
                             clutter_actor_get_name(parent)?clutter_actor_get_name(parent):"?");
 #endif /*STACKING_DEBUG*/
-                     clutter_actor_set_child_above_sibling(
-                           clutter_actor_get_parent(actor), actor, NULL);
-                     if (live_bg_actor && c->desktop == curr_view
-                         && MB_WM_CLIENT_CLIENT_TYPE (c)==
-                         (MBWMClientType)HdWmClientTypeHomeApplet)
-                     {
-                       clutter_actor_set_child_above_sibling(
-                             clutter_actor_get_parent(live_bg_actor),
-                             live_bg_actor, NULL);
-                     }
+                      hd_render_manager_stacking_append(stacking, actor,
+                                                        desktop);
+                      if (live_bg_actor && c->desktop == curr_view
+                          && MB_WM_CLIENT_CLIENT_TYPE (c)==
+                          (MBWMClientType)HdWmClientTypeHomeApplet)
+                        hd_render_manager_stacking_append(stacking,
+                                                          live_bg_actor,
+                                                          NULL);
                     }
 #if STACKING_DEBUG
                   else
@@ -2262,12 +2414,38 @@ void hd_render_manager_restack()
                   /* else we put it back into the arena */
                   if (parent == CLUTTER_ACTOR(priv->home_blur) ||
                       parent == CLUTTER_ACTOR(priv->app_top))
-                    clutter_actor_reparent(actor, desktop);
+                    {
+                      hd_render_manager_remove_occlusion_clip(actor);
+                      clutter_actor_reparent(actor, desktop);
+                    }
                 }
             }
         }
     }
 
+  /* Raise the actors to be rendered in order.  Those which are still
+   * where we put them last time needn't be touched. */
+  unchanged = hd_render_manager_stacking_unchanged(stacking, priv->stacking);
+#if STACKING_DEBUG
+  g_debug("RESTACK: %u of %u actors unchanged", unchanged, stacking->len);
+#endif /*STACKING_DEBUG*/
+  for (i = unchanged; i < stacking->len; i++)
+    {
+      const HdRmStackEntry *e = &g_array_index(stacking, HdRmStackEntry, i);
+      ClutterActor *parent = clutter_actor_get_parent(e->actor);
+
+      if (e->desktop && (parent == e->desktop ||
+                         parent == CLUTTER_ACTOR(priv->app_top)))
+        clutter_actor_reparent(e->actor, CLUTTER_ACTOR(priv->home_blur));
+      clutter_actor_set_child_above_sibling(
+                          clutter_actor_get_parent(e->actor), e->actor, NULL);
+    }
+  hd_stats_count_n(HD_STATS_RESTACKED_ACTORS, stacking->len - unchanged);
+  for (i = 0; i < stacking->len; i++)
+    g_object_ref(g_array_index(stacking, HdRmStackEntry, i).actor);
+  hd_render_manager_free_stacking(priv->stacking);
+  priv->stacking = stacking;
+
   /* Now start at the top and put actors in the non-blurred group
    * until we find one that fills the screen. If we didn't find
    * any that filled the screen then add the window that does. */
@@ -2452,6 +2630,8 @@ void hd_render_manager_restack()
 
   /* update our fixed title bar at the top of the screen */
   hd_title_bar_update(priv->title_bar);
+
+  hd_stats_add_time(HD_STATS_RESTACK, start);
 }
 
 void hd_render_manager_update_blur_state()
@@ -2576,104 +2756,161 @@ void hd_render_manager_set_launcher_subview(gboolean subview)
         ~HDRM_ZOOM_FOR_LAUNCHER_SUBMENU);
 }
 
-/* Work out if rect is visible after being clipped to avoid every
- * rect in blockers */
-static gboolean
-hd_render_manager_is_visible(GList *blockers,
-                             ClutterGeometry rect)
+/* Work out which part of @rect is visible after subtracting @covered.
+ * Returns %NULL if nothing is left of it, otherwise the caller owns
+ * the returned region. */
+static cairo_region_t *
+hd_render_manager_visible_region(const cairo_region_t *covered,
+                                 ClutterGeometry rect)
 {
   HdRenderManagerPrivate *priv = render_manager->priv;
+  cairo_region_t *visible;
 
   if (STATE_IS_NON_COMP (priv->state) || !hd_render_manager_clip_geo(&rect))
-    return FALSE;
+    return NULL;
+
+  /* ClutterGeometry and cairo_rectangle_int_t have the same layout. */
+  visible = cairo_region_create_rectangle (
+                          (cairo_rectangle_int_t *)(void*)&rect);
+  if (covered)
+    cairo_region_subtract (visible, covered);
+  if (cairo_region_is_empty (visible))
+    {
+      cairo_region_destroy (visible);
+      return NULL;
+    }
 
-  /* clip for every block */
-  for (; blockers; blockers = blockers->next)
+  return visible;
+}
+
+/* Returns the clip hd_render_manager_clip_occluded() put on @actor
+ * if it's still there.  If someone has changed it since then the clip
+ * is theirs and we forget about ours. */
+static const ClutterGeometry *
+hd_render_manager_get_occlusion_clip(ClutterActor *actor)
+{
+  const ClutterGeometry *ours;
+  gfloat x, y, w, h;
+
+  if (!(ours = g_object_get_data (G_OBJECT (actor), "HD-occlusion-clip")))
+    return NULL;
+  if (clutter_actor_has_clip (actor))
     {
-      ClutterGeometry blocker = *(ClutterGeometry*)blockers->data;
-      gint rect_b, blocker_b;
+      clutter_actor_get_clip (actor, &x, &y, &w, &h);
+      if (x == ours->x && y == ours->y
+          && w == ours->width && h == ours->height)
+        return ours;
+    }
+  g_object_set_data (G_OBJECT (actor), "HD-occlusion-clip", NULL);
+  return NULL;
+}
 
-      VISIBILITY ("RECT %dx%d%+d%+d BLOCKER %dx%d%+d%+d",
-                  MBWM_GEOMETRY(&rect), MBWM_GEOMETRY(&blocker));
+/* Removes the clip hd_render_manager_clip_occluded() may have put
+ * on @actor.  Call it when you take @actor out of %home_blur or
+ * start moving it around. */
+void hd_render_manager_remove_occlusion_clip(ClutterActor *actor)
+{
+  if (!hd_render_manager_get_occlusion_clip (actor))
+    return;
+  g_object_set_data (G_OBJECT (actor), "HD-occlusion-clip", NULL);
+  clutter_actor_remove_clip (actor);
+}
 
-      /*
-       * If rect does not fit inside blocker in the X axis...
-       * Beware that ClutterGeometry.x and .y are signed, while .width
-       * and .height are unsigned and the type propagation rules of C
-       * makes sure we'll have trouble because the result is unsigned.
-       * It's only significant, though when you compare signeds and
-       * unsigneds.
-       */
-      if (!(blocker.x <= rect.x &&
-            rect.x+(gint)rect.width <= blocker.x+(gint)blocker.width))
-        continue;
-
-      /* Because most windows will go edge->edge, just do a very simplistic
-       * clipping in the Y direction */
-      rect_b    = rect.y + rect.height;
-      blocker_b = blocker.y + blocker.height;
-
-      if (rect.y < blocker.y)
-        { /* top of rect is above blocker */
-          if (rect_b < blocker.y)
-            /* rect is above blocker */
-            continue;
-          if (rect_b < blocker_b)
-            /* rect is half above blocker, clip the rest */
-            rect.height -= rect_b - blocker.y;
-          else
-            { /* rect is split into two pieces by blocker */
-              rect.height = blocker.y - rect.y;
-              if (hd_render_manager_is_visible(blockers, rect))
-                /* upper half is visible */
-                return TRUE;
-
-              /* continue with the lower half */
-              rect.y = blocker_b;
-              rect.height = rect_b - blocker_b;
-            }
-        }
-      else if (rect.y < blocker_b)
-        { /* top of rect is inside blocker */
-          if (rect_b < blocker_b)
-            /* rect is confined in blocker */
-            return FALSE;
-          else
-            { /* rect is half below blocker, clip the rest */
-              rect.height -= blocker_b - rect.y;
-              rect.y       = blocker_b;
-            }
-        }
-      else
-        /* rect is completely below blocker */;
+/* Drops the occlusion clips when an actor they were computed from moves
+ * or changes size, since they may hide what has just become visible.
+ * The next hd_render_manager_set_visibilities() works them out again. */
+static void
+hd_render_manager_occlusion_geometry_changed(ClutterActor *actor,
+                                             GParamSpec *unused,
+                                             HdRenderManagerPrivate *priv)
+{
+  GList *children, *l;
 
-      if (blocker.x <= rect.x &&
-          rect.x+rect.width <= blocker.x+blocker.width)
-        {
-          if (blocker.y <= rect.y &&
-              rect.y+rect.height <= blocker.y+blocker.height)
-            {
-              /* If rect fits inside blocker in the Y axis,
-               * it is def. not visible */
-              return FALSE;
-            }
-          else if (rect.y < blocker.y)
-            {
-              /* safety - if the blocker sits in the middle of us
-               * it makes 2 rects, so don't use it */
-              if (blocker.y+blocker.height >= rect.y+rect.height)
-                /* rect out the bottom, clip to the blocker */
-                rect.height = blocker.y - rect.y;
-            }
-          else
-            { /* rect must be out the top, clip to the blocker */
-              rect.height = (rect.y + rect.height) -
-                            (blocker.y + blocker.height);
-              rect.y = blocker.y + blocker.height;
-            }
-        }
+  VISIBILITY ("%p MOVED, DROP OCCLUSION CLIPS", actor);
+  children = clutter_container_get_children(
+                                    CLUTTER_CONTAINER(priv->home_blur));
+  for (l = children; l; l = l->next)
+    hd_render_manager_remove_occlusion_clip(l->data);
+  g_list_free(children);
+  hd_render_manager_unwatch_occlusion(priv);
+}
+
+static void
+hd_render_manager_watch_occlusion(ClutterActor *actor,
+                                  HdRenderManagerPrivate *priv)
+{
+  if (actor == CLUTTER_ACTOR(priv->blur_front)
+      || !clutter_actor_is_visible(actor))
+    return;
+
+  if (!priv->occlusion_watched)
+    priv->occlusion_watched = g_ptr_array_new();
+  g_signal_connect(actor, "notify::allocation",
+                   G_CALLBACK(hd_render_manager_occlusion_geometry_changed),
+                   priv);
+  g_ptr_array_add(priv->occlusion_watched, g_object_ref(actor));
+}
+
+static void
+hd_render_manager_unwatch_occlusion(HdRenderManagerPrivate *priv)
+{
+  guint i;
+
+  if (!priv->occlusion_watched)
+    return;
+
+  for (i = 0; i < priv->occlusion_watched->len; i++)
+    {
+      ClutterActor *actor = priv->occlusion_watched->pdata[i];
+
+      g_signal_handlers_disconnect_by_func(actor,
+                    hd_render_manager_occlusion_geometry_changed, priv);
+      g_object_unref(actor);
+    }
+  g_ptr_array_set_size(priv->occlusion_watched, 0);
+}
+
+/* Clips @actor, whose unclipped geometry is @geo, to the extents of
+ * its @visible part so the covered parts are not painted.  We only do
+ * it for plain untransformed actors nobody else clips, otherwise we
+ * would need to map @visible into the actor's coordinate space.
+ * Returns whether @actor is clipped. */
+static gboolean
+hd_render_manager_clip_occluded(ClutterActor *actor,
+                                const ClutterGeometry *geo,
+                                const cairo_region_t *visible)
+{
+  ClutterGeometry ageo, *clip;
+  cairo_rectangle_int_t ext;
+  MBWMCompMgrClutterClient *cc;
+
+  cairo_region_get_extents (visible, &ext);
+  clutter_actor_get_geometry (actor, &ageo);
+  cc = g_object_get_data (G_OBJECT (actor), "HD-MBWMCompMgrClutterClient");
+  if ((ext.x == geo->x && ext.y == geo->y
+       && ext.width == geo->width && ext.height == geo->height)
+      || ageo.x != geo->x || ageo.y != geo->y
+      || clutter_actor_is_scaled (actor)
+      || clutter_actor_is_rotated (actor)
+      || (cc && (mb_wm_comp_mgr_clutter_client_get_flags (cc)
+                 & MBWMCompMgrClutterClientEffectRunning))
+      || (!hd_render_manager_get_occlusion_clip (actor)
+          && clutter_actor_has_clip (actor)))
+    {
+      hd_render_manager_remove_occlusion_clip (actor);
+      return FALSE;
     }
 
+  VISIBILITY ("CLIP %p TO %dx%d%+d%+d", actor, MBWM_GEOMETRY(&ext));
+  clip = g_new (ClutterGeometry, 1);
+  clip->x = ext.x - geo->x;
+  clip->y = ext.y - geo->y;
+  clip->width = ext.width;
+  clip->height = ext.height;
+  g_object_set_data_full (G_OBJECT (actor), "HD-occlusion-clip",
+                          clip, g_free);
+  clutter_actor_set_clip (actor, clip->x, clip->y,
+                          clip->width, clip->height);
   return TRUE;
 }
 
@@ -2749,9 +2986,13 @@ gboolean hd_render_manager_actor_opaque(ClutterActor *actor)
 }
 
 static
-void hd_render_manager_append_geo_cb(ClutterActor *actor, gpointer data)
+void hd_render_manager_add_blocker_cb(ClutterActor *actor, gpointer data)
 {
-  GList **list = (GList**)data;
+  cairo_region_t *covered = data;
+
+  /* @app_top isn't subject to occlusion clipping. */
+  hd_render_manager_remove_occlusion_clip(actor);
+
   if (hd_render_manager_actor_opaque(actor))
     {
       ClutterGeometry geo;
@@ -2770,7 +3011,8 @@ void hd_render_manager_append_geo_cb(ClutterActor *actor, gpointer data)
       hd_render_manager_get_geo_for_current_screen(actor, &geo);
       if (!hd_render_manager_clip_geo (&geo))
         return;
-      *list = g_list_prepend(*list, g_memdup(&geo, sizeof(geo)));
+      cairo_region_union_rectangle(covered,
+                                   (cairo_rectangle_int_t *)(void*)&geo);
       VISIBILITY ("BLOCKER %dx%d%+d%+d", MBWM_GEOMETRY(&geo));
     }
 }
@@ -2778,8 +3020,7 @@ void hd_render_manager_append_geo_cb(ClutterActor *actor, gpointer data)
 void hd_render_manager_set_visibilities()
 { VISIBILITY ("SET VISIBILITIES");
   HdRenderManagerPrivate *priv;
-  GList *blockers = 0;
-  GList *it;
+  cairo_region_t *covered, *visible;
   gint i, n_elements;
   ClutterGeometry fullscreen_geo = {0, 0,
           hd_comp_mgr_get_current_screen_width (),
@@ -2787,8 +3028,11 @@ void hd_render_manager_set_visibilities()
   MBWindowManager *wm;
   gboolean has_fullscreen;
   MBWindowManagerClient *c;
+  gboolean clipped;
+  gint64 start;
 
   priv = render_manager->priv;
+  hd_render_manager_unwatch_occlusion(priv);
 
   /* shortcut for non-composited mode */
   if (STATE_IS_NON_COMP (priv->state))
@@ -2797,14 +3041,18 @@ void hd_render_manager_set_visibilities()
       return;
     }
 
-  /* first append all the top elements... */
+  start = hd_stats_now();
+
+  /* Everything we've found opaque so far, going from top to bottom.
+   * First add all the top elements... */
+  covered = cairo_region_create();
   clutter_container_foreach(CLUTTER_CONTAINER(priv->app_top),
-                            hd_render_manager_append_geo_cb,
-                            (gpointer)&blockers);
+                            hd_render_manager_add_blocker_cb, covered);
   /* Now check to see if the whole screen is covered, and if so
    * don't bother rendering blurring */
-  if (hd_render_manager_is_visible(blockers, fullscreen_geo))
+  if ((visible = hd_render_manager_visible_region(covered, fullscreen_geo)))
     {
+      cairo_region_destroy(visible);
       clutter_actor_show(CLUTTER_ACTOR(priv->home_blur));
     }
   else
@@ -2814,6 +3062,7 @@ void hd_render_manager_set_visibilities()
 
   /* Then work BACKWARDS through the other items, working out if they are
    * visible or not */
+  clipped = FALSE;
   n_elements = clutter_group_get_n_children(CLUTTER_GROUP(priv->home_blur));
   for (i=n_elements-1;i>=0;i--)
     {
@@ -2830,20 +3079,24 @@ void hd_render_manager_set_visibilities()
           hd_render_manager_get_geo_for_current_screen(child, &geo);
           /*TEST clutter_actor_set_opacity(child, 63);*/
           VISIBILITY ("IS %p (%dx%d%+d%+d) VISIBLE?", child, MBWM_GEOMETRY(&geo));
-          if (hd_render_manager_is_visible(blockers, geo))
+          if ((visible = hd_render_manager_visible_region(covered, geo)))
             {
               VISIBILITY ("IS");
               clutter_actor_show(child);
+              clipped |= hd_render_manager_clip_occluded(child, &geo,
+                                                         visible);
 
-              /* Add the geometry to our list of blockers and go to next... */
+              /* Add the geometry to the covered region and go to next... */
               if (hd_render_manager_actor_opaque(child))
                 {
-                  blockers = g_list_prepend(blockers, g_memdup(&geo, sizeof(geo)));
+                  cairo_region_union(covered, visible);
                   VISIBILITY ("MORE BLOCKER %dx%d%+d%+d", MBWM_GEOMETRY(&geo));
                 }
+              cairo_region_destroy(visible);
             }
           else
             { /* Not visible, hide it unless... */
+              hd_render_manager_remove_occlusion_clip(child);
               /* Avoid flicker with subview transition. */
               if (!hd_transition_actor_will_go_away(child))
                 {
@@ -2860,15 +3113,16 @@ void hd_render_manager_set_visibilities()
    * and make an error here, but there are actually many cases where this is
    * valid. See NB#117092 */
 
-  /* now free blockers */
-  it = g_list_first(blockers);
-  while (it)
+  cairo_region_destroy(covered);
+
+  /* The clips are only right as long as nothing moves. */
+  if (clipped)
     {
-      g_free(it->data);
-      it = it->next;
+      clutter_container_foreach(CLUTTER_CONTAINER(priv->app_top),
+                   (ClutterCallback)hd_render_manager_watch_occlusion, priv);
+      clutter_container_foreach(CLUTTER_CONTAINER(priv->home_blur),
+                   (ClutterCallback)hd_render_manager_watch_occlusion, priv);
     }
-  g_list_free(blockers);
-  blockers = 0;
 
   /* Do we have a fullscreen client totally filling the screen? */
   /* This is voodo.  Please insert a comment here that explains
@@ -2904,6 +3158,8 @@ void hd_render_manager_set_visibilities()
 
   hd_render_manager_update_status_area(has_fullscreen);
   hd_render_manager_set_input_viewport();
+
+  hd_stats_add_time(HD_STATS_SET_VISIBILITIES, start);
 }
 
 /* Called by hd-task-navigator when its state changes, as when notifications
@@ -302,6 +302,7 @@ gboolean hd_render_manager_allow_dbus_launch_transition(void);
 gboolean hd_render_manager_actor_is_visible(ClutterActor *actor);
 
 void hd_render_manager_set_visibilities(void);
+void hd_render_manager_remove_occlusion_clip(ClutterActor *actor);
 
 void hd_render_manager_update_blur_state(void);
 void hd_render_manager_pause_blur_animation(void);
@@ -47,7 +47,10 @@
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <clutter/clutter.h>
 #include <tidy/tidy-finger-scroll.h>
+#include <tidy/tidy-scrollable.h>
+#include <tidy/tidy-adjustment.h>
 #include <tidy/tidy-desaturation-group.h>
+#include <tidy/tidy-snapshot-effect.h>
 
 #include <matchbox/core/mb-wm.h>
 #include <matchbox/comp-mgr/mb-wm-comp-mgr.h>
@@ -67,6 +70,8 @@
 #include "hd-util.h"
 #include "hd-gtk-style.h"
 #include "hd-app-mgr.h"
+#include "hd-image-loader.h"
+#include "hd-stats.h"
 /* }}} */
 
 /* Standard definitions {{{ */
@@ -193,6 +198,19 @@
 #define THUMB_DESATURATION_ENABLED     \
   hd_transition_get_int("thp_tweaks", "thumb_desaturation", 0)
 
+/* Application thumbnails show a scaled down snapshot of the windows,
+ * refreshed at most this often (in milisecs), unless it's negative. */
+#define THUMB_SNAPSHOT_INTERVAL        \
+  hd_transition_get_int("task_nav", "snapshot_interval", 250)
+
+/* How many sets of frame graphics of culled thumbnails to keep around
+ * for the thumbnails scrolled into view, see cull_thumbs(). */
+#define FRAME_POOL_SIZE                8
+
+/* How long to wait after a video screenshot has been written
+ * before reloading it, in case it's being rewritten. */
+#define VIDEO_RELOAD_DELAY             500
+
 /*
  *  These are based on the UX Guidance.
  *
@@ -379,6 +397,8 @@ typedef struct
        *                  when the %Thumbnail has a @video.  Also clips its
        *                  contents to @App_window_geometry, making sure that
        *                  really nothing is shown outside the thumbnail.
+       *                  Normally it's painted from a thumbnail-sized
+       *                  snapshot, see set_snapshot().
        * -- @titlebar:    An actor that looks like the original title bar.
        *                  Faded in/out when zooming in/out, but normally
        *                  transparent or not visible at all.
@@ -457,14 +477,19 @@ typedef struct
        * -- @video_fname: Where to look for the last-frame video screenshot
        *                  for this application.  Deduced from some property
        *                  in the application's .desktop file.
-       * -- @video_mtime: The last modification time of the image loaded as
-       *                  .video.  Used to decide if it should be refreshed.
        * -- @video:       The downsampled texture of the image loaded from
        *                  .video_fname or %NULL.
+       * -- @video_job:   Loading .video in the background, or %NULL.
+       * -- @video_monitor: Watches .video_fname and has it reloaded by
+       *                  video_changed() whenever it's rewritten, so it's
+       *                  ready by the time the switcher is entered.
+       * -- @video_reload_id: Source of the pending reload_video().
        */
       ClutterActor        *video;
+      HdImageLoaderJob    *video_job;
       const gchar         *video_fname;
-      time_t               video_mtime;
+      GFileMonitor        *video_monitor;
+      guint                video_reload_id;
     };
 
     /* Currently we don't have notification-specific fields. */
@@ -478,6 +503,13 @@ typedef struct
   TNote               *tnote;
   time_t last_activated;
 
+  /*
+   * -- @culled:      The thumbnail is far from the viewport of the @Grid,
+   *                  so cull_thumbs() has hidden .thwin and lent the
+   *                  .frame pieces to @Frame_pool.
+   */
+  gboolean culled;
+
   /* -- @portrait_supported: Application supports portrait?
    *                         TODO: Check if is it possible support
    *                         to be changed while in task navigator?
@@ -504,7 +536,7 @@ typedef struct
 } Flyops;
 
 /* For linear_effect(), resize_effect() and turnoff_effect(). */
-typedef struct
+typedef struct EffectClosure
 {
   /*
    * @actor:                    The actor to be animated (refed).
@@ -512,16 +544,16 @@ typedef struct
    *                            a thwin.
    * @timeline:                 Used when one wants to cancel an effect
    *                            outside of the timeline.
-   * @new_frame_cb_id, @timeline_complete_cb_id:
-   *                            %ClutterTimeline signal handler IDs
-   *                            @new_frame_cb_id can be 0.
-   * @frame_fun:                Just about any value that can identify
-   *                            an effect.  Typically the effect's
-   *                            new-frame callback.  Can be %NULL.
+   * @frame_fun:                Called by advance_effects() in every
+   *                            frame of @timeline.  Can be %NULL.
+   * @timeline_complete_cb_id:  %ClutterTimeline signal handler ID.
+   * @effectid:                 Just about any value that can identify
+   *                            an effect.  Typically @frame_fun.
    */
   ClutterActor *actor;
   ClutterTimeline *timeline;
-  gulong new_frame_cb_id, timeline_complete_cb_id;
+  void (*frame_fun)(ClutterTimeline *, gint, struct EffectClosure *);
+  gulong timeline_complete_cb_id;
   gconstpointer effectid;
 
   /* Effect-specific context */
@@ -760,6 +792,14 @@ static ClutterTransition *Fade_in_transition, *Fade_out_transition;
  */
 static GPtrArray *Effects;
 
+/*
+ * -- @Frame_pool:  Sets of .frame.pieces taken from culled application
+ *                  thumbnails, to be reused by those scrolled into view.
+ *                  Holds at most %FRAME_POOL_SIZE arrays, each referencing
+ *                  its pieces.
+ */
+static GPtrArray *Frame_pool;
+
 /* gtkrc articles */
 static const gchar *LargeSystemFont, *SystemFont, *SmallSystemFont;
 static ClutterColor DefaultTextColor;
@@ -768,69 +808,15 @@ static ClutterColor NotificationTextColor, NotificationSecondaryTextColor;
 
 /* Program code */
 /* Graphics loading {{{ */
-/* Destroying @pixbuf, turns it into a #ClutterTexture.
- * Returns %NULL on failure. */
-static ClutterActor *
-pixbuf2texture (GdkPixbuf *pixbuf)
+/* Resizes and crops @pixbuf as necessary to fit in a @aw x @ah rectangle.
+ * Runs on a worker thread of the image loader.  The result is finished
+ * by image_to_actor(). */
+static GdkPixbuf *
+prepare_image (GdkPixbuf *pixbuf, guint aw, guint ah)
 {
-  GError *err;
-  gboolean isok;
-  ClutterActor *texture;
-
-#ifndef G_DISABLE_CHECKS
-  if (gdk_pixbuf_get_colorspace (pixbuf) != GDK_COLORSPACE_RGB
-      || gdk_pixbuf_get_bits_per_sample (pixbuf) != 8
-      || gdk_pixbuf_get_n_channels (pixbuf) !=
-         (gdk_pixbuf_get_has_alpha (pixbuf) ? 4 : 3))
-    {
-      g_critical ("image not in expected rgb/8bps format");
-      goto damage_control;
-    }
-#endif
-
-  err = NULL;
-  texture = clutter_texture_new ();
-  isok = clutter_texture_set_from_rgb_data (CLUTTER_TEXTURE (texture),
-                                            gdk_pixbuf_get_pixels (pixbuf),
-                                            gdk_pixbuf_get_has_alpha (pixbuf),
-                                            gdk_pixbuf_get_width (pixbuf),
-                                            gdk_pixbuf_get_height (pixbuf),
-                                            gdk_pixbuf_get_rowstride (pixbuf),
-                                            gdk_pixbuf_get_n_channels (pixbuf),
-                                            0, &err);
-  if (!isok)
-    {
-      g_warning ("clutter_texture_set_from_rgb_data: %s", err->message);
-      g_object_unref (texture);
-damage_control: __attribute__((unused))
-      texture = NULL;
-    }
-
-  g_object_unref (pixbuf);
-  return texture;
-}
-
-/* Loads @fname, resizing and cropping it as necessary to fit
- * in a @aw x @ah rectangle.  Returns %NULL on error. */
-static ClutterActor *
-load_image (char const * fname, guint aw, guint ah)
-{
-  GError *err;
-  GdkPixbuf *pixbuf;
   gint dx, dy;
   gdouble dsx, dsy, scale;
   guint vw, vh, sw, sh, dw, dh;
-  ClutterActor *final;
-  ClutterActor *texture;
-
-  /* On error the caller sure has better recovery plan than an
-   * empty rectangle.  (ie. showing the real application window). */
-  err = NULL;
-  if (!(pixbuf = gdk_pixbuf_new_from_file (fname, &err)))
-    {
-      g_warning ("%s: %s", fname, err->message);
-      return NULL;
-    }
 
   /* @sw, @sh := size in pixels of the untransformed image. */
   sw = gdk_pixbuf_get_width (pixbuf);
@@ -897,8 +883,31 @@ load_image (char const * fname, guint aw, guint ah)
       pixbuf = tmp;
     }
 
-  if (!(texture = pixbuf2texture (pixbuf)))
-    return NULL;
+  return pixbuf;
+}
+
+/* Turns @pixbuf prepare_image()d for @aw x @ah into an actor which
+ * appears to be that large.  Returns %NULL on error. */
+static ClutterActor *
+image_to_actor (GdkPixbuf *pixbuf, guint aw, guint ah)
+{
+  GError *err;
+  guint vw, vh, dw, dh;
+  ClutterActor *final;
+  ClutterActor *texture;
+
+  err = NULL;
+  if (!(texture = hd_image_loader_pixbuf_to_texture (pixbuf, &err)))
+    {
+      g_warning ("%s: %s", __FUNCTION__, err->message);
+      g_error_free (err);
+      return NULL;
+    }
+
+  vw = aw / 2;
+  vh = ah / 2;
+  dw = gdk_pixbuf_get_width (pixbuf);
+  dh = gdk_pixbuf_get_height (pixbuf);
 
   /* If @pixbuf is smaller than desired place it centered
    * on a @vw x @vh size black background. */
@@ -1049,6 +1058,90 @@ need_to_animate (ClutterActor * actor)
 /* Animations }}} */
 
 /* Effects infrastructure {{{ */
+/* Effect clock {{{ */
+/*
+ * Rather than each effect connecting to ::new-frame on its own,
+ * timelines with effects have a single handler, advance_effects(),
+ * which steps all of them at once.  This is attached to the timeline
+ * as long as it has effects with a frame_fun.
+ */
+typedef struct
+{
+  guint  neffects;
+  gulong new_frame_cb_id;
+} EffectClock;
+
+/* @timeline's ::new-frame handler.  Applies the current frame of all
+ * @Effects of @timeline.  Property notifications of the actors are held
+ * back until all of them are updated, so even an actor with several
+ * effects is notified only once about each property. */
+static void
+advance_effects (ClutterTimeline * timeline, gint frame, gpointer unused)
+{
+  static GPtrArray *frozen;
+  guint i, ntweens;
+  EffectClosure *closure;
+
+  if (G_UNLIKELY (!frozen))
+    frozen = g_ptr_array_new ();
+
+  ntweens = 0;
+  for (i = 0; i < Effects->len; i++)
+    {
+      closure = g_ptr_array_index (Effects, i);
+      if (closure->timeline != timeline || !closure->frame_fun)
+        continue;
+
+      g_object_freeze_notify (G_OBJECT (closure->actor));
+      g_ptr_array_add (frozen, g_object_ref (closure->actor));
+      closure->frame_fun (timeline, frame, closure);
+      ntweens++;
+    }
+
+  for (i = 0; i < frozen->len; i++)
+    {
+      g_object_thaw_notify (G_OBJECT (frozen->pdata[i]));
+      g_object_unref (frozen->pdata[i]);
+    }
+  g_ptr_array_set_size (frozen, 0);
+
+  hd_stats_count_n (HD_STATS_TWEENS, ntweens);
+}
+
+/* Registers an effect with a frame function on @timeline. */
+static void
+effect_clock_ref (ClutterTimeline * timeline)
+{
+  EffectClock *clock;
+
+  if (!(clock = g_object_get_data (G_OBJECT (timeline), "effect-clock")))
+    {
+      clock = g_new0 (EffectClock, 1);
+      clock->new_frame_cb_id = g_signal_connect (timeline, "new-frame",
+                                          G_CALLBACK (advance_effects),
+                                          NULL);
+      g_object_set_data_full (G_OBJECT (timeline), "effect-clock",
+                              clock, g_free);
+    }
+  clock->neffects++;
+}
+
+/* Undoes effect_clock_ref(). */
+static void
+effect_clock_unref (ClutterTimeline * timeline)
+{
+  EffectClock *clock;
+
+  clock = g_object_get_data (G_OBJECT (timeline), "effect-clock");
+  g_assert (clock && clock->neffects > 0);
+  if (!--clock->neffects)
+    {
+      g_signal_handler_disconnect (timeline, clock->new_frame_cb_id);
+      g_object_set_data (G_OBJECT (timeline), "effect-clock", NULL);
+    }
+}
+/* Effect clock }}} */
+
 /* General {{{ */
 /* Returns whether @actos has an effect with @frame_fun.  Effects can use it
  * to recognize themselves and modify the existing one rather than starting
@@ -1074,7 +1167,7 @@ has_effect (ClutterActor * actor, gconstpointer effectid)
 }
 
 /* Allocates an #EffectClosure and fills in the common fields.
- * Adds signals to @timeline. */
+ * Puts it on the clock of @timeline. */
 static EffectClosure *
 new_effect (ClutterTimeline * timeline, ClutterActor * actor,
   void (*frame_fun)(ClutterTimeline *, gint, EffectClosure *),
@@ -1085,12 +1178,9 @@ new_effect (ClutterTimeline * timeline, ClutterActor * actor,
   closure = g_slice_new0 (EffectClosure);
   closure->actor = g_object_ref (actor);
 
+  closure->frame_fun = frame_fun;
   if (frame_fun)
-    closure->new_frame_cb_id = g_signal_connect (timeline, "new-frame",
-                                                 G_CALLBACK (frame_fun),
-                                                 closure);
-  else
-    closure->new_frame_cb_id = 0;
+    effect_clock_ref (timeline);
   closure->timeline_complete_cb_id = g_signal_connect (timeline, "completed",
                                               G_CALLBACK (complete_fun),
                                               closure);
@@ -1119,8 +1209,8 @@ free_effect (ClutterTimeline * timeline, EffectClosure * closure)
     g_critical ("closure not in Effects");
   g_assert (timeline == closure->timeline);
 
-  if (closure->new_frame_cb_id)
-    g_signal_handler_disconnect (timeline, closure->new_frame_cb_id);
+  if (closure->frame_fun)
+    effect_clock_unref (timeline);
   g_signal_handler_disconnect (timeline, closure->timeline_complete_cb_id);
   g_object_unref (timeline);
   g_object_unref (closure->actor);
@@ -2236,6 +2326,22 @@ layout_notwin (Thumbnail * thumb, const GtkRequisition * oldthsize,
                 / clutter_actor_get_width (tnote->separator), 1);
 }
 
+static void cull_thumbs (void);
+static void uncull_thumb (Thumbnail * thumb);
+
+/* Tells whether a thumbnail at @ypos on the @Grid is within a row
+ * of the viewport, ie. whether it should be materialized. */
+static gboolean
+near_viewport (gfloat ypos)
+{
+  gfloat top, bottom, margin;
+
+  margin = Thumbsize->height + GRID_VERTICAL_GAP;
+  top    = hd_scrollable_group_get_viewport_y (Grid) - margin;
+  bottom = top + DESKTOP_HEIGHT + 2*margin;
+  return top < ypos + Thumbsize->height && ypos < bottom;
+}
+
 /*
  * Lays out @Thumbnails on @Grid, and their inner portions.  Makes actors fly
  * if it's appropriate.  @newborn is either a new thumbnail or notification
@@ -2298,6 +2404,16 @@ layout_thumbs (ClutterActor * newborn)
        * a new one to enter the navigator, don't, it's hidden anyway. */
       ops = thumb->thwin == newborn ? &Fly_at_once : &Fly_smoothly;
 
+      /* Culled thumbnails are only brought back if they are moving
+       * into view, otherwise there's no point animating them. */
+      if (thumb->culled)
+        {
+          if (near_viewport (ythumb))
+            uncull_thumb (thumb);
+          else
+            ops = &Fly_at_once;
+        }
+
       /* Place @thwin in any case. */
       ops->move (thumb->thwin, xthumb, ythumb);
 
@@ -2360,7 +2476,8 @@ layout_thumbs (ClutterActor * newborn)
                 appwgw,
                 appwgh + app_geom_fix + (IS_PORTRAIT?HD_COMP_MGR_TOP_MARGIN:0));
 
-          layout_thumb_frame (thumb, ops, landscape);
+          if (!thumb->culled)
+            layout_thumb_frame (thumb, ops, landscape);
         }
 
 skip_the_circus:
@@ -2386,6 +2503,14 @@ layout (ClutterActor * newborn, gboolean newborn_is_notification)
         add_effect_closure (Fly_effect_timeline, fade_in_when_complete,
                             newborn, GINT_TO_POINTER (NOTIFADE_IN_DURATION));
     }
+
+  /* Those which flew out of view can be culled when they've landed. */
+  if (animation_in_progress (Fly_effect_timeline))
+    add_effect_closure (Fly_effect_timeline,
+                        CLUTTER_CALLBACK (cull_thumbs),
+                        CLUTTER_ACTOR (Grid), NULL);
+  else
+    cull_thumbs ();
 }
 /* Layout engine }}} */
 
@@ -2518,6 +2643,17 @@ free_thumb (Thumbnail * thumb, gboolean animate)
 
   if (thumb_is_application (thumb))
     {
+      if (thumb->video_job)
+        hd_image_loader_cancel (thumb->video_job);
+      if (thumb->video_reload_id)
+        g_source_remove (thumb->video_reload_id);
+      if (thumb->video_monitor)
+        {
+          g_signal_handlers_disconnect_matched (thumb->video_monitor,
+                          G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, thumb);
+          g_file_monitor_cancel (thumb->video_monitor);
+          g_object_unref (thumb->video_monitor);
+        }
       if (thumb->apwin)
         g_object_unref (thumb->apwin);
 
@@ -2556,56 +2692,159 @@ free_thumb (Thumbnail * thumb, gboolean animate)
 
 /* Application thumbnails {{{ */
 /* Child adoption {{{ */
-/* Returns whether the application represented by @apthumb has
- * a video screenshot and it should be loaded or reloaded.
- * If so it refreshes @apthumb->video_mtime. */
-static gboolean
-need_to_load_video (Thumbnail * apthumb)
+/*
+ * Enables or disables the snapshot of a thumbnail's .@windows.  With the
+ * snapshot the windows are rendered into a thumbnail-sized texture when
+ * they change and that is painted instead of the full-size windows.
+ * It's disabled while zooming, when the thumbnail is shown in full size.
+ */
+static void
+set_snapshot (ClutterActor * windows, gboolean enable)
 {
-  /* Already has a video loaded? */
-  if (apthumb->video)
+  ClutterEffect *effect;
+
+  if (!(effect = clutter_actor_get_effect (windows,
+                                           TIDY_SNAPSHOT_EFFECT_NAME)))
+    return;
+
+  if (enable && !clutter_actor_meta_get_enabled (CLUTTER_ACTOR_META (effect)))
+    /* It may have changed a lot in the meantime. */
+    tidy_snapshot_effect_invalidate (effect);
+  clutter_actor_meta_set_enabled (CLUTTER_ACTOR_META (effect), enable);
+}
+
+/* add_effect_closure() callback for hd_task_navigator_zoom_out(). */
+static void
+enable_snapshot (ClutterActor * windows, gpointer unused)
+{
+  set_snapshot (windows, TRUE);
+}
+
+/* Called when the video screenshot of @apthumb has been decoded. */
+static void
+video_loaded (HdImageLoaderJob * job, GdkPixbuf * pixbuf,
+              const GError * error, gpointer apthumb_ptr)
+{
+  Thumbnail *apthumb = apthumb_ptr;
+  ClutterActor *video;
+
+  g_assert (apthumb->video_job == job);
+  apthumb->video_job = NULL;
+
+  /* On error the real application window (or the previous screenshot)
+   * remains shown, that's a better recovery plan than an empty rectangle.
+   * Not having a screenshot at all is perfectly normal. */
+  if (!pixbuf)
     {
-      struct stat sbuf;
-      gboolean clear_video, load_video;
+      if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        g_warning ("%s: %s", apthumb->video_fname, error->message);
+      return;
+    }
 
-      /* Refresh or unload it? */
-      load_video = clear_video = FALSE;
-      g_assert (apthumb->video_fname);
-      if (stat (apthumb->video_fname, &sbuf) < 0)
-        {
-          if (errno != ENOENT)
-            g_warning ("%s: %m", apthumb->video_fname);
-          clear_video = TRUE;
-        }
-      else if (sbuf.st_mtime > apthumb->video_mtime)
-        {
-          clear_video = load_video = TRUE;
-          apthumb->video_mtime = sbuf.st_mtime;
-        }
+  /* Make it appear as if .video were .apwin, having the same geometry. */
+  video = image_to_actor (pixbuf, App_window_geometry_width,
+                          App_window_geometry_height);
+  if (!video)
+    return;
 
-      if (clear_video)
-        {
-          clutter_actor_remove_child (apthumb->prison, apthumb->video);
-          apthumb->video = NULL;
-        }
+  clutter_actor_set_name (video, "video");
+  clutter_actor_set_position (video, App_window_geometry_x,
+                              App_window_geometry_y);
+  if (apthumb->video)
+    clutter_actor_remove_child (apthumb->prison, apthumb->video);
+  apthumb->video = video;
+  clutter_actor_add_child (CLUTTER_ACTOR (apthumb->prison), apthumb->video);
+
+  /* Only show @apthumb->video.  If we're not active claim_win()
+   * will take care of it. */
+  if (hd_task_navigator_is_active ())
+    clutter_actor_hide (apthumb->windows);
+}
 
-      return load_video;
+/* Starts loading the video screenshot of @apthumb in the background,
+ * video_loaded() will place its actor in the hierarchy. */
+static gboolean
+reload_video (Thumbnail * apthumb)
+{
+  apthumb->video_reload_id = 0;
+  if (apthumb->video_job)
+    hd_image_loader_cancel (apthumb->video_job);
+  apthumb->video_job = hd_image_loader_load (apthumb->video_fname,
+                                             prepare_image,
+                                             App_window_geometry_width,
+                                             App_window_geometry_height,
+                                             G_PRIORITY_DEFAULT_IDLE,
+                                             video_loaded, apthumb);
+  return FALSE;
+}
+
+/* Removes the video screenshot of @apthumb, showing its windows. */
+static void
+drop_video (Thumbnail * apthumb)
+{
+  if (apthumb->video_reload_id)
+    {
+      g_source_remove (apthumb->video_reload_id);
+      apthumb->video_reload_id = 0;
     }
-  else if (apthumb->video_fname)
+  if (apthumb->video_job)
     {
-      struct stat sbuf;
+      hd_image_loader_cancel (apthumb->video_job);
+      apthumb->video_job = NULL;
+    }
 
-      /* Do we need to load it? */
-      if (stat (apthumb->video_fname, &sbuf) == 0)
-        {
-          apthumb->video_mtime = sbuf.st_mtime;
-          return TRUE;
-        }
-      else if (errno != ENOENT)
-        g_warning ("%s: %m", apthumb->video_fname);
+  if (apthumb->video)
+    {
+      clutter_actor_remove_child (apthumb->prison, apthumb->video);
+      apthumb->video = NULL;
+      if (hd_task_navigator_is_active ())
+        clutter_actor_show (apthumb->windows);
     }
+}
 
-  return FALSE;
+/* @apthumb->video_monitor's ::changed handler. */
+static void
+video_changed (GFileMonitor * monitor, GFile * file, GFile * other_file,
+               GFileMonitorEvent event_type, Thumbnail * apthumb)
+{
+  switch (event_type)
+    {
+      case G_FILE_MONITOR_EVENT_CREATED:
+      case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+        /* The screenshot may be being written, give it some time. */
+        if (apthumb->video_reload_id)
+          g_source_remove (apthumb->video_reload_id);
+        apthumb->video_reload_id = g_timeout_add (VIDEO_RELOAD_DELAY,
+                                          (GSourceFunc)reload_video,
+                                          apthumb);
+        break;
+      case G_FILE_MONITOR_EVENT_DELETED:
+        drop_video (apthumb);
+        break;
+      default:
+        break;
+    }
+}
+
+/* Loads the video screenshot of @apthumb if it has one and keeps it
+ * up to date, so entering the switcher doesn't need to look at it. */
+static void
+watch_video (Thumbnail * apthumb)
+{
+  GFile *file;
+
+  file = g_file_new_for_path (apthumb->video_fname);
+  apthumb->video_monitor = g_file_monitor_file (file, G_FILE_MONITOR_NONE,
+                                                NULL, NULL);
+  g_object_unref (file);
+
+  if (apthumb->video_monitor)
+    g_signal_connect (apthumb->video_monitor, "changed",
+                      G_CALLBACK (video_changed), apthumb);
+  else
+    g_warning ("%s: cannot watch", apthumb->video_fname);
+
+  reload_video (apthumb);
 }
 
 /* Start managing @apthumb's application window and loads/reloads its
@@ -2623,6 +2862,7 @@ claim_win (Thumbnail * apthumb)
    * appearing in the background if it's added in switcher mode.
    * TODO This may not be true anymore.
    */
+  hd_render_manager_remove_occlusion_clip (apthumb->apwin);
   clutter_actor_reparent(apthumb->apwin, apthumb->windows);
   if (apthumb->cemetery)
     {
@@ -2630,6 +2870,8 @@ claim_win (Thumbnail * apthumb)
 
       for (i = 0; i < apthumb->cemetery->len; i++)
         {
+          hd_render_manager_remove_occlusion_clip (
+                                  apthumb->cemetery->pdata[i]);
           clutter_actor_reparent (apthumb->cemetery->pdata[i],
                                   apthumb->windows);
           clutter_actor_hide (apthumb->cemetery->pdata[i]);
@@ -2641,25 +2883,9 @@ claim_win (Thumbnail * apthumb)
                          (GFunc)clutter_actor_reparent,
                          apthumb->windows);
 
-  /* Load the video screenshot and place its actor in the hierarchy. */
-  if (need_to_load_video (apthumb))
-    {
-      /* Make it appear as if .video were .apwin,
-       * having the same geometry. */
-      g_assert (!apthumb->video);
-      apthumb->video = load_image (apthumb->video_fname,
-                                   App_window_geometry_width,
-                                   App_window_geometry_height);
-      if (apthumb->video)
-        {
-          clutter_actor_set_name (apthumb->video, "video");
-          clutter_actor_set_position (apthumb->video, App_window_geometry_x,
-                                      App_window_geometry_y);
-          clutter_actor_add_child (CLUTTER_ACTOR (apthumb->prison),
-                                   apthumb->video);
-        }
-    }
-
+  /* The video screenshot is kept up to date by watch_video(),
+   * show it if we have one, otherwise the real windows. */
+  set_snapshot (apthumb->windows, TRUE);
   if (!apthumb->video)
     /* Needn't bother with show_all() the contents of .windows,
      * they are shown anyway because of reparent(). */
@@ -2685,6 +2911,13 @@ claim_win (Thumbnail * apthumb)
 static void
 release_win (const Thumbnail * apthumb)
 {
+  ClutterEffect *effect;
+
+  /* Don't keep the snapshot while we're not shown. */
+  if ((effect = clutter_actor_get_effect (apthumb->windows,
+                                          TIDY_SNAPSHOT_EFFECT_NAME)))
+    tidy_snapshot_effect_invalidate (effect);
+
   hd_render_manager_return_app (apthumb->apwin);
   if (apthumb->cemetery)
     g_ptr_array_foreach (apthumb->cemetery,
@@ -2929,9 +3162,13 @@ hd_task_navigator_zoom_in (HdTaskNavigator * self, ClutterActor * win,
   /* Must have gotten a gtk_window_present() during a zooming, ignore it. */
   if (animation_in_progress (Zoom_effect_timeline))
     goto damage_control;
+  if (apthumb->culled)
+    uncull_thumb ((Thumbnail *)apthumb);
 
-  /* This is the actual zooming, but we do other effects as well. */
+  /* This is the actual zooming, but we do other effects as well.
+   * Show the real windows, the snapshot would be blurry. */
   hd_render_manager_unzoom_background ();
+  set_snapshot (apthumb->windows, FALSE);
   zoom_in (apthumb);
 
   /* Crossfade .plate with .titlebar. */
@@ -3057,6 +3294,11 @@ hd_task_navigator_zoom_out (HdTaskNavigator * self, ClutterActor * win,
   clutter_actor_effect_scale (Scroller, ZOOM_EFFECT_DURATION, 1, 1);
   clutter_actor_effect_move  (Scroller, ZOOM_EFFECT_DURATION, 0, 0);
 
+  /* Show the real windows until they are thumbnail-sized. */
+  set_snapshot (apthumb->windows, FALSE);
+  add_effect_closure (Zoom_effect_timeline, enable_snapshot,
+                      apthumb->windows, NULL);
+
   /* Crossfade .plate with .titlebar.  (Earlier i said "It's okay to leave
    * .titlebar shown but transparent." but i can't recall why.  Anyway,
    * let's hide it afterwards.) */
@@ -3217,10 +3459,9 @@ win_title_changed (MBWMClientWindow * win, int unused1, Thumbnail * apthumb)
   return True;
 }
 
-/* Dress a %Thumbnail: create @thumb->frame.all and populate it
- * with frame graphics. */
+/* Fills @pieces with new frame graphics, see %Thumbnail.frame. */
 static void
-create_apthumb_frame (Thumbnail * apthumb)
+create_frame_pieces (ClutterActor ** pieces)
 {
   static struct
   {
@@ -3241,20 +3482,144 @@ create_apthumb_frame (Thumbnail * apthumb)
 
   guint i;
 
+  for (i = 0; i < G_N_ELEMENTS (frames); i++)
+    {
+      pieces[i] = hd_clutter_cache_get_texture (frames[i].fname, TRUE);
+      clutter_actor_set_anchor_point_from_gravity (pieces[i],
+                                                   frames[i].gravity);
+    }
+
+  /* .mep */
+  clutter_actor_set_rotation(pieces[4],CLUTTER_Z_AXIS,90.0,0,0,0);
+  clutter_actor_set_scale(pieces[4],0.00001,0.00001);
+}
+
+/* Populates @apthumb->frame.all with frame graphics, either recycled
+ * from @Frame_pool or new ones.  They still need to be layed out. */
+static void
+dress_apthumb (Thumbnail * apthumb)
+{
+  guint i;
+  ClutterActor **pieces;
+
+  pieces = Frame_pool && Frame_pool->len > 0
+    ? g_ptr_array_remove_index_fast (Frame_pool, Frame_pool->len - 1)
+    : NULL;
+  if (pieces)
+    memcpy (apthumb->frame.pieces, pieces, sizeof (apthumb->frame.pieces));
+  else
+    create_frame_pieces (apthumb->frame.pieces);
+
+  for (i = 0; i < G_N_ELEMENTS (apthumb->frame.pieces); i++)
+    {
+      clutter_actor_add_child (apthumb->frame.all, apthumb->frame.pieces[i]);
+      if (pieces)
+        /* Drop the reference of the pool. */
+        g_object_unref (apthumb->frame.pieces[i]);
+    }
+  g_free (pieces);
+}
+
+/* Undoes dress_apthumb(), putting the pieces in @Frame_pool
+ * unless it's full. */
+static void
+undress_apthumb (Thumbnail * apthumb)
+{
+  guint i;
+  ClutterActor **pieces;
+
+  if (!Frame_pool)
+    Frame_pool = g_ptr_array_new ();
+  pieces = Frame_pool->len < FRAME_POOL_SIZE
+    ? g_new (ClutterActor *, G_N_ELEMENTS (apthumb->frame.pieces))
+    : NULL;
+
+  for (i = 0; i < G_N_ELEMENTS (apthumb->frame.pieces); i++)
+    {
+      if (pieces)
+        pieces[i] = g_object_ref (apthumb->frame.pieces[i]);
+      clutter_actor_remove_child (apthumb->frame.all,
+                                  apthumb->frame.pieces[i]);
+      apthumb->frame.pieces[i] = NULL;
+    }
+
+  if (pieces)
+    g_ptr_array_add (Frame_pool, pieces);
+}
+
+/* Dress a %Thumbnail: create @thumb->frame.all and populate it
+ * with frame graphics. */
+static void
+create_apthumb_frame (Thumbnail * apthumb)
+{
   apthumb->frame.all = clutter_group_new ();
   clutter_actor_set_name (apthumb->frame.all, "apthumb frame");
+  dress_apthumb (apthumb);
+}
 
-  for (i = 0; i < G_N_ELEMENTS (frames); i++)
+/* Hides @thumb, which is far from the viewport, and releases what
+ * we can get back when it's scrolled into view. */
+static void
+cull_thumb (Thumbnail * thumb)
+{
+  thumb->culled = TRUE;
+  clutter_actor_hide (thumb->thwin);
+
+  if (thumb_is_application (thumb))
     {
-      apthumb->frame.pieces[i] = hd_clutter_cache_get_texture (
-                                                 frames[i].fname, TRUE);
-      clutter_actor_set_anchor_point_from_gravity (apthumb->frame.pieces[i],
-                                                   frames[i].gravity);
-      clutter_actor_add_child (CLUTTER_ACTOR (apthumb->frame.all),
-                               apthumb->frame.pieces[i]);
+      undress_apthumb (thumb);
+      tidy_snapshot_effect_invalidate (
+               clutter_actor_get_effect (thumb->windows,
+                                         TIDY_SNAPSHOT_EFFECT_NAME));
+    }
+}
+
+/* Undoes cull_thumb(). */
+static void
+uncull_thumb (Thumbnail * thumb)
+{
+  thumb->culled = FALSE;
+  if (thumb_is_application (thumb))
+    {
+      dress_apthumb (thumb);
+      layout_thumb_frame (thumb, &Fly_at_once,
+                          IS_PORTRAIT
+                            && !hd_task_navigator_app_portrait_capable (thumb));
+    }
+
+  clutter_actor_show (thumb->thwin);
+}
+
+/*
+ * Culls the @Thumbnails farther than a row from the viewport of the @Grid
+ * and brings back those which got closer.  Called when the @Grid is scrolled
+ * or layed out.  Culled thumbnails are not painted, picked or animated, so
+ * with lots of them the navigator costs about the same as with a few.
+ * Thumbnails in the middle of some animation are left alone.
+ */
+static void
+cull_thumbs (void)
+{
+  const GList *li;
+  Thumbnail *thumb;
+  gboolean flying;
+
+  if (!Thumbsize)
+    return;
+
+  flying = animation_in_progress (Fly_effect_timeline)
+    || animation_in_progress (Zoom_effect_timeline);
+  for_each_thumbnail (li, thumb)
+    {
+      if (near_viewport (clutter_actor_get_y (thumb->thwin)))
+        {
+          if (thumb->culled)
+            uncull_thumb (thumb);
+        }
+      else if (!thumb->culled && !flying
+               && clutter_actor_is_visible (thumb->thwin))
+        cull_thumb (thumb);
     }
-  clutter_actor_set_rotation(apthumb->frame.mep,CLUTTER_Z_AXIS,90.0,0,0,0);
-  clutter_actor_set_scale(apthumb->frame.mep,0.00001,0.00001);
 }
 
 /* Returns a %Thumbnail for @apwin, a window manager client actor.
@@ -3316,6 +3681,10 @@ create_appthumb (ClutterActor * apwin)
   /* See mb_wm_comp_mgr_clutter_client_actor_reparent_cb - we check this to
    * see if we should linear filter the actor or not */
   g_object_set_data(G_OBJECT(apthumb->windows), "FILTER_LINEAR", (void*)1);
+  if (THUMB_SNAPSHOT_INTERVAL >= 0)
+    clutter_actor_add_effect_with_name (apthumb->windows,
+                  TIDY_SNAPSHOT_EFFECT_NAME,
+                  tidy_snapshot_effect_new (THUMB_SNAPSHOT_INTERVAL));
 
   /* .prison: anchor it so that we can ignore the UI framework area
    * of its contents.  Do so even if @apwin is really fullscreen,
@@ -3355,6 +3724,10 @@ create_appthumb (ClutterActor * apwin)
         }
     }
 
+  /* Start watching the video screenshot. */
+  if (apthumb->video_fname)
+    watch_video (apthumb);
+
   /* Finally, have a title. */
   if (!thumb_has_notification (apthumb))
     reset_thumb_title (apthumb);
@@ -4411,6 +4784,8 @@ new_animation (ClutterTimeline ** timelinep, guint duration)
 static void
 hd_task_navigator_init (HdTaskNavigator * self)
 {
+  TidyAdjustment *vadj;
+
   Navigator = CLUTTER_ACTOR (self);
   clutter_actor_set_reactive (Navigator, TRUE);
   clutter_actor_set_size (Navigator, SCREEN_WIDTH, SCREEN_HEIGHT);
@@ -4454,6 +4829,11 @@ hd_task_navigator_init (HdTaskNavigator * self)
                     G_CALLBACK (grid_clicked), NULL);
   clutter_container_add_actor (CLUTTER_CONTAINER (Scroller), CLUTTER_ACTOR (Grid));
 
+  /* Only keep the thumbnails around the viewport materialized. */
+  tidy_scrollable_get_adjustments (TIDY_SCROLLABLE (Grid), NULL, &vadj);
+  g_signal_connect_swapped (vadj, "notify::value",
+                            G_CALLBACK (cull_thumbs), NULL);
+
   /* Effect timelines */
   /*Fly_effect  = new_animation (&Fly_effect_timeline,  FLY_EFFECT_DURATION);
   Zoom_effect = new_animation (&Zoom_effect_timeline, ZOOM_EFFECT_DURATION);*/
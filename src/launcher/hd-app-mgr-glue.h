@@ -147,6 +147,55 @@ dbus_glib_marshal_hd_app_mgr_BOOLEAN__STRING_POINTER (GClosure     *closure,
   g_value_set_boolean (return_value, v_return);
 }
 
+/* BOOLEAN:BOOLEAN,POINTER,POINTER (/var/tmp/dbus-binding-tool-c-marshallers.ZB9HNV:3) */
+extern void dbus_glib_marshal_hd_app_mgr_BOOLEAN__BOOLEAN_POINTER_POINTER (GClosure     *closure,
+                                                                           GValue       *return_value,
+                                                                           guint         n_param_values,
+                                                                           const GValue *param_values,
+                                                                           gpointer      invocation_hint,
+                                                                           gpointer      marshal_data);
+void
+dbus_glib_marshal_hd_app_mgr_BOOLEAN__BOOLEAN_POINTER_POINTER (GClosure     *closure,
+                                                               GValue       *return_value G_GNUC_UNUSED,
+                                                               guint         n_param_values,
+                                                               const GValue *param_values,
+                                                               gpointer      invocation_hint G_GNUC_UNUSED,
+                                                               gpointer      marshal_data)
+{
+  typedef gboolean (*GMarshalFunc_BOOLEAN__BOOLEAN_POINTER_POINTER) (gpointer     data1,
+                                                                     gboolean     arg_1,
+                                                                     gpointer     arg_2,
+                                                                     gpointer     arg_3,
+                                                                     gpointer     data2);
+  register GMarshalFunc_BOOLEAN__BOOLEAN_POINTER_POINTER callback;
+  register GCClosure *cc = (GCClosure*) closure;
+  register gpointer data1, data2;
+  gboolean v_return;
+
+  g_return_if_fail (return_value != NULL);
+  g_return_if_fail (n_param_values == 4);
+
+  if (G_CCLOSURE_SWAP_DATA (closure))
+    {
+      data1 = closure->data;
+      data2 = g_value_peek_pointer (param_values + 0);
+    }
+  else
+    {
+      data1 = g_value_peek_pointer (param_values + 0);
+      data2 = closure->data;
+    }
+  callback = (GMarshalFunc_BOOLEAN__BOOLEAN_POINTER_POINTER) (marshal_data ? marshal_data : cc->callback);
+
+  v_return = callback (data1,
+                       g_marshal_value_peek_boolean (param_values + 1),
+                       g_marshal_value_peek_pointer (param_values + 2),
+                       g_marshal_value_peek_pointer (param_values + 3),
+                       data2);
+
+  g_value_set_boolean (return_value, v_return);
+}
+
 G_END_DECLS
 
 #endif /* __dbus_glib_marshal_hd_app_mgr_MARSHAL_H__ */
@@ -155,13 +204,14 @@ G_END_DECLS
 static const DBusGMethodInfo dbus_glib_hd_app_mgr_methods[] = {
   { (GCallback) hd_app_mgr_dbus_launch_app, dbus_glib_marshal_hd_app_mgr_BOOLEAN__STRING_POINTER, 0 },
   { (GCallback) hd_app_mgr_dbus_prestart, dbus_glib_marshal_hd_app_mgr_BOOLEAN__BOOLEAN_POINTER, 68 },
+  { (GCallback) hd_app_mgr_dbus_get_launch_stats, dbus_glib_marshal_hd_app_mgr_BOOLEAN__BOOLEAN_POINTER_POINTER, 122 },
 };
 
 const DBusGObjectInfo dbus_glib_hd_app_mgr_object_info = {
   0,
   dbus_glib_hd_app_mgr_methods,
-  2,
-"com.nokia.HildonDesktop.AppMgr\0LaunchApplication\0S\0application\0I\0s\0\0com.nokia.HildonDesktop.AppMgr\0Prestart\0S\0enable\0I\0b\0\0\0",
+  3,
+"com.nokia.HildonDesktop.AppMgr\0LaunchApplication\0S\0application\0I\0s\0\0com.nokia.HildonDesktop.AppMgr\0Prestart\0S\0enable\0I\0b\0\0com.nokia.HildonDesktop.AppMgr\0GetLaunchStats\0S\0reset\0I\0b\0stats\0O\0F\0N\0s\0\0\0",
 "\0",
 "\0"
 };
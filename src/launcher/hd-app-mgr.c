@@ -46,11 +46,14 @@
 #include <mce/mode-names.h>
 #include "hd-launcher.h"
 #include "hd-launcher-tree.h"
+#include "hd-prestart-policy.h"
+#include "hd-launch-trace.h"
 #include "home/hd-render-manager.h"
 #include "home/hd-home-view-container.h"
 #include "hd-transition.h"
 #include "hd-wm.h"
 #include "hd-orientation-lock.h"
+#include "hd-stats.h"
 
 #undef  G_LOG_DOMAIN
 #define G_LOG_DOMAIN "hd-app-mgr"
@@ -105,11 +108,28 @@ struct _HdAppMgrPrivate
   /* All the running apps we know about. */
   GList *running_apps;
 
+  /* The application launchers of @tree indexed by what
+   * hd_launcher_app_match_window() looks at: their WM class, their
+   * executable and the (lowercase) prefixes of their id.  Each maps
+   * to the first such launcher in the tree, whose position in the
+   * tree + 1 is in @launcher_positions.  Rebuilt when the tree is. */
+  GHashTable *launchers_by_class, *launchers_by_exec, *launchers_by_id;
+  GHashTable *launcher_positions;
+
   /* Each one of these lists contain different HdRunningApps. */
   GQueue *queues[NUM_QUEUES];
 
-  /* Is the state check already looping? */
-  gboolean state_check_looping;
+  /* The pending state check, if any.  It's @state_check_waiting if
+   * it's only there to retry prestarting after @prestart_backoff
+   * seconds, and can be brought forward by changes in memory. */
+  guint state_check_id;
+  guint prestart_backoff;
+  gboolean state_check_waiting;
+
+  /* Launch history deciding what to prestart first, and the pending
+   * hd_app_mgr_save_prestart_history(). */
+  HdPrestartPolicy *prestart_policy;
+  guint prestart_save_id;
 
   /* Memory limits. */
   HdAppMgrPrestartMode prestart_mode;
@@ -165,10 +185,20 @@ G_DEFINE_TYPE (HdAppMgr, hd_app_mgr, G_TYPE_OBJECT);
 
 #define LOADAVG_MAX               (1.0)
 #define STATE_CHECK_INTERVAL      (1)
+/* Wait at most this many seconds before trying to prestart again
+ * if there wasn't enough memory or the load was too high. */
+#define PRESTART_BACKOFF_MAX      (32)
 #define LOADING_TIMEOUT           (10)
 #define INIT_DONE_TIMEOUT         (5)
 
 #define PRESTART_ENV_VAR          "HILDON_DESKTOP_APPS_PRESTART"
+#define PRESTART_HISTORY_DIR      "hildon-desktop"
+#define PRESTART_HISTORY_FILE     "prestart-history"
+/* Save the history this many seconds after it has changed, so it
+ * survives a crash but doesn't cause a write on every launch. */
+#define PRESTART_HISTORY_SAVE_DELAY (60)
+/* If set, launches are logged to this file for tests/test-prestart-sim. */
+#define PRESTART_TRACE_ENV_VAR    "HILDON_DESKTOP_PRESTART_TRACE"
 #define NSIZE                     ((size_t)(-1))
 #define PRESTART_ENV_AUTO         ((size_t)(-2))
 #define PRESTART_ENV_NEVER        ((size_t)(-3))
@@ -256,7 +286,9 @@ static void hd_app_mgr_move_queue (HdAppMgrQueue queue_from,
                                    HdAppMgrQueue queue_to,
                                    HdRunningApp *app);
 
-static size_t   hd_app_mgr_read_lowmem (const gchar *filename);
+static gssize   hd_app_mgr_read_proc (const gchar *filename, gint *fd,
+                                      gchar *buffer, gsize size);
+static size_t   hd_app_mgr_read_lowmem (const gchar *filename, gint *fd);
 static HdAppMgrPrestartMode
 hd_app_mgr_setup_prestart (size_t low_pages,
                            size_t nr_decay_pages,
@@ -296,6 +328,7 @@ static gboolean hd_app_mgr_loading_timeout (HdRunningApp *app);
 static gboolean hd_app_mgr_init_done_timeout (HdAppMgr *self);
 
 static void hd_app_mgr_kill_all_prestarted (void);
+static void hd_app_mgr_queue_prestart_save (void);
 
 /* The HdLauncher singleton */
 static HdAppMgr *the_app_mgr = NULL;
@@ -419,6 +452,19 @@ hd_app_mgr_init (HdAppMgr *self)
   for (int i = 0; i < NUM_QUEUES; i++)
     priv->queues[i] = g_queue_new ();
 
+  priv->prestart_backoff = STATE_CHECK_INTERVAL;
+  priv->prestart_policy = hd_prestart_policy_new ();
+  {
+    gchar *fname = g_build_filename (g_get_user_cache_dir (),
+                                     PRESTART_HISTORY_DIR,
+                                     PRESTART_HISTORY_FILE, NULL);
+    hd_prestart_policy_load (priv->prestart_policy, fname);
+    g_free (fname);
+  }
+  if (getenv (PRESTART_TRACE_ENV_VAR))
+    hd_prestart_policy_set_trace (priv->prestart_policy,
+                                  getenv (PRESTART_TRACE_ENV_VAR));
+
   priv->tree = hd_launcher_tree_new ();
   hd_launcher_tree_ensure_user_menu ();
   g_signal_connect (priv->tree, "finished",
@@ -501,9 +547,11 @@ hd_app_mgr_init (HdAppMgr *self)
     }
 
   /* Start memory limits. */
-  priv->notify_low_pages = hd_app_mgr_read_lowmem (LOWMEM_PROC_NOTIFY_LOW);
-  priv->notify_high_pages = hd_app_mgr_read_lowmem (LOWMEM_PROC_NOTIFY_HIGH);
-  priv->nr_decay_pages = hd_app_mgr_read_lowmem (LOWMEM_PROC_NR_DECAY);
+  priv->notify_low_pages = hd_app_mgr_read_lowmem (LOWMEM_PROC_NOTIFY_LOW,
+                                                   NULL);
+  priv->notify_high_pages = hd_app_mgr_read_lowmem (LOWMEM_PROC_NOTIFY_HIGH,
+                                                    NULL);
+  priv->nr_decay_pages = hd_app_mgr_read_lowmem (LOWMEM_PROC_NR_DECAY, NULL);
   priv->prestart_mode = hd_app_mgr_setup_prestart (priv->notify_low_pages,
                                                    priv->nr_decay_pages,
                                                    &priv->prestart_required_pages);
@@ -629,6 +677,40 @@ hd_app_mgr_kill_all_prestarted ()
   g_queue_free (prestarted);
 }
 
+/* Writes the prestart history; also the timeout that batches saves. */
+static gboolean
+hd_app_mgr_save_prestart_history (gpointer unused)
+{
+  HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (the_app_mgr);
+  gchar *fname;
+
+  if (priv->prestart_save_id)
+    {
+      g_source_remove (priv->prestart_save_id);
+      priv->prestart_save_id = 0;
+    }
+
+  fname = g_build_filename (g_get_user_cache_dir (),
+                            PRESTART_HISTORY_DIR,
+                            PRESTART_HISTORY_FILE, NULL);
+  hd_prestart_policy_save (priv->prestart_policy, fname);
+  g_free (fname);
+
+  return FALSE;
+}
+
+/* Saves the launch history a bit later unless it's already scheduled. */
+static void
+hd_app_mgr_queue_prestart_save (void)
+{
+  HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (hd_app_mgr_get ());
+
+  if (!priv->prestart_save_id)
+    priv->prestart_save_id =
+      g_timeout_add_seconds (PRESTART_HISTORY_SAVE_DELAY,
+                             hd_app_mgr_save_prestart_history, NULL);
+}
+
 /* Called when exiting main() to close all prestarted apps. */
 void
 hd_app_mgr_stop ()
@@ -637,6 +719,7 @@ hd_app_mgr_stop ()
     return;
 
   hd_app_mgr_kill_all_prestarted ();
+  hd_app_mgr_save_prestart_history (NULL);
 }
 
 static void
@@ -664,6 +747,33 @@ hd_app_mgr_dispose (GObject *gobject)
       priv->running_apps = NULL;
     }
 
+  if (priv->state_check_id)
+    {
+      g_source_remove (priv->state_check_id);
+      priv->state_check_id = 0;
+    }
+
+  if (priv->prestart_save_id)
+    {
+      g_source_remove (priv->prestart_save_id);
+      priv->prestart_save_id = 0;
+    }
+
+  if (priv->prestart_policy)
+    {
+      hd_prestart_policy_free (priv->prestart_policy);
+      priv->prestart_policy = NULL;
+    }
+
+  if (priv->launcher_positions)
+    {
+      g_hash_table_destroy (priv->launchers_by_class);
+      g_hash_table_destroy (priv->launchers_by_exec);
+      g_hash_table_destroy (priv->launchers_by_id);
+      g_hash_table_destroy (priv->launcher_positions);
+      priv->launcher_positions = NULL;
+    }
+
   for (int i = 0; i < NUM_QUEUES; i++)
     {
       if (priv->queues[i])
@@ -863,23 +973,11 @@ hd_app_mgr_timeout_backoff_factor ()
 static gdouble
 hd_app_mgr_system_load_average (void)
 {
-  int fd = open ("/proc/loadavg", O_RDONLY);
-
-  if (fd >= 0)
-    {
-      char buffer[32];
-      int size = read (fd, buffer, sizeof(buffer) -1);
+  static gint fd = -1;
+  gchar buffer[32];
 
-      close (fd);
-      if (size > 0)
-        {
-          gdouble load;
-          buffer[size] = 0;
-          load = g_ascii_strtod(buffer, NULL);
-
-          return load;
-        }
-    }
+  if (hd_app_mgr_read_proc ("/proc/loadavg", &fd, buffer, sizeof (buffer)) > 0)
+    return g_ascii_strtod (buffer, NULL);
 
   return -1.0;
 }
@@ -901,6 +999,8 @@ hd_app_mgr_activate (HdRunningApp *app)
   {
     case HD_APP_STATE_INACTIVE:
     case HD_APP_STATE_PRESTARTED:
+      hd_launch_trace_begin (app, state == HD_APP_STATE_PRESTARTED
+                                  ? HD_LAUNCH_PRESTARTED : HD_LAUNCH_COLD);
       result = hd_app_mgr_start (app);
       timer = TRUE;
       break;
@@ -909,6 +1009,7 @@ hd_app_mgr_activate (HdRunningApp *app)
         ? hd_app_mgr_relaunch (app) : LAUNCH_OK;
       break;
     case HD_APP_STATE_HIBERNATED:
+      hd_launch_trace_begin (app, HD_LAUNCH_WOKEN);
       result = hd_app_mgr_wakeup (app);
       timer = TRUE;
       break;
@@ -923,6 +1024,9 @@ hd_app_mgr_activate (HdRunningApp *app)
       result = LAUNCH_FAILED;
   }
 
+  if (timer && result != LAUNCH_OK)
+    hd_launch_trace_cancel (app);
+
   switch (result)
   {
     case LAUNCH_OK:
@@ -940,6 +1044,13 @@ hd_app_mgr_activate (HdRunningApp *app)
 
             time (&now);
             hd_running_app_set_last_launch (app, now);
+            hd_prestart_policy_launched (
+                 HD_APP_MGR_GET_PRIVATE (hd_app_mgr_get ())->prestart_policy,
+                 hd_running_app_get_id (app), g_get_real_time (),
+                 state == HD_APP_STATE_INACTIVE ? HD_PRESTART_LAUNCH_COLD
+                 : state == HD_APP_STATE_PRESTARTED ? HD_PRESTART_LAUNCH_WARM
+                 : HD_PRESTART_LAUNCH_OTHER);
+            hd_app_mgr_queue_prestart_save ();
             g_timeout_add_seconds (timeout,
                                    (GSourceFunc)hd_app_mgr_loading_timeout,
                                    g_object_ref (app));
@@ -1122,9 +1233,34 @@ hd_app_mgr_kill_all (void)
 
 void hd_app_mgr_app_opened (HdRunningApp *app)
 {
+  HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (hd_app_mgr_get ());
   HdLauncherApp *launcher = hd_running_app_get_launcher_app (app);
+  const gchar *id = hd_running_app_get_id (app);
+  GPid pid = hd_running_app_get_pid (app);
+
   hd_running_app_set_state (app, HD_APP_STATE_SHOWN);
 
+  /* Learn how big it is and how long it took for prestarting. */
+  if (id)
+    {
+      gint64 now = g_get_real_time ();
+
+      if (pid > 0)
+        {
+          gchar *statm, buffer[64];
+          size_t resident;
+
+          statm = g_strdup_printf ("/proc/%d/statm", pid);
+          if (hd_app_mgr_read_proc (statm, NULL, buffer, sizeof (buffer)) > 0
+              && sscanf (buffer, "%*u %zu", &resident) == 1)
+            hd_prestart_policy_set_size (priv->prestart_policy, id,
+                                resident * (sysconf (_SC_PAGESIZE) / 1024));
+          g_free (statm);
+        }
+      hd_prestart_policy_shown (priv->prestart_policy, id, now);
+      hd_app_mgr_queue_prestart_save ();
+    }
+
   /* Signal that the app has appeared.
    */
   if (launcher)
@@ -1162,6 +1298,13 @@ hd_app_mgr_app_closed (HdRunningApp *app)
       return;
     }
 
+  /* Prestarted apps going away weren't the user's. */
+  if ((state == HD_APP_STATE_SHOWN || state == HD_APP_STATE_LOADING)
+      && hd_running_app_get_id (app))
+    hd_prestart_policy_closed (priv->prestart_policy,
+                               hd_running_app_get_id (app),
+                               g_get_real_time ());
+
   /* Remove from anywhere we keep executing apps. */
   hd_app_mgr_remove_from_queue (QUEUE_PRESTARTED, app);
   hd_app_mgr_remove_from_queue (QUEUE_HIBERNATED, app);
@@ -1197,6 +1340,130 @@ hd_app_mgr_app_stop_hibernation (HdRunningApp *app)
   hd_app_mgr_app_closed (app);
 }
 
+/* Adds @launcher to @index under @key unless an earlier one is there.
+ * Takes @key. */
+static void
+hd_app_mgr_index_launcher (GHashTable *index, gchar *key,
+                           HdLauncherApp *launcher)
+{
+  if (!g_hash_table_lookup (index, key))
+    g_hash_table_insert (index, key, launcher);
+  else
+    g_free (key);
+}
+
+/* (Re)builds the launcher indexes of @priv from the items of @tree. */
+static void
+hd_app_mgr_index_launchers (HdAppMgrPrivate *priv, HdLauncherTree *tree)
+{
+  GList *items;
+  guint position;
+
+  if (priv->launcher_positions)
+    {
+      g_hash_table_remove_all (priv->launchers_by_class);
+      g_hash_table_remove_all (priv->launchers_by_exec);
+      g_hash_table_remove_all (priv->launchers_by_id);
+      g_hash_table_remove_all (priv->launcher_positions);
+    }
+  else
+    {
+      priv->launchers_by_class = g_hash_table_new_full (g_str_hash,
+                                                        g_str_equal,
+                                                        g_free, NULL);
+      priv->launchers_by_exec = g_hash_table_new_full (g_str_hash,
+                                                       g_str_equal,
+                                                       g_free, NULL);
+      priv->launchers_by_id = g_hash_table_new_full (g_str_hash,
+                                                     g_str_equal,
+                                                     g_free, NULL);
+      priv->launcher_positions = g_hash_table_new (NULL, NULL);
+    }
+
+  position = 0;
+  for (items = hd_launcher_tree_get_items (tree); items; items = items->next)
+    {
+      HdLauncherApp *launcher;
+      const gchar *str;
+      gchar *id;
+      gsize len;
+
+      if (hd_launcher_item_get_item_type (HD_LAUNCHER_ITEM (items->data)) !=
+          HD_APPLICATION_LAUNCHER)
+        continue;
+
+      launcher = HD_LAUNCHER_APP (items->data);
+      g_hash_table_insert (priv->launcher_positions, launcher,
+                           GUINT_TO_POINTER (++position));
+
+      if ((str = hd_launcher_app_get_wm_class (launcher)) != NULL)
+        hd_app_mgr_index_launcher (priv->launchers_by_class,
+                                   g_strdup (str), launcher);
+      if ((str = hd_launcher_app_get_exec (launcher)) != NULL)
+        hd_app_mgr_index_launcher (priv->launchers_by_exec,
+                                   g_strdup (str), launcher);
+
+      /* The class of the window only needs to be a prefix of the id. */
+      if (!(str = hd_launcher_item_get_id (HD_LAUNCHER_ITEM (launcher))))
+        continue;
+      id = g_ascii_strdown (str, -1);
+      for (len = strlen (id); ; len--)
+        {
+          hd_app_mgr_index_launcher (priv->launchers_by_id,
+                                     g_strndup (id, len), launcher);
+          if (!len)
+            break;
+        }
+      g_free (id);
+    }
+}
+
+/* Returns the first launcher in the tree that
+ * hd_launcher_app_match_window() would match, or %NULL. */
+static HdLauncherApp *
+hd_app_mgr_find_launcher_for_window (HdAppMgrPrivate *priv,
+                                     const char *res_name,
+                                     const char *res_class)
+{
+  HdLauncherApp *candidates[3], *best;
+  guint i, pos, best_pos;
+
+  if (!priv->launcher_positions)
+    return NULL;
+
+  candidates[0] = candidates[1] = candidates[2] = NULL;
+  if (res_class)
+    {
+      gchar *key;
+
+      candidates[0] = g_hash_table_lookup (priv->launchers_by_class,
+                                           res_class);
+      key = g_ascii_strdown (res_class, -1);
+      candidates[1] = g_hash_table_lookup (priv->launchers_by_id, key);
+      g_free (key);
+    }
+  if (res_name)
+    candidates[2] = g_hash_table_lookup (priv->launchers_by_exec, res_name);
+
+  best = NULL;
+  best_pos = G_MAXUINT;
+  for (i = 0; i < G_N_ELEMENTS (candidates); i++)
+    {
+      if (!candidates[i])
+        continue;
+      hd_stats_count (HD_STATS_LAUNCHER_MATCHES);
+      pos = GPOINTER_TO_UINT (g_hash_table_lookup (priv->launcher_positions,
+                                                   candidates[i]));
+      if (pos < best_pos)
+        {
+          best = candidates[i];
+          best_pos = pos;
+        }
+    }
+
+  return best;
+}
+
 static void
 hd_app_mgr_populate_tree_finished (HdLauncherTree *tree, gpointer data)
 {
@@ -1207,6 +1474,8 @@ hd_app_mgr_populate_tree_finished (HdLauncherTree *tree, gpointer data)
   GList *apps_to_free = apps;
   GList *items_to_free = items;
 
+  hd_app_mgr_index_launchers (priv, tree);
+
   /* First, traverse the already running apps to see if their HdLauncherApp
    * info has changed.
    */
@@ -1512,24 +1781,45 @@ hd_app_mgr_service_top (const gchar *service, const gchar *param)
 }
 
 /* Memory management. */
-static size_t
-hd_app_mgr_read_lowmem (const gchar *filename)
+
+/* Reads @filename into @buffer, NUL-terminated, and returns the length
+ * read or -1.  If @fd is not %NULL, the file is kept open in it between
+ * calls, because procfs files give up-to-date contents when they're read
+ * again from the start. */
+static gssize
+hd_app_mgr_read_proc (const gchar *filename, gint *fd,
+                      gchar *buffer, gsize size)
 {
-  int fd = open (filename, O_RDONLY);
+  gint tmp = -1;
+  gssize len;
 
-  if (fd >= 0)
-    {
-      char buffer[32];
-      size_t size = read (fd, buffer, sizeof(buffer) -1);
+  if (!fd)
+    fd = &tmp;
 
-      close (fd);
-      if (size > 0)
-        {
-          buffer[size] = 0;
-          return (size_t)strtol(buffer, NULL, 10);
-        }
+  if (*fd < 0 && (*fd = open (filename, O_RDONLY)) < 0)
+    return -1;
+
+  len = pread (*fd, buffer, size - 1, 0);
+  if (len < 0 || fd == &tmp)
+    {
+      close (*fd);
+      *fd = -1;
     }
 
+  if (len < 0)
+    return -1;
+  buffer[len] = 0;
+  return len;
+}
+
+static size_t
+hd_app_mgr_read_lowmem (const gchar *filename, gint *fd)
+{
+  gchar buffer[32];
+
+  if (hd_app_mgr_read_proc (filename, fd, buffer, sizeof (buffer)) > 0)
+    return (size_t)strtol (buffer, NULL, 10);
+
   return NSIZE;
 }
 
@@ -1574,7 +1864,8 @@ hd_app_mgr_setup_prestart (size_t low_pages,
       size_t reserved = (size_t)strtol (prestart_env, NULL, 10);
       if (reserved == 0)
         *prestart_required_pages =
-                low_pages + hd_app_mgr_read_lowmem (LOWMEM_PROC_NR_DECAY);
+                low_pages + hd_app_mgr_read_lowmem (LOWMEM_PROC_NR_DECAY,
+                                                    NULL);
       else
         *prestart_required_pages = low_pages + reserved;
       result = PRESTART_AUTO;
@@ -1623,7 +1914,8 @@ static gboolean hd_app_mgr_can_prestart (HdLauncherApp *launcher)
   if (!hd_app_mgr_check_loadavg ())
     return FALSE;
 
-  size_t free_pages = hd_app_mgr_read_lowmem (LOWMEM_PROC_FREE);
+  static gint free_fd = -1;
+  size_t free_pages = hd_app_mgr_read_lowmem (LOWMEM_PROC_FREE, &free_fd);
   if (free_pages == NSIZE)
     return TRUE;
 
@@ -1651,15 +1943,50 @@ hd_app_mgr_state_check (void)
 {
   HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (hd_app_mgr_get ());
 
+  /* Something has changed, so don't wait for the prestart backoff. */
+  priv->prestart_backoff = STATE_CHECK_INTERVAL;
+
   /* If it's already looping, it'll get there, so do nothing. */
-  if (priv->state_check_looping)
-    return;
+  if (priv->state_check_id)
+    {
+      if (!priv->state_check_waiting)
+        return;
+      g_source_remove (priv->state_check_id);
+    }
 
   /* If not, start looping. */
-  priv->state_check_looping = TRUE;
-  g_timeout_add_seconds (STATE_CHECK_INTERVAL,
-                         hd_app_mgr_state_check_loop,
-                         NULL);
+  priv->state_check_waiting = FALSE;
+  priv->state_check_id = g_timeout_add_seconds (STATE_CHECK_INTERVAL,
+                                                hd_app_mgr_state_check_loop,
+                                                NULL);
+}
+
+/* Returns the prestartable app that's expected to save the most launch
+ * latency per memory it takes.  Apps we don't know anything about yet
+ * are taken in the order of QUEUE_PRESTARTABLE, which is by priority. */
+static HdRunningApp *
+hd_app_mgr_next_prestartable (HdAppMgrPrivate *priv)
+{
+  HdRunningApp *best = NULL;
+  gdouble best_score = -1;
+  gint64 now = g_get_real_time ();
+  GList *l;
+
+  for (l = priv->queues[QUEUE_PRESTARTABLE]->head; l; l = l->next)
+    {
+      const gchar *id = hd_running_app_get_id (l->data);
+      gdouble score;
+
+      score = id ? hd_prestart_policy_score (priv->prestart_policy, id, now)
+                 : 0;
+      if (score > best_score)
+        {
+          best = l->data;
+          best_score = score;
+        }
+    }
+
+  return best;
 }
 
 /*
@@ -1671,11 +1998,13 @@ hd_app_mgr_state_check (void)
  * It continues to loop if
  * - There are still apps to be prestarted.
  * - If memory is not low enough.
+ * If prestarting has to wait for memory or the load average, it checks
+ * again less and less often until hd_app_mgr_state_check() is called.
  */
 static gboolean
 hd_app_mgr_state_check_loop (gpointer data)
 {
-  gboolean loop = FALSE;
+  gboolean loop = FALSE, wait = FALSE;
   HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (hd_app_mgr_get ());
 
   /* First check if we are really low on memory. */
@@ -1727,20 +2056,39 @@ hd_app_mgr_state_check_loop (gpointer data)
       /* We make this tests here to loop even if we can't prestart right now.*/
       if (!priv->prestarting)
         {
-          HdRunningApp *app = g_queue_peek_head (priv->queues[QUEUE_PRESTARTABLE]);
+          HdRunningApp *app = hd_app_mgr_next_prestartable (priv);
           HdLauncherApp *launcher = hd_running_app_get_launcher_app (app);
           if (launcher && hd_app_mgr_can_prestart (launcher))
-            hd_app_mgr_prestart (app);
+            {
+              hd_app_mgr_prestart (app);
+              priv->prestart_backoff = STATE_CHECK_INTERVAL;
+            }
+          else
+            wait = TRUE;
         }
       if (!g_queue_is_empty (priv->queues[QUEUE_PRESTARTABLE]))
         loop = TRUE;
     }
 
+  if (loop && wait)
+    {
+      /* Try again later with a fresh timeout. */
+      priv->prestart_backoff = MIN (priv->prestart_backoff * 2,
+                                    PRESTART_BACKOFF_MAX);
+      priv->state_check_waiting = TRUE;
+      priv->state_check_id =
+        g_timeout_add_seconds (priv->prestart_backoff,
+                               hd_app_mgr_state_check_loop, NULL);
+      return FALSE;
+    }
+
   /* Now the tricky part. This function is called by a timeout or by
    * changes in memory conditions. If we're already looping, return if we
    * need to loop. If not, and we need to loop, start the loop.
    */
-  priv->state_check_looping = loop;
+  priv->state_check_waiting = FALSE;
+  if (!loop)
+    priv->state_check_id = 0;
 
   return loop;
 }
@@ -1883,6 +2231,18 @@ hd_app_mgr_dbus_launch_app (HdAppMgr *self, const gchar *id)
   return app ? hd_app_mgr_launch (app) : FALSE;
 }
 
+/* D-Bus method returning the launch latency statistics,
+ * optionally starting a new measurement period. */
+gboolean
+hd_app_mgr_dbus_get_launch_stats (HdAppMgr *self, gboolean reset,
+                                  gchar **stats, GError **error)
+{
+  *stats = hd_launch_trace_to_string ();
+  if (reset)
+    hd_launch_trace_reset ();
+  return TRUE;
+}
+
 gboolean
 hd_app_mgr_dbus_prestart (HdAppMgr *self, const gboolean enable)
 {
@@ -2412,7 +2772,10 @@ hd_app_mgr_match_window (const char *res_name,
   HdLauncherApp *launcher = NULL;
   GList *link = NULL;
 
-  /* First we need to look if there's already a running app for this. */
+  hd_stats_count (HD_STATS_WINDOW_MATCHES);
+
+  /* First we need to look if there's already a running app for this.
+   * There are only a few of them, no need to index them. */
   link = priv->running_apps;
   while (link)
     {
@@ -2427,6 +2790,7 @@ hd_app_mgr_match_window (const char *res_name,
       /* Now we look if the app's launcher matches the window. */
       if (launcher)
         {
+          hd_stats_count (HD_STATS_LAUNCHER_MATCHES);
           if (hd_launcher_app_match_window (launcher, res_name, res_class))
             {
               /* Now we have a good pid. */
@@ -2443,31 +2807,15 @@ hd_app_mgr_match_window (const char *res_name,
   /* Well, there wasn't any already running app, so we'll have to look for
    * a launcher that matches.
    */
-  GList *launchers = hd_launcher_tree_get_items (priv->tree);
   app = NULL;
-
-  if (res_name || res_class)
+  launcher = hd_app_mgr_find_launcher_for_window (priv, res_name, res_class);
+  if (launcher)
     {
-      while (launchers)
-        {
-          /* Filter non-applications. */
-          if (hd_launcher_item_get_item_type (HD_LAUNCHER_ITEM (launchers->data)) !=
-              HD_APPLICATION_LAUNCHER)
-            goto next;
-
-          launcher = HD_LAUNCHER_APP (launchers->data);
-          if (hd_launcher_app_match_window (launcher, res_name, res_class))
-            {
-              /* Let's make a new running app for it. */
-              app = hd_running_app_new (launcher);
-              hd_running_app_set_pid (app, pid);
-              priv->running_apps = g_list_prepend (priv->running_apps, app);
-              return app;
-            }
-
-          next:
-          launchers = g_list_next (launchers);
-        }
+      /* Let's make a new running app for it. */
+      app = hd_running_app_new (launcher);
+      hd_running_app_set_pid (app, pid);
+      priv->running_apps = g_list_prepend (priv->running_apps, app);
+      return app;
     }
 
   /*
@@ -73,6 +73,8 @@ gboolean hd_app_mgr_relaunch_set_top (HdLauncherApp *app);
 /* D-Bus API */
 gboolean hd_app_mgr_dbus_launch_app (HdAppMgr *self, const gchar *id);
 gboolean hd_app_mgr_dbus_prestart (HdAppMgr *self, const gboolean enable);
+gboolean hd_app_mgr_dbus_get_launch_stats (HdAppMgr *self, gboolean reset,
+                                           gchar **stats, GError **error);
 
 /* Controlling running apps. */
 gboolean hd_app_mgr_activate     (HdRunningApp *app);
@@ -0,0 +1,301 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2009 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "hd-launch-trace.h"
+#include "hd-stats.h"
+
+#include <string.h>
+
+/* A tap is only taken as the start of a launch this long after it. */
+#define TAP_MAX_AGE     (2 * G_USEC_PER_SEC)
+/* Launches not finished in this long are given up on. */
+#define LAUNCH_MAX_AGE  (60 * G_USEC_PER_SEC)
+
+static const gchar *Stage_names[HD_LAUNCH_N_STAGES] =
+  { "tap", "activate", "transition", "map", "damage" };
+static const gchar *Kind_names[HD_LAUNCH_N_KINDS] =
+  { "cold", "prestarted", "woken" };
+
+/* The launch of an HdRunningApp, stored as its "launch-trace". */
+typedef struct
+{
+  gchar         *id;
+  HdLauncherApp *launcher;
+  HdLaunchKind   kind;
+
+  /* When the launch reached each stage, or 0. */
+  gint64         stages[HD_LAUNCH_N_STAGES];
+
+  /* The window whose damage we're waiting for. */
+  ClutterActor  *actor;
+} LaunchTrace;
+
+static struct
+{
+  /* When the last tap not yet part of a launch happened, or 0. */
+  gint64      tap;
+
+  /* LaunchTrace:s being timed, the latest first. */
+  GList      *active;
+  /* Actors of the windows just mapped -> LaunchTrace. */
+  GHashTable *awaiting;
+
+  /* Time from the tap to each stage by the kind of launch. */
+  HdStatsHistogram stages[HD_LAUNCH_N_KINDS][HD_LAUNCH_N_STAGES];
+  /* Application id -> HdStatsHistogram[HD_LAUNCH_N_KINDS] of the time
+   * from the tap to the first damage. */
+  GHashTable *apps;
+} Launches;
+
+static void
+actor_gone (gpointer data, GObject *actor)
+{
+  LaunchTrace *trace = data;
+
+  g_hash_table_remove (Launches.awaiting, actor);
+  trace->actor = NULL;
+}
+
+static void
+trace_stop (LaunchTrace *trace)
+{
+  if (trace->actor)
+    {
+      g_object_weak_unref (G_OBJECT (trace->actor), actor_gone, trace);
+      g_hash_table_remove (Launches.awaiting, trace->actor);
+      trace->actor = NULL;
+    }
+  Launches.active = g_list_remove (Launches.active, trace);
+  trace->stages[HD_LAUNCH_STAGE_TAP] = 0;
+}
+
+static void
+trace_free (LaunchTrace *trace)
+{
+  trace_stop (trace);
+  g_free (trace->id);
+  g_slice_free (LaunchTrace, trace);
+}
+
+/* Adds the times of the complete @trace to the histograms. */
+static void
+trace_finish (LaunchTrace *trace)
+{
+  HdStatsHistogram *hists;
+  gint64 tap;
+  guint i;
+
+  tap = trace->stages[HD_LAUNCH_STAGE_TAP];
+  for (i = HD_LAUNCH_STAGE_TAP + 1; i < HD_LAUNCH_N_STAGES; i++)
+    if (trace->stages[i])
+      hd_stats_histogram_add (&Launches.stages[trace->kind][i],
+                              trace->stages[i] - tap);
+
+  if (!Launches.apps)
+    Launches.apps = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                           g_free, g_free);
+  if (!(hists = g_hash_table_lookup (Launches.apps, trace->id)))
+    {
+      hists = g_new0 (HdStatsHistogram, HD_LAUNCH_N_KINDS);
+      g_hash_table_insert (Launches.apps, g_strdup (trace->id), hists);
+    }
+  hd_stats_histogram_add (&hists[trace->kind],
+                          trace->stages[HD_LAUNCH_STAGE_DAMAGE] - tap);
+
+  trace_stop (trace);
+}
+
+/* Called when a launcher tile is clicked. */
+void
+hd_launch_trace_tap (void)
+{
+  Launches.tap = hd_stats_now ();
+}
+
+/* Starts timing the launch of @app, from the last tap if there was one
+ * recently, otherwise from now. */
+void
+hd_launch_trace_begin (HdRunningApp *app, HdLaunchKind kind)
+{
+  LaunchTrace *trace;
+  gint64 now;
+  GList *l;
+
+  now = hd_stats_now ();
+
+  /* Forget about launches which never finished. */
+  for (l = Launches.active; l; )
+    {
+      trace = l->data;
+      l = l->next;
+      if (now - trace->stages[HD_LAUNCH_STAGE_TAP] > LAUNCH_MAX_AGE)
+        trace_stop (trace);
+    }
+
+  if (!(trace = g_object_get_data (G_OBJECT (app), "launch-trace")))
+    {
+      trace = g_slice_new0 (LaunchTrace);
+      g_object_set_data_full (G_OBJECT (app), "launch-trace", trace,
+                              (GDestroyNotify)trace_free);
+    }
+  else
+    trace_stop (trace);
+
+  g_free (trace->id);
+  trace->id = g_strdup (hd_running_app_get_id (app));
+  trace->launcher = hd_running_app_get_launcher_app (app);
+  trace->kind = kind;
+  memset (trace->stages, 0, sizeof (trace->stages));
+  trace->stages[HD_LAUNCH_STAGE_TAP] =
+    Launches.tap && now - Launches.tap < TAP_MAX_AGE ? Launches.tap : now;
+  trace->stages[HD_LAUNCH_STAGE_ACTIVATE] = now;
+  Launches.tap = 0;
+
+  Launches.active = g_list_prepend (Launches.active, trace);
+}
+
+/* Called if the launch of @app failed after all. */
+void
+hd_launch_trace_cancel (HdRunningApp *app)
+{
+  LaunchTrace *trace;
+
+  if ((trace = g_object_get_data (G_OBJECT (app), "launch-trace")) != NULL)
+    trace_stop (trace);
+}
+
+/* Called when the loading screen of @launcher is shown, or of the last
+ * launched application if it's %NULL. */
+void
+hd_launch_trace_transition (HdLauncherApp *launcher)
+{
+  GList *l;
+
+  for (l = Launches.active; l; l = l->next)
+    {
+      LaunchTrace *trace = l->data;
+
+      if (launcher && trace->launcher != launcher)
+        continue;
+      if (!trace->stages[HD_LAUNCH_STAGE_TRANSITION])
+        trace->stages[HD_LAUNCH_STAGE_TRANSITION] = hd_stats_now ();
+      break;
+    }
+}
+
+/* Called when a window of @app is mapped as @actor, so its first damage
+ * can be waited for. */
+void
+hd_launch_trace_mapped (HdRunningApp *app, ClutterActor *actor)
+{
+  LaunchTrace *trace;
+
+  trace = g_object_get_data (G_OBJECT (app), "launch-trace");
+  if (!trace || !trace->stages[HD_LAUNCH_STAGE_TAP]
+      || trace->stages[HD_LAUNCH_STAGE_MAP])
+    return;
+
+  trace->stages[HD_LAUNCH_STAGE_MAP] = hd_stats_now ();
+  if (!actor)
+    return;
+
+  if (!Launches.awaiting)
+    Launches.awaiting = g_hash_table_new (NULL, NULL);
+  trace->actor = actor;
+  g_object_weak_ref (G_OBJECT (actor), actor_gone, trace);
+  g_hash_table_insert (Launches.awaiting, actor, trace);
+}
+
+/* Called when @actor, a window or a texture of one, is damaged. */
+void
+hd_launch_trace_damage (ClutterActor *actor)
+{
+  LaunchTrace *trace;
+
+  if (!Launches.awaiting || !g_hash_table_size (Launches.awaiting))
+    return;
+
+  if (!(trace = g_hash_table_lookup (Launches.awaiting, actor)))
+    {
+      actor = clutter_actor_get_parent (actor);
+      if (!actor || !(trace = g_hash_table_lookup (Launches.awaiting, actor)))
+        return;
+    }
+
+  trace->stages[HD_LAUNCH_STAGE_DAMAGE] = hd_stats_now ();
+  trace_finish (trace);
+}
+
+void
+hd_launch_trace_reset (void)
+{
+  memset (Launches.stages, 0, sizeof (Launches.stages));
+  if (Launches.apps)
+    g_hash_table_remove_all (Launches.apps);
+}
+
+/* Returns the launch times since the last reset as human-readable text,
+ * one line per stage and kind of launch, then per application. */
+gchar *
+hd_launch_trace_to_string (void)
+{
+  GHashTableIter iter;
+  HdStatsHistogram *hists;
+  const gchar *id;
+  GString *str;
+  guint kind, stage;
+
+  str = g_string_new (NULL);
+  for (kind = 0; kind < HD_LAUNCH_N_KINDS; kind++)
+    for (stage = HD_LAUNCH_STAGE_TAP + 1; stage < HD_LAUNCH_N_STAGES; stage++)
+      {
+        gchar *name;
+
+        if (!Launches.stages[kind][stage].n)
+          continue;
+        name = g_strdup_printf ("%s %s", Kind_names[kind], Stage_names[stage]);
+        hd_stats_histogram_print (str, name, &Launches.stages[kind][stage]);
+        g_free (name);
+      }
+
+  if (Launches.apps)
+    {
+      g_hash_table_iter_init (&iter, Launches.apps);
+      while (g_hash_table_iter_next (&iter, (gpointer *)&id,
+                                     (gpointer *)&hists))
+        for (kind = 0; kind < HD_LAUNCH_N_KINDS; kind++)
+          {
+            gchar *name;
+
+            if (!hists[kind].n)
+              continue;
+            name = g_strdup_printf ("%s %s", id, Kind_names[kind]);
+            hd_stats_histogram_print (str, name, &hists[kind]);
+            g_free (name);
+          }
+    }
+
+  return g_string_free (str, FALSE);
+}
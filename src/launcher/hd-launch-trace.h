@@ -0,0 +1,70 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2009 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * Timing of application launches from the tap on the launcher tile until
+ * the first damage of the application's window.  Every stage of a launch
+ * is timestamped per HdRunningApp, and when the launch is complete the
+ * time from the tap to each stage is added to histograms by the kind of
+ * the launch, and the total to a histogram of the application.  The
+ * results can be fetched as text over D-Bus.
+ */
+
+#ifndef __HD_LAUNCH_TRACE_H__
+#define __HD_LAUNCH_TRACE_H__
+
+#include <clutter/clutter.h>
+
+#include "hd-running-app.h"
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  HD_LAUNCH_STAGE_TAP,        /* the launcher tile was clicked */
+  HD_LAUNCH_STAGE_ACTIVATE,   /* hd_app_mgr_activate() */
+  HD_LAUNCH_STAGE_TRANSITION, /* the loading screen started */
+  HD_LAUNCH_STAGE_MAP,        /* the first window was mapped */
+  HD_LAUNCH_STAGE_DAMAGE,     /* the first damage of that window */
+  HD_LAUNCH_N_STAGES
+} HdLaunchStage;
+
+typedef enum
+{
+  HD_LAUNCH_COLD,             /* started from scratch */
+  HD_LAUNCH_PRESTARTED,       /* was running in the background */
+  HD_LAUNCH_WOKEN,            /* woken up from hibernation */
+  HD_LAUNCH_N_KINDS
+} HdLaunchKind;
+
+void   hd_launch_trace_tap        (void);
+void   hd_launch_trace_begin      (HdRunningApp *app, HdLaunchKind kind);
+void   hd_launch_trace_cancel     (HdRunningApp *app);
+void   hd_launch_trace_transition (HdLauncherApp *launcher);
+void   hd_launch_trace_mapped     (HdRunningApp *app, ClutterActor *actor);
+void   hd_launch_trace_damage     (ClutterActor *actor);
+
+void   hd_launch_trace_reset      (void);
+gchar *hd_launch_trace_to_string  (void);
+
+G_END_DECLS
+
+#endif /* __HD_LAUNCH_TRACE_H__ */
@@ -205,6 +205,44 @@ hd_launcher_app_parse_keyfile (HdLauncherItem *item,
   return TRUE;
 }
 
+/* Called by hd_launcher_item_new_from_fields(). */
+void
+hd_launcher_app_set_fields (HdLauncherApp *app,
+                            const HdLauncherItemFields *fields)
+{
+  HdLauncherAppPrivate *priv = HD_LAUNCHER_APP_GET_PRIVATE (app);
+
+  priv->exec = g_strdup (fields->strings[HD_LAUNCHER_ITEM_FIELD_EXEC]);
+  priv->service = g_strdup (fields->strings[HD_LAUNCHER_ITEM_FIELD_SERVICE]);
+  priv->loading_image =
+    g_strdup (fields->strings[HD_LAUNCHER_ITEM_FIELD_LOADING_IMAGE]);
+  priv->switcher_icon =
+    g_strdup (fields->strings[HD_LAUNCHER_ITEM_FIELD_SWITCHER_ICON]);
+  priv->wm_class = g_strdup (fields->strings[HD_LAUNCHER_ITEM_FIELD_WM_CLASS]);
+  priv->prestart_mode = fields->prestart_mode;
+  priv->priority = fields->priority;
+  priv->ignore_lowmem = fields->ignore_lowmem;
+  priv->ignore_load = fields->ignore_load;
+}
+
+/* Called by hd_launcher_item_get_fields(). */
+void
+hd_launcher_app_get_fields (HdLauncherApp *app,
+                            HdLauncherItemFields *fields)
+{
+  HdLauncherAppPrivate *priv = HD_LAUNCHER_APP_GET_PRIVATE (app);
+
+  fields->strings[HD_LAUNCHER_ITEM_FIELD_EXEC] = priv->exec;
+  fields->strings[HD_LAUNCHER_ITEM_FIELD_SERVICE] = priv->service;
+  fields->strings[HD_LAUNCHER_ITEM_FIELD_LOADING_IMAGE] = priv->loading_image;
+  fields->strings[HD_LAUNCHER_ITEM_FIELD_SWITCHER_ICON] = priv->switcher_icon;
+  fields->strings[HD_LAUNCHER_ITEM_FIELD_WM_CLASS] = priv->wm_class;
+  fields->prestart_mode = priv->prestart_mode;
+  fields->priority = priv->priority;
+  fields->ignore_lowmem = priv->ignore_lowmem;
+  fields->ignore_load = priv->ignore_load;
+}
+
 const gchar *
 hd_launcher_app_get_exec (HdLauncherApp *item)
 {
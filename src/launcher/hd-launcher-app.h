@@ -80,6 +80,11 @@ gint hd_launcher_app_get_priority (HdLauncherApp *app);
 gboolean hd_launcher_app_get_ignore_lowmem (HdLauncherApp *app);
 gboolean hd_launcher_app_get_ignore_load   (HdLauncherApp *app);
 
+void hd_launcher_app_set_fields (HdLauncherApp *app,
+                                 const HdLauncherItemFields *fields);
+void hd_launcher_app_get_fields (HdLauncherApp *app,
+                                 HdLauncherItemFields *fields);
+
 gboolean hd_launcher_app_match_window (HdLauncherApp *app,
                                        const gchar *res_name,
                                        const gchar *res_class);
@@ -0,0 +1,411 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2009 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "hd-launcher-cache.h"
+
+#include <string.h>
+
+#define HD_LAUNCHER_CACHE_DIR     "hildon-desktop"
+#define HD_LAUNCHER_CACHE_FILE    "launcher-tree.cache"
+
+/* "HDLC" */
+#define HD_LAUNCHER_CACHE_MAGIC   0x434c4448
+/* Increase it whenever the layout or HdLauncherItemFields change. */
+#define HD_LAUNCHER_CACHE_VERSION 1
+
+/*
+ * The cache file is a CacheHeader followed by .n_entries CacheEntry:s
+ * and .strings_size bytes of NUL-terminated strings.  Strings are
+ * referred to by their offset in the string table; 0 stands for %NULL.
+ * Everything is in host byte order, the cache is never moved to another
+ * device.
+ */
+typedef struct
+{
+  guint32 magic;
+  guint32 version;
+  guint32 sizeof_entry;
+  guint32 n_entries;
+  guint32 strings_size;
+  guint32 padding;
+} CacheHeader;
+
+typedef struct
+{
+  gint64  mtime;
+  gint64  size;
+  guint32 path;
+
+  /* HdLauncherItemType or -1 if the desktop file doesn't make an item
+   * (it's NoDisplay or invalid). */
+  gint32  type;
+  gint32  prestart_mode;
+  gint32  priority;
+  guint32 flags;
+  guint32 strings[HD_LAUNCHER_ITEM_N_FIELDS];
+} CacheEntry;
+
+/* CacheEntry::flags */
+enum
+{
+  CACHE_FORCE_LANDSCAPE = 1 << 0,
+  CACHE_IGNORE_LOWMEM   = 1 << 1,
+  CACHE_IGNORE_LOAD     = 1 << 2,
+};
+
+/* A desktop file seen during the current walk. */
+typedef struct
+{
+  gchar *path;
+  gint64 mtime, size;
+  HdLauncherItem *item;
+} CacheRecord;
+
+struct _HdLauncherCache
+{
+  gchar *fname;
+
+  /* The cache file and its string table.  @index maps paths
+   * to the CacheEntry:s in @map. */
+  GMappedFile *map;
+  const gchar *strings;
+  guint32 strings_size;
+  GHashTable *index;
+
+  /* What will be written to the new cache file.  @seen is the set
+   * of paths in @records.  @dirty is set if something wasn't found
+   * in @index. */
+  GArray *records;
+  GHashTable *seen;
+  gboolean dirty;
+};
+
+/* Maps the cache file and indexes its entries, checking all of them,
+ * so lookups can trust them. */
+static gboolean
+hd_launcher_cache_map (HdLauncherCache *cache)
+{
+  const CacheHeader *header;
+  const CacheEntry *entries;
+  gsize len;
+  guint i, j;
+
+  if (!(cache->map = g_mapped_file_new (cache->fname, FALSE, NULL)))
+    /* There's no cache yet. */
+    return TRUE;
+
+  len = g_mapped_file_get_length (cache->map);
+  header = (const CacheHeader *)g_mapped_file_get_contents (cache->map);
+  if (len < sizeof (*header)
+      || header->magic != HD_LAUNCHER_CACHE_MAGIC
+      || header->version != HD_LAUNCHER_CACHE_VERSION
+      || header->sizeof_entry != sizeof (CacheEntry))
+    /* Not ours or outdated, just replace it. */
+    return TRUE;
+
+  if (header->n_entries > (len - sizeof (*header)) / sizeof (CacheEntry)
+      || header->strings_size == 0
+      || len != sizeof (*header)
+                + header->n_entries * sizeof (CacheEntry)
+                + header->strings_size)
+    return FALSE;
+
+  entries = (const CacheEntry *)&header[1];
+  cache->strings = (const gchar *)&entries[header->n_entries];
+  cache->strings_size = header->strings_size;
+  if (cache->strings[cache->strings_size - 1] != '\0')
+    return FALSE;
+
+  for (i = 0; i < header->n_entries; i++)
+    {
+      const CacheEntry *entry = &entries[i];
+
+      if (!entry->path || entry->path >= cache->strings_size)
+        return FALSE;
+      if (entry->type != -1
+          && entry->type != HD_APPLICATION_LAUNCHER
+          && entry->type != HD_CATEGORY_LAUNCHER)
+        return FALSE;
+      for (j = 0; j < HD_LAUNCHER_ITEM_N_FIELDS; j++)
+        if (entry->strings[j] >= cache->strings_size)
+          return FALSE;
+
+      g_hash_table_insert (cache->index,
+                           (gpointer)&cache->strings[entry->path],
+                           (gpointer)entry);
+    }
+
+  return TRUE;
+}
+
+/**
+ * hd_launcher_cache_open:
+ *
+ * Loads the launcher cache for a walk of the tree.  Items are looked up
+ * with hd_launcher_cache_lookup(), and those which had to be parsed are
+ * added with hd_launcher_cache_add().  Then hd_launcher_cache_close()
+ * saves everything which was seen.  The cache can be used by one thread
+ * at a time.
+ */
+HdLauncherCache *
+hd_launcher_cache_open (void)
+{
+  HdLauncherCache *cache;
+
+  cache = g_new0 (HdLauncherCache, 1);
+  cache->fname = g_build_filename (g_get_user_cache_dir (),
+                                   HD_LAUNCHER_CACHE_DIR,
+                                   HD_LAUNCHER_CACHE_FILE, NULL);
+  cache->index = g_hash_table_new (g_str_hash, g_str_equal);
+  cache->records = g_array_new (FALSE, FALSE, sizeof (CacheRecord));
+  cache->seen = g_hash_table_new (g_str_hash, g_str_equal);
+
+  if (!hd_launcher_cache_map (cache))
+    {
+      g_warning ("%s: %s is corrupt, ignoring it", __FUNCTION__,
+                 cache->fname);
+      g_hash_table_remove_all (cache->index);
+    }
+
+  return cache;
+}
+
+/* Remembers that @path was seen as @item. */
+static void
+hd_launcher_cache_record (HdLauncherCache *cache,
+                          const gchar *path,
+                          const struct stat *st,
+                          HdLauncherItem *item)
+{
+  CacheRecord record;
+
+  if (g_hash_table_lookup (cache->seen, path))
+    return;
+
+  record.path = g_strdup (path);
+  record.mtime = st->st_mtime;
+  record.size = st->st_size;
+  record.item = item ? g_object_ref (item) : NULL;
+  g_array_append_val (cache->records, record);
+  g_hash_table_insert (cache->seen, record.path, record.path);
+}
+
+/**
+ * hd_launcher_cache_lookup:
+ * @cache: the cache
+ * @path: the desktop file
+ * @st: what stat() returned for @path just now
+ * @id: the id of the new item
+ * @category: the category of the new item
+ * @itemp: where to return the new item
+ *
+ * Looks up @path in @cache, and if it hasn't changed since it was cached
+ * returns %TRUE and creates the #HdLauncherItem it describes in @itemp.
+ * If the desktop file doesn't describe an item @itemp is set to %NULL.
+ */
+gboolean
+hd_launcher_cache_lookup (HdLauncherCache *cache,
+                          const gchar *path,
+                          const struct stat *st,
+                          const gchar *id,
+                          const gchar *category,
+                          HdLauncherItem **itemp)
+{
+  const CacheEntry *entry;
+  HdLauncherItemFields fields;
+  guint i;
+
+  entry = g_hash_table_lookup (cache->index, path);
+  if (!entry || entry->mtime != st->st_mtime || entry->size != st->st_size)
+    return FALSE;
+
+  if (entry->type >= 0)
+    {
+      memset (&fields, 0, sizeof (fields));
+      fields.type = entry->type;
+      for (i = 0; i < HD_LAUNCHER_ITEM_N_FIELDS; i++)
+        fields.strings[i] = entry->strings[i]
+          ? &cache->strings[entry->strings[i]] : NULL;
+      fields.cssu_force_landscape = !!(entry->flags & CACHE_FORCE_LANDSCAPE);
+      fields.prestart_mode = entry->prestart_mode;
+      fields.priority = entry->priority;
+      fields.ignore_lowmem = !!(entry->flags & CACHE_IGNORE_LOWMEM);
+      fields.ignore_load = !!(entry->flags & CACHE_IGNORE_LOAD);
+
+      *itemp = hd_launcher_item_new_from_fields (id, category, &fields);
+    }
+  else
+    *itemp = NULL;
+
+  hd_launcher_cache_record (cache, path, st, *itemp);
+  return TRUE;
+}
+
+/**
+ * hd_launcher_cache_add:
+ * @cache: the cache
+ * @path: the desktop file
+ * @st: what stat() returned for @path before it was parsed
+ * @item: what @path was parsed into or %NULL
+ *
+ * Remembers a desktop file which wasn't found in @cache.
+ */
+void
+hd_launcher_cache_add (HdLauncherCache *cache,
+                       const gchar *path,
+                       const struct stat *st,
+                       HdLauncherItem *item)
+{
+  hd_launcher_cache_record (cache, path, st, item);
+  cache->dirty = TRUE;
+}
+
+/* Appends @str to @strings and returns its offset. */
+static guint32
+hd_launcher_cache_add_string (GString *strings, const gchar *str)
+{
+  guint32 offset;
+
+  if (!str)
+    return 0;
+
+  offset = strings->len;
+  g_string_append_len (strings, str, strlen (str) + 1);
+  return offset;
+}
+
+/* Replaces the cache file with the current records. */
+static void
+hd_launcher_cache_write (HdLauncherCache *cache)
+{
+  CacheHeader header;
+  GString *contents, *strings;
+  GArray *entries;
+  gchar *dir;
+  GError *error;
+  guint i, j;
+
+  entries = g_array_sized_new (FALSE, FALSE, sizeof (CacheEntry),
+                               cache->records->len);
+  strings = g_string_new_len ("", 1);
+  for (i = 0; i < cache->records->len; i++)
+    {
+      const CacheRecord *record;
+      HdLauncherItemFields fields;
+      CacheEntry entry;
+
+      record = &g_array_index (cache->records, CacheRecord, i);
+      memset (&entry, 0, sizeof (entry));
+      entry.mtime = record->mtime;
+      entry.size = record->size;
+      entry.path = hd_launcher_cache_add_string (strings, record->path);
+
+      if (record->item)
+        {
+          hd_launcher_item_get_fields (record->item, &fields);
+          entry.type = fields.type;
+          entry.prestart_mode = fields.prestart_mode;
+          entry.priority = fields.priority;
+          if (fields.cssu_force_landscape)
+            entry.flags |= CACHE_FORCE_LANDSCAPE;
+          if (fields.ignore_lowmem)
+            entry.flags |= CACHE_IGNORE_LOWMEM;
+          if (fields.ignore_load)
+            entry.flags |= CACHE_IGNORE_LOAD;
+          for (j = 0; j < HD_LAUNCHER_ITEM_N_FIELDS; j++)
+            entry.strings[j] = hd_launcher_cache_add_string (strings,
+                                                        fields.strings[j]);
+        }
+      else
+        entry.type = -1;
+
+      g_array_append_val (entries, entry);
+    }
+
+  memset (&header, 0, sizeof (header));
+  header.magic = HD_LAUNCHER_CACHE_MAGIC;
+  header.version = HD_LAUNCHER_CACHE_VERSION;
+  header.sizeof_entry = sizeof (CacheEntry);
+  header.n_entries = entries->len;
+  header.strings_size = strings->len;
+
+  contents = g_string_sized_new (sizeof (header)
+                                 + entries->len * sizeof (CacheEntry)
+                                 + strings->len);
+  g_string_append_len (contents, (const gchar *)&header, sizeof (header));
+  g_string_append_len (contents, entries->data,
+                       entries->len * sizeof (CacheEntry));
+  g_string_append_len (contents, strings->str, strings->len);
+
+  /* g_file_set_contents() replaces the file atomically, so a concurrent
+   * reader sees either the old or the new one. */
+  error = NULL;
+  dir = g_path_get_dirname (cache->fname);
+  g_mkdir_with_parents (dir, 0755);
+  if (!g_file_set_contents (cache->fname, contents->str, contents->len,
+                            &error))
+    {
+      g_warning ("%s: %s", __FUNCTION__, error->message);
+      g_error_free (error);
+    }
+
+  g_free (dir);
+  g_string_free (contents, TRUE);
+  g_string_free (strings, TRUE);
+  g_array_free (entries, TRUE);
+}
+
+/**
+ * hd_launcher_cache_close:
+ * @cache: the cache
+ *
+ * Saves the cache if anything was added or something cached wasn't seen
+ * during the walk, then frees @cache.
+ */
+void
+hd_launcher_cache_close (HdLauncherCache *cache)
+{
+  guint i;
+
+  if (cache->dirty
+      || cache->records->len != g_hash_table_size (cache->index))
+    hd_launcher_cache_write (cache);
+
+  for (i = 0; i < cache->records->len; i++)
+    {
+      CacheRecord *record = &g_array_index (cache->records, CacheRecord, i);
+
+      g_free (record->path);
+      if (record->item)
+        g_object_unref (record->item);
+    }
+  g_array_free (cache->records, TRUE);
+  g_hash_table_destroy (cache->seen);
+  g_hash_table_destroy (cache->index);
+  if (cache->map)
+    g_mapped_file_unref (cache->map);
+  g_free (cache->fname);
+  g_free (cache);
+}
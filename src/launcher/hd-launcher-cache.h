@@ -0,0 +1,57 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2009 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * HdLauncherCache remembers what the desktop files of the launcher tree
+ * were parsed into, so they needn't be parsed again until they change.
+ * The cache is a single file which is mapped and indexed in one go when
+ * the tree is walked.  Entries are keyed by the path of the desktop file
+ * and are only valid while its mtime and size are the same.
+ */
+
+#ifndef __HD_LAUNCHER_CACHE_H__
+#define __HD_LAUNCHER_CACHE_H__
+
+#include <sys/stat.h>
+#include <glib.h>
+
+#include "hd-launcher-item.h"
+
+G_BEGIN_DECLS
+
+typedef struct _HdLauncherCache HdLauncherCache;
+
+HdLauncherCache *hd_launcher_cache_open   (void);
+gboolean         hd_launcher_cache_lookup (HdLauncherCache *cache,
+                                           const gchar *path,
+                                           const struct stat *st,
+                                           const gchar *id,
+                                           const gchar *category,
+                                           HdLauncherItem **itemp);
+void             hd_launcher_cache_add    (HdLauncherCache *cache,
+                                           const gchar *path,
+                                           const struct stat *st,
+                                           HdLauncherItem *item);
+void             hd_launcher_cache_close  (HdLauncherCache *cache);
+
+G_END_DECLS
+
+#endif /* __HD_LAUNCHER_CACHE_H__ */
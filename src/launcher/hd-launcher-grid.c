@@ -123,6 +123,11 @@ static gboolean      hd_launcher_grid_is_portrait (HdLauncherGrid *self);
 #define HD_LAUNCHER_GRID_LEFT_DISMISSAL_AREA_PORTRAIT (64)
 #define HD_LAUNCHER_GRID_RIGHT_DISMISSAL_AREA_PORTRAIT (64)
 
+/* Icons of tiles this far off the visible part of the grid are loaded
+ * in advance, and those of tiles further than KEEP are released. */
+#define HD_LAUNCHER_GRID_ICON_PREFETCH (HD_LAUNCHER_TILE_HEIGHT * 2)
+#define HD_LAUNCHER_GRID_ICON_KEEP     (HD_LAUNCHER_TILE_HEIGHT * 8)
+
 
 G_DEFINE_TYPE_WITH_CODE (HdLauncherGrid,
                          hd_launcher_grid,
@@ -215,6 +220,49 @@ hd_launcher_grid_refresh_v_adjustment (HdLauncherGrid *grid)
                                page_height);
 }
 
+/* Loads the icons of the tiles which are visible or about to be, and
+ * releases those far out of view.  Hidden grids keep what they have. */
+static void
+hd_launcher_grid_update_icons (HdLauncherGrid *grid)
+{
+  HdLauncherGridPrivate *priv = grid->priv;
+  gfloat top, bottom;
+  GList *l;
+
+  if (!CLUTTER_ACTOR_IS_MAPPED (grid))
+    return;
+
+  top = priv->v_adjustment ? tidy_adjustment_get_value (priv->v_adjustment)
+                           : 0;
+  bottom = top + (hd_launcher_grid_is_portrait (grid) ?
+                  HD_COMP_MGR_PORTRAIT_HEIGHT : HD_COMP_MGR_LANDSCAPE_HEIGHT);
+
+  for (l = priv->tiles; l != NULL; l = l->next)
+    {
+      ClutterActor *tile = l->data;
+      gfloat y;
+
+      if (!clutter_actor_is_visible (tile))
+        continue;
+
+      y = clutter_actor_get_y (tile);
+      if (y + HD_LAUNCHER_TILE_HEIGHT >= top - HD_LAUNCHER_GRID_ICON_PREFETCH
+          && y <= bottom + HD_LAUNCHER_GRID_ICON_PREFETCH)
+        hd_launcher_tile_load_icon (HD_LAUNCHER_TILE (tile));
+      else if (y + HD_LAUNCHER_TILE_HEIGHT < top - HD_LAUNCHER_GRID_ICON_KEEP
+               || y > bottom + HD_LAUNCHER_GRID_ICON_KEEP)
+        hd_launcher_tile_unload_icon (HD_LAUNCHER_TILE (tile));
+    }
+}
+
+static void
+hd_launcher_grid_mapped_notify (GObject    *gobject,
+                                GParamSpec *pspec,
+                                gpointer    user_data)
+{
+  hd_launcher_grid_update_icons (HD_LAUNCHER_GRID (gobject));
+}
+
 void
 hd_launcher_grid_reset_v_adjustment (HdLauncherGrid *grid)
 {
@@ -234,6 +282,7 @@ adjustment_value_notify (GObject    *gobject,
   clutter_actor_set_anchor_point(grid,
                              0,
                              tidy_adjustment_get_value(priv->v_adjustment));
+  hd_launcher_grid_update_icons (HD_LAUNCHER_GRID (grid));
 }
 
 static void
@@ -562,6 +611,8 @@ void hd_launcher_grid_layout (HdLauncherGrid *grid)
 
   if (priv->v_adjustment)
     hd_launcher_grid_refresh_v_adjustment (grid);
+
+  hd_launcher_grid_update_icons (grid);
 }
 
 static void
@@ -730,6 +781,8 @@ hd_launcher_grid_init (HdLauncherGrid *launcher)
       launcher, "actor-added", G_CALLBACK(hd_launcher_grid_actor_added), 0);
   g_signal_connect(
       launcher, "actor-removed", G_CALLBACK(hd_launcher_grid_actor_removed), 0);
+  g_signal_connect(
+      launcher, "notify::mapped", G_CALLBACK(hd_launcher_grid_mapped_notify), 0);
 }
 
 ClutterActor *
@@ -32,6 +32,8 @@
 #include "hd-launcher-app.h"
 #include "hd-launcher-cat.h"
 
+#include <string.h>
+
 #define I_(str) (g_intern_static_string ((str)))
 #define HD_PARAM_READ (G_PARAM_READABLE    | \
                        G_PARAM_STATIC_NICK | \
@@ -428,3 +430,64 @@ hd_launcher_item_new_from_keyfile (const gchar *id,
 
   return result;
 }
+
+/* Creates an item from what hd_launcher_item_get_fields() returned
+ * for an item loaded from the same desktop file. */
+HdLauncherItem *
+hd_launcher_item_new_from_fields (const gchar *id,
+                                  const gchar *category,
+                                  const HdLauncherItemFields *fields)
+{
+  HdLauncherItem *result;
+  HdLauncherItemPrivate *priv;
+
+  g_return_val_if_fail (fields != NULL, NULL);
+
+  result = g_object_new (fields->type == HD_APPLICATION_LAUNCHER
+                           ? HD_TYPE_LAUNCHER_APP : HD_TYPE_LAUNCHER_CAT,
+                         NULL);
+  priv = result->priv;
+
+  priv->item_type = fields->type;
+  priv->id = g_strdup (id);
+  priv->id_quark = g_quark_from_string (priv->id);
+  priv->name = g_strdup (fields->strings[HD_LAUNCHER_ITEM_FIELD_NAME]);
+  priv->icon_name = g_strdup (fields->strings[HD_LAUNCHER_ITEM_FIELD_ICON_NAME]);
+  priv->comment = g_strdup (fields->strings[HD_LAUNCHER_ITEM_FIELD_COMMENT]);
+  priv->text_domain =
+    g_strdup (fields->strings[HD_LAUNCHER_ITEM_FIELD_TEXT_DOMAIN]);
+  priv->cssu_force_landscape = fields->cssu_force_landscape;
+
+  if (HD_IS_LAUNCHER_APP (result))
+    hd_launcher_app_set_fields (HD_LAUNCHER_APP (result), fields);
+
+  if (category)
+    priv->category = g_strdup (category);
+  else
+    priv->category = g_strdup (HD_LAUNCHER_ITEM_TOP_CATEGORY);
+
+  return result;
+}
+
+/* Fills @fields with what was parsed from the desktop file of @item.
+ * The strings are owned by @item. */
+void
+hd_launcher_item_get_fields (HdLauncherItem *item,
+                             HdLauncherItemFields *fields)
+{
+  HdLauncherItemPrivate *priv;
+
+  g_return_if_fail (HD_IS_LAUNCHER_ITEM (item));
+  priv = item->priv;
+
+  memset (fields, 0, sizeof (*fields));
+  fields->type = priv->item_type;
+  fields->strings[HD_LAUNCHER_ITEM_FIELD_NAME] = priv->name;
+  fields->strings[HD_LAUNCHER_ITEM_FIELD_ICON_NAME] = priv->icon_name;
+  fields->strings[HD_LAUNCHER_ITEM_FIELD_COMMENT] = priv->comment;
+  fields->strings[HD_LAUNCHER_ITEM_FIELD_TEXT_DOMAIN] = priv->text_domain;
+  fields->cssu_force_landscape = priv->cssu_force_landscape;
+
+  if (HD_IS_LAUNCHER_APP (item))
+    hd_launcher_app_get_fields (HD_LAUNCHER_APP (item), fields);
+}
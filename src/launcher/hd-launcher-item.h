@@ -53,6 +53,37 @@ typedef enum {
   HD_CATEGORY_LAUNCHER
 } HdLauncherItemType;
 
+/* What is parsed from the desktop file of an item,
+ * so it can be saved in the HdLauncherCache. */
+typedef enum {
+  HD_LAUNCHER_ITEM_FIELD_NAME,
+  HD_LAUNCHER_ITEM_FIELD_ICON_NAME,
+  HD_LAUNCHER_ITEM_FIELD_COMMENT,
+  HD_LAUNCHER_ITEM_FIELD_TEXT_DOMAIN,
+
+  /* HdLauncherApp only */
+  HD_LAUNCHER_ITEM_FIELD_EXEC,
+  HD_LAUNCHER_ITEM_FIELD_SERVICE,
+  HD_LAUNCHER_ITEM_FIELD_LOADING_IMAGE,
+  HD_LAUNCHER_ITEM_FIELD_SWITCHER_ICON,
+  HD_LAUNCHER_ITEM_FIELD_WM_CLASS,
+
+  HD_LAUNCHER_ITEM_N_FIELDS
+} HdLauncherItemField;
+
+typedef struct
+{
+  HdLauncherItemType type;
+  const gchar *strings[HD_LAUNCHER_ITEM_N_FIELDS];
+  gboolean cssu_force_landscape;
+
+  /* HdLauncherApp only */
+  gint prestart_mode;
+  gint priority;
+  gboolean ignore_lowmem;
+  gboolean ignore_load;
+} HdLauncherItemFields;
+
 typedef struct _HdLauncherItem          HdLauncherItem;
 typedef struct _HdLauncherItemPrivate   HdLauncherItemPrivate;
 typedef struct _HdLauncherItemClass     HdLauncherItemClass;
@@ -81,6 +112,11 @@ HdLauncherItem *   hd_launcher_item_new_from_keyfile (const gchar *id,
                                                       const gchar *category,
                                                       GKeyFile *key_file,
                                                       GError   **error);
+HdLauncherItem *   hd_launcher_item_new_from_fields  (const gchar *id,
+                                                      const gchar *category,
+                                                      const HdLauncherItemFields *fields);
+void               hd_launcher_item_get_fields       (HdLauncherItem *item,
+                                                      HdLauncherItemFields *fields);
 const gchar *      hd_launcher_item_get_id           (HdLauncherItem *item);
 GQuark             hd_launcher_item_get_id_quark     (HdLauncherItem *item);
 HdLauncherItemType hd_launcher_item_get_item_type    (HdLauncherItem *item);
@@ -33,10 +33,12 @@
 #include <clutter/clutter.h>
 #include <hildon/hildon-defines.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "hd-gtk-style.h"
 #include "tidy/tidy-highlight.h"
 #include "hd-transition.h"
+#include "hd-image-loader.h"
 
 #define I_(str) (g_intern_static_string ((str)))
 #define HD_PARAM_READWRITE (G_PARAM_READWRITE | \
@@ -53,6 +55,9 @@ struct _HdLauncherTilePrivate
   gchar *icon_name;
   gchar *text;
 
+  /* The shared icon, once the grid asked for it. */
+  struct HdLauncherIcon *icon_entry;
+
   ClutterActor *icon;
   ClutterActor *label;
   TidyHighlight *icon_glow;
@@ -115,6 +120,188 @@ static void hd_launcher_tile_allocate (ClutterActor          *self,
 
 G_DEFINE_TYPE (HdLauncherTile, hd_launcher_tile, CLUTTER_TYPE_GROUP);
 
+/*
+ * Icons
+ *
+ * Icons are only looked up and loaded when the grid asks for them, ie.
+ * when their tiles are about to be scrolled into view, and they are
+ * decoded on the image loader's threads.  Tiles with the same icon share
+ * one texture, and the textures are small enough for Cogl to keep them
+ * together in its texture atlas.  Until the icon is ready the tile shows
+ * the default icon.
+ */
+
+typedef struct HdLauncherIcon
+{
+  gchar            *name;
+  guint             refs;
+
+  HdImageLoaderJob *job;
+  CoglHandle        texture;
+  /* HdLauncherTile:s waiting for @texture. */
+  GList            *tiles;
+} HdLauncherIcon;
+
+/* icon name -> HdLauncherIcon */
+static GHashTable *Icons;
+/* What tiles show until their icon is loaded; never released. */
+static HdLauncherIcon *Placeholder;
+
+static void hd_launcher_tile_show_icon (HdLauncherTile *tile);
+
+/* Returns the file of @icon_name in the icon theme, or %NULL. */
+static gchar *
+hd_launcher_icon_find (const gchar *icon_name)
+{
+  GtkIconTheme *icon_theme;
+  GtkIconInfo *info;
+  gchar *fname;
+
+  /* The desktop file contains path to the icon. */
+  if (g_strrstr (icon_name, ".png") != NULL
+      && g_file_test (icon_name, G_FILE_TEST_EXISTS))
+    return g_strdup (icon_name);
+
+  /* Try to get the 64x64 icon. */
+  icon_theme = gtk_icon_theme_get_default();
+  info = gtk_icon_theme_lookup_icon(icon_theme, icon_name,
+                                    HD_LAUNCHER_TILE_ICON_REAL_SIZE,
+                                    GTK_ICON_LOOKUP_NO_SVG);
+
+  if (info == NULL)
+    {
+      /* Try to get the Harmattan (80x80) icon. The icon will be scaled
+       * down to 64x64. */
+      info = gtk_icon_theme_lookup_icon(icon_theme, icon_name,
+                                        HD_LAUNCHER_TILE_ICON_REAL_SIZE_HARMATTAN_COMP,
+                                        GTK_ICON_LOOKUP_NO_SVG);
+    }
+
+  if (info == NULL)
+    return NULL;
+
+  fname = g_strdup (gtk_icon_info_get_filename (info));
+  gtk_icon_info_free (info);
+  return fname;
+}
+
+/* Runs on a worker thread.  We must expand these images so there is a
+ * 1 pixel transparent border around them, or the glow effect won't work
+ * properly.  The image isn't guaranteed to be the correct size either. */
+static GdkPixbuf *
+hd_launcher_icon_prepare (GdkPixbuf *pixbuf, guint width, guint height)
+{
+  GdkPixbuf *padded;
+  gint w, h;
+
+  w = gdk_pixbuf_get_width (pixbuf);
+  h = gdk_pixbuf_get_height (pixbuf);
+  if (w != width || h != height)
+    {
+      GdkPixbuf *scaled;
+      gdouble scale;
+
+      scale = MIN ((gdouble)width / w, (gdouble)height / h);
+      w = MAX (1, (gint)(w * scale));
+      h = MAX (1, (gint)(h * scale));
+      scaled = gdk_pixbuf_scale_simple (pixbuf, w, h, GDK_INTERP_BILINEAR);
+      g_object_unref (pixbuf);
+      pixbuf = scaled;
+    }
+
+  padded = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, w+2, h+2);
+  gdk_pixbuf_fill (padded, 0);
+  gdk_pixbuf_copy_area (pixbuf, 0, 0, w, h, padded, 1, 1);
+  g_object_unref (pixbuf);
+
+  return padded;
+}
+
+static void
+hd_launcher_icon_loaded (HdImageLoaderJob *job, GdkPixbuf *pixbuf,
+                         const GError *error, gpointer user_data)
+{
+  HdLauncherIcon *icon = user_data;
+  GList *tiles;
+
+  icon->job = NULL;
+  if (pixbuf)
+    icon->texture = cogl_texture_new_from_data (
+                            gdk_pixbuf_get_width (pixbuf),
+                            gdk_pixbuf_get_height (pixbuf),
+                            COGL_TEXTURE_NONE,
+                            COGL_PIXEL_FORMAT_RGBA_8888,
+                            COGL_PIXEL_FORMAT_ANY,
+                            gdk_pixbuf_get_rowstride (pixbuf),
+                            gdk_pixbuf_get_pixels (pixbuf));
+  if (!icon->texture)
+    g_warning ("%s: couldn't load icon %s: %s", __FUNCTION__, icon->name,
+               error ? error->message : "no texture");
+
+  tiles = icon->tiles;
+  icon->tiles = NULL;
+  g_list_foreach (tiles, (GFunc)hd_launcher_tile_show_icon, NULL);
+  g_list_free (tiles);
+}
+
+/* Returns a reference to the icon @icon_name, starting to load it if it
+ * isn't yet. */
+static HdLauncherIcon *
+hd_launcher_icon_get (const gchar *icon_name)
+{
+  HdLauncherIcon *icon;
+  gchar *fname;
+
+  if (!Icons)
+    Icons = g_hash_table_new (g_str_hash, g_str_equal);
+  if ((icon = g_hash_table_lookup (Icons, icon_name)) != NULL)
+    {
+      icon->refs++;
+      return icon;
+    }
+
+  icon = g_slice_new0 (HdLauncherIcon);
+  icon->name = g_strdup (icon_name);
+  icon->refs = 1;
+  g_hash_table_insert (Icons, icon->name, icon);
+
+  if (!(fname = hd_launcher_icon_find (icon_name))
+      && strcmp (icon_name, HD_LAUNCHER_DEFAULT_ICON))
+    /* Try to get the default icon. */
+    fname = hd_launcher_icon_find (HD_LAUNCHER_DEFAULT_ICON);
+  if (!fname)
+    {
+      g_warning ("%s: couldn't find icon %s\n", __FUNCTION__, icon_name);
+      return icon;
+    }
+
+  icon->job = hd_image_loader_load (fname, hd_launcher_icon_prepare,
+                                    HD_LAUNCHER_TILE_ICON_REAL_SIZE,
+                                    HD_LAUNCHER_TILE_ICON_REAL_SIZE,
+                                    G_PRIORITY_DEFAULT_IDLE,
+                                    hd_launcher_icon_loaded, icon);
+  g_free (fname);
+
+  return icon;
+}
+
+static void
+hd_launcher_icon_unref (HdLauncherIcon *icon)
+{
+  if (--icon->refs > 0)
+    return;
+
+  if (icon->job)
+    hd_image_loader_cancel (icon->job);
+  if (icon->texture)
+    cogl_object_unref (icon->texture);
+  g_list_free (icon->tiles);
+  g_hash_table_remove (Icons, icon->name);
+  g_free (icon->name);
+  g_slice_free (HdLauncherIcon, icon);
+}
+
+
 static void
 hd_launcher_tile_class_init (HdLauncherTileClass *klass)
 {
@@ -281,133 +468,42 @@ hd_launcher_tile_get_label (HdLauncherTile *tile)
   return priv->label;
 }
 
-void
-hd_launcher_tile_set_icon_name (HdLauncherTile *tile,
-                                const gchar *icon_name)
+/* Returns the colour of the glow from the theme. */
+static void
+hd_launcher_tile_get_glow_color (ClutterColor *glow_col)
 {
-  HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (tile);
-  GtkIconTheme *icon_theme;
-  GdkPixbuf *pixbuf;
-  GtkIconInfo *info = NULL;
-  const gchar *fname;
-
-  if (priv->icon_name)
-    {
-      g_free (priv->icon_name);
-    }
-  if (icon_name)
-    priv->icon_name = g_strdup (icon_name);
-  else
-    /* Set the default if none was passed. */
-    priv->icon_name = g_strdup (HD_LAUNCHER_DEFAULT_ICON);
-
-  fname = priv->icon_name;
-
-  /* Recreate the icon actor */
-  if (priv->icon)
-    {
-      clutter_actor_destroy (priv->icon);
-      priv->icon = NULL;
-    }
-
-  /* The desktop file contains path to the icon. */
-  if (g_file_test (fname, G_FILE_TEST_EXISTS)
-        && (g_strrstr (priv->icon_name, ".png") != NULL))
-    {
-      fname = priv->icon_name;
-    }
-  else
-    {
-      /* Try to get the 64x64 icon. */
-      icon_theme = gtk_icon_theme_get_default();
-      info = gtk_icon_theme_lookup_icon(icon_theme, priv->icon_name,
-                                        HD_LAUNCHER_TILE_ICON_REAL_SIZE,
-                                        GTK_ICON_LOOKUP_NO_SVG);
-
-      if (info == NULL)
-        {
-          /* Try to get the Harmattan (80x80) icon. The icon will be scaled 
-           * down to 64x64. */
-          info = gtk_icon_theme_lookup_icon(icon_theme, priv->icon_name,
-                                            HD_LAUNCHER_TILE_ICON_REAL_SIZE_HARMATTAN_COMP,
-                                            GTK_ICON_LOOKUP_NO_SVG);
-        }
-
-      if (info == NULL)
-        {
-          /* Try to get the default icon. */
-          g_free (priv->icon_name);
-          priv->icon_name = g_strdup (HD_LAUNCHER_DEFAULT_ICON);
-          info = gtk_icon_theme_lookup_icon(icon_theme, priv->icon_name,
-                                            HD_LAUNCHER_TILE_ICON_REAL_SIZE,
-                                            GTK_ICON_LOOKUP_NO_SVG);
-        }
-
-      if (info == NULL)
-        {
-          g_warning ("%s: couldn't find icon %s\n", __FUNCTION__, priv->icon_name);
-          g_free (priv->icon_name); 
-          priv->icon_name = NULL;
-          return;
-        }
-
-      fname = gtk_icon_info_get_filename(info);
-      if (fname == NULL)
-        {
-          g_warning ("%s: couldn't get icon %s\n", __FUNCTION__, priv->icon_name);
-          g_free (priv->icon_name);
-          priv->icon_name = NULL;
-          return;
-        }
-    }
-
-  /* We must expand these images so there is a 1 pixel transparent
-   * border around them, or the glow effect won't work properly. We use
-   * gdk_pixbuf_new_from_file_at_size as the pixbuf pointed to by fname
-   * isn't actually guaranteed to be the correct size.  */
-  pixbuf = gdk_pixbuf_new_from_file_at_size(fname,
-      HD_LAUNCHER_TILE_ICON_REAL_SIZE, HD_LAUNCHER_TILE_ICON_REAL_SIZE, 0);
-
-  if (pixbuf)
-    {
-      gint w = gdk_pixbuf_get_width(pixbuf);
-      gint h = gdk_pixbuf_get_height(pixbuf);
-
-      GdkPixbuf *pixbufb = gdk_pixbuf_new(
-          GDK_COLORSPACE_RGB, TRUE, 8, w+2, h+2);
+  float glow_brightness;
 
-      gdk_pixbuf_fill(pixbufb, 0);
-      gdk_pixbuf_copy_area(pixbuf, 0, 0, w, h,
-                           pixbufb, 1, 1);
+  glow_col->red = glow_col->green = glow_col->alpha = 0xFF;
+  glow_col->blue = 0x7F;
+  glow_brightness = hd_transition_get_double("launcher_glow", "brightness", 1);
+  hd_gtk_style_get_light_color(HD_GTK_BUTTON_SINGLETON, GTK_STATE_ACTIVE,
+                               glow_col);
+  glow_col->alpha = (int)(glow_col->alpha * glow_brightness);
+}
 
-      priv->icon = clutter_texture_new();
-      clutter_texture_set_from_rgb_data(
-          CLUTTER_TEXTURE(priv->icon),
-          gdk_pixbuf_get_pixels(pixbufb),
-          gdk_pixbuf_get_has_alpha(pixbufb),
-          gdk_pixbuf_get_width(pixbufb),
-          gdk_pixbuf_get_height(pixbufb),
-          gdk_pixbuf_get_rowstride(pixbufb),
-          gdk_pixbuf_get_n_channels(pixbufb), 0, 0);
-      g_object_unref(pixbufb);
-    }
-  if (pixbuf)
-    g_object_unref(pixbuf);
+/* Shows the icon of @tile if it's loaded, otherwise the placeholder. */
+static void
+hd_launcher_tile_show_icon (HdLauncherTile *tile)
+{
+  HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (tile);
+  HdLauncherIcon *icon;
 
   if (!priv->icon)
-  {
-    g_warning ("%s: couldn't create texture for %s\n", __FUNCTION__, fname);
-    g_free (priv->icon_name);
-    priv->icon_name = NULL;
     return;
-  }
 
-  clutter_actor_set_size (priv->icon,
-      HD_LAUNCHER_TILE_ICON_SIZE,
-      HD_LAUNCHER_TILE_ICON_SIZE);
-  clutter_actor_set_position (priv->icon,
-      (HD_LAUNCHER_TILE_WIDTH - HD_LAUNCHER_TILE_ICON_SIZE) / 2, 0);
+  icon = priv->icon_entry && priv->icon_entry->texture
+    ? priv->icon_entry : Placeholder;
+  if (!icon || !icon->texture)
+    return;
+  if (clutter_texture_get_cogl_texture (CLUTTER_TEXTURE (priv->icon))
+      == icon->texture)
+    return;
+
+  clutter_texture_set_cogl_texture (CLUTTER_TEXTURE (priv->icon),
+                                    icon->texture);
 
+  /* The glow takes the texture when it's created. */
   if (priv->icon_glow)
     /* free the old one */
     clutter_actor_destroy (CLUTTER_ACTOR (priv->icon_glow));
@@ -421,11 +517,94 @@ hd_launcher_tile_set_icon_name (HdLauncherTile *tile,
         (HD_LAUNCHER_TILE_ICON_SIZE - HD_LAUNCHER_TILE_GLOW_SIZE) / 2);
   clutter_actor_add_child (CLUTTER_ACTOR(tile), CLUTTER_ACTOR(priv->icon_glow));
   clutter_actor_lower_bottom(CLUTTER_ACTOR(priv->icon_glow));
-  clutter_actor_add_child (CLUTTER_ACTOR(tile), priv->icon);
 
-  clutter_actor_hide(CLUTTER_ACTOR(priv->icon_glow));
+  if (priv->glow_amount != 0)
+    {
+      ClutterColor glow_col;
 
-  gtk_icon_info_free(info);
+      hd_launcher_tile_get_glow_color (&glow_col);
+      tidy_highlight_set_color(priv->icon_glow, &glow_col);
+      tidy_highlight_set_amount(priv->icon_glow,
+                                priv->glow_amount * priv->glow_radius);
+    }
+  else
+    clutter_actor_hide(CLUTTER_ACTOR(priv->icon_glow));
+}
+
+/* Starts loading the icon of @tile, which is about to be visible. */
+void
+hd_launcher_tile_load_icon (HdLauncherTile *tile)
+{
+  HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (tile);
+
+  if (priv->icon_entry || !priv->icon_name)
+    return;
+
+  if (!Placeholder)
+    Placeholder = hd_launcher_icon_get (HD_LAUNCHER_DEFAULT_ICON);
+  priv->icon_entry = hd_launcher_icon_get (priv->icon_name);
+
+  if (!Placeholder->texture && Placeholder->job
+      && Placeholder != priv->icon_entry)
+    Placeholder->tiles = g_list_prepend (Placeholder->tiles, tile);
+  if (!priv->icon_entry->texture && priv->icon_entry->job)
+    priv->icon_entry->tiles = g_list_prepend (priv->icon_entry->tiles, tile);
+
+  hd_launcher_tile_show_icon (tile);
+}
+
+/* Releases the icon of @tile, which is far from view, and shows the
+ * placeholder instead. */
+void
+hd_launcher_tile_unload_icon (HdLauncherTile *tile)
+{
+  HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (tile);
+  HdLauncherIcon *icon;
+
+  if (!(icon = priv->icon_entry))
+    return;
+
+  icon->tiles = g_list_remove (icon->tiles, tile);
+  Placeholder->tiles = g_list_remove (Placeholder->tiles, tile);
+  priv->icon_entry = NULL;
+  hd_launcher_tile_show_icon (tile);
+  hd_launcher_icon_unref (icon);
+}
+
+/* Only remembers @icon_name, the icon is loaded by
+ * hd_launcher_tile_load_icon(). */
+void
+hd_launcher_tile_set_icon_name (HdLauncherTile *tile,
+                                const gchar *icon_name)
+{
+  HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (tile);
+  gboolean loaded;
+
+  loaded = priv->icon_entry != NULL;
+  hd_launcher_tile_unload_icon (tile);
+
+  g_free (priv->icon_name);
+  if (icon_name)
+    priv->icon_name = g_strdup (icon_name);
+  else
+    /* Set the default if none was passed. */
+    priv->icon_name = g_strdup (HD_LAUNCHER_DEFAULT_ICON);
+
+  if (!priv->icon)
+    {
+      /* The texture is set when an icon is loaded. */
+      priv->icon = clutter_texture_new();
+      clutter_actor_set_size (priv->icon,
+          HD_LAUNCHER_TILE_ICON_SIZE,
+          HD_LAUNCHER_TILE_ICON_SIZE);
+      clutter_actor_set_position (priv->icon,
+          (HD_LAUNCHER_TILE_WIDTH - HD_LAUNCHER_TILE_ICON_SIZE) / 2, 0);
+      clutter_actor_add_child (CLUTTER_ACTOR(tile), priv->icon);
+      hd_launcher_tile_show_icon (tile);
+    }
+
+  if (loaded)
+    hd_launcher_tile_load_icon (tile);
 }
 
 void
@@ -536,8 +715,7 @@ static void
 hd_launcher_tile_set_glow(HdLauncherTile *tile, gboolean glow, gboolean hard)
 {
   HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (tile);
-  ClutterColor glow_col = {0xFF, 0xFF, 0x7F, 0xFF};
-  float glow_brightness;
+  ClutterColor glow_col;
   guint duration;
 
   clutter_timeline_stop(priv->glow_timeline);
@@ -579,10 +757,7 @@ hd_launcher_tile_set_glow(HdLauncherTile *tile, gboolean glow, gboolean hard)
                            (guint)(priv->glow_amount*duration));
 
   /* set our glow colour from the theme */
-  glow_brightness = hd_transition_get_double("launcher_glow", "brightness", 1);
-  hd_gtk_style_get_light_color(HD_GTK_BUTTON_SINGLETON, GTK_STATE_ACTIVE,
-                               &glow_col);
-  glow_col.alpha = (int)(glow_col.alpha * glow_brightness);
+  hd_launcher_tile_get_glow_color(&glow_col);
   if (priv->icon_glow)
     tidy_highlight_set_color(priv->icon_glow, &glow_col);
   /* load our glow radius */
@@ -698,6 +873,7 @@ hd_launcher_tile_dispose (GObject *gobject)
       clutter_actor_destroy (priv->icon);
       priv->icon = 0;
     }
+  hd_launcher_tile_unload_icon (HD_LAUNCHER_TILE (gobject));
   G_OBJECT_CLASS (hd_launcher_tile_parent_class)->dispose (gobject);
 }
 
@@ -71,6 +71,9 @@ void hd_launcher_tile_set_icon_name (HdLauncherTile *tile,
 void hd_launcher_tile_set_text      (HdLauncherTile *tile,
                                      const gchar *text);
 
+void hd_launcher_tile_load_icon   (HdLauncherTile *tile);
+void hd_launcher_tile_unload_icon (HdLauncherTile *tile);
+
 ClutterActor *hd_launcher_tile_get_icon (HdLauncherTile *tile);
 ClutterActor *hd_launcher_tile_get_label (HdLauncherTile *tile);
 
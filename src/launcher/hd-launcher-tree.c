@@ -4,6 +4,7 @@
 
 #include "hildon-desktop.h"
 #include "hd-launcher-tree.h"
+#include "hd-launcher-cache.h"
 
 #include "hd-gtk-style.h"
 
@@ -28,6 +29,9 @@ typedef struct
   /* The items we have created so far. */
   GList *items;
 
+  /* Shared by all levels of a walk. */
+  HdLauncherCache *cache;
+
   /* accessed by both threads */
   volatile gboolean cancelled : 1;
 } WalkThreadData;
@@ -87,6 +91,7 @@ walk_thread_data_new_level (WalkThreadData *parent, GMenuTreeDirectory *dir)
   WalkThreadData *result = walk_thread_data_new (parent->tree);
   result->level = parent->level + 1;
   result->root = dir;
+  result->cache = parent->cache;
   return result;
 }
 
@@ -149,7 +154,8 @@ walk_thread_done_idle (gpointer user_data)
 
 /**
  * This function, in a separate thread, builds up a list of items
- * reading their .desktop files.
+ * reading their .desktop files.  Only those which changed since
+ * the last walk are parsed, the rest is taken from the cache.
  */
 static gpointer
 walk_thread_func (gpointer user_data)
@@ -158,6 +164,9 @@ walk_thread_func (gpointer user_data)
   GMenuTreeIter *iter;
   GMenuTreeItemType next_type;
 
+  if (data->level == 0)
+    data->cache = hd_launcher_cache_open ();
+
   iter = gmenu_tree_directory_iter (data->root);
 
   while ((next_type = gmenu_tree_iter_next (iter)) != GMENU_TREE_ITEM_INVALID)
@@ -214,6 +223,13 @@ walk_thread_func (gpointer user_data)
           g_warning ("%s: Unable to stat %s", __FUNCTION__,
                                key_file_path);
         }
+      else if (hd_launcher_cache_lookup (data->cache, key_file_path,
+                       &key_file_stat, id,
+                       gmenu_tree_directory_get_menu_id (data->root),
+                       &item))
+        {
+          /* Unchanged since we parsed it last time. */
+        }
       else
         {
           key_file = g_key_file_new ();
@@ -235,6 +251,8 @@ walk_thread_func (gpointer user_data)
                   gmenu_tree_directory_get_menu_id (data->root),
                   key_file, NULL);
 	g_key_file_free (key_file);
+        hd_launcher_cache_add (data->cache, key_file_path,
+                               &key_file_stat, item);
       }
       if (item)
         data->items = g_list_prepend (data->items, (gpointer)item);
@@ -248,6 +266,9 @@ walk_thread_func (gpointer user_data)
     {
       data->items = g_list_reverse (data->items);
 
+      hd_launcher_cache_close (data->cache);
+      data->cache = NULL;
+
       clutter_threads_add_idle (walk_thread_done_idle, data);
     }
 
@@ -46,6 +46,7 @@
 #include "hd-gtk-utils.h"
 #include "hd-render-manager.h"
 #include "hd-app-mgr.h"
+#include "hd-launch-trace.h"
 #include "hd-gtk-style.h"
 #include "hd-theme.h"
 #include "hd-clutter-cache.h"
@@ -483,6 +484,8 @@ hd_launcher_application_tile_clicked (HdLauncherTile *tile,
   HdLauncherApp *app = HD_LAUNCHER_APP (data);
   ClutterActor *top_page;
 
+  hd_launch_trace_tap ();
+
   /* We must do this before hd_app_mgr_launch, as it uses the tile
    * clicked in order to zoom the launch image from the correct place */
   if (tile)
@@ -958,6 +961,8 @@ hd_launcher_transition_app_start (HdLauncherApp *item)
   if (STATE_IS_LOADING(hd_render_manager_get_state()))
       return FALSE;
 
+  hd_launch_trace_transition (item);
+
   /* Is there a cached image? */
   if (item)
     service_name = hd_launcher_app_get_service (item);
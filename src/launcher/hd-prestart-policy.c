@@ -0,0 +1,358 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2009 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "hd-prestart-policy.h"
+
+#include <math.h>
+#include <stdio.h>
+
+/* Launches count half as much after this many microseconds. */
+#define FREQUENCY_HALF_LIFE   (3 * 24 * 3600 * G_GINT64_CONSTANT (1000000))
+/* Weight of the latest latency in the running averages. */
+#define LATENCY_WEIGHT        0.25
+/* Latencies longer than this are not launches but something else,
+ * like a service whose window was opened much later. */
+#define LATENCY_MAX_MS        60000.0
+/* Until we know, assume a prestarted app takes this much of the time
+ * of a cold start to show up. */
+#define DEFAULT_WARM_RATIO    0.3
+#define DEFAULT_SIZE_KB       (8 * 1024)
+/* Don't let tiny apps score infinitely well. */
+#define MIN_SIZE_KB           1024
+
+typedef struct
+{
+  /* Number of launches, decaying with FREQUENCY_HALF_LIFE
+   * since @last_launch. */
+  gdouble frequency;
+  gint64  last_launch;
+
+  /* When the launch we're timing started, or 0. */
+  gint64   pending;
+  gboolean pending_warm;
+
+  /* Running average of the time it took the first window to appear,
+   * or 0 if we haven't seen it yet. */
+  gdouble cold_ms, warm_ms;
+
+  guint size_kb;
+} HdPrestartRecord;
+
+struct _HdPrestartPolicy
+{
+  /* id -> HdPrestartRecord */
+  GHashTable *records;
+
+  /* Where hd_prestart_policy_set_trace() logs launches, if anywhere. */
+  FILE *trace;
+};
+
+HdPrestartPolicy *
+hd_prestart_policy_new (void)
+{
+  HdPrestartPolicy *policy = g_new0 (HdPrestartPolicy, 1);
+
+  policy->records = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                           g_free, g_free);
+  return policy;
+}
+
+void
+hd_prestart_policy_free (HdPrestartPolicy *policy)
+{
+  if (!policy)
+    return;
+
+  hd_prestart_policy_set_trace (policy, NULL);
+  g_hash_table_destroy (policy->records);
+  g_free (policy);
+}
+
+static HdPrestartRecord *
+hd_prestart_policy_get_record (HdPrestartPolicy *policy, const gchar *id,
+                               gboolean create)
+{
+  HdPrestartRecord *record;
+
+  record = g_hash_table_lookup (policy->records, id);
+  if (!record && create)
+    {
+      record = g_new0 (HdPrestartRecord, 1);
+      g_hash_table_insert (policy->records, g_strdup (id), record);
+    }
+  return record;
+}
+
+static gdouble
+hd_prestart_record_frequency (const HdPrestartRecord *record, gint64 now)
+{
+  if (now <= record->last_launch)
+    return record->frequency;
+  return record->frequency
+    * exp2 (-(gdouble)(now - record->last_launch) / FREQUENCY_HALF_LIFE);
+}
+
+static void
+hd_prestart_record_average (gdouble *avg, gdouble ms)
+{
+  *avg = *avg > 0 ? *avg + (ms - *avg) * LATENCY_WEIGHT : ms;
+}
+
+/* Loads the history saved by hd_prestart_policy_save(). */
+gboolean
+hd_prestart_policy_load (HdPrestartPolicy *policy, const gchar *fname)
+{
+  GKeyFile *history;
+  gchar **ids;
+  guint i;
+
+  history = g_key_file_new ();
+  if (!g_key_file_load_from_file (history, fname, 0, NULL))
+    {
+      g_key_file_free (history);
+      return FALSE;
+    }
+
+  ids = g_key_file_get_groups (history, NULL);
+  for (i = 0; ids[i]; i++)
+    {
+      HdPrestartRecord *record;
+
+      record = hd_prestart_policy_get_record (policy, ids[i], TRUE);
+      record->frequency = g_key_file_get_double (history, ids[i],
+                                                 "frequency", NULL);
+      record->last_launch = g_key_file_get_double (history, ids[i],
+                                                   "last_launch", NULL)
+        * G_USEC_PER_SEC;
+      record->cold_ms = g_key_file_get_double (history, ids[i],
+                                               "cold_ms", NULL);
+      record->warm_ms = g_key_file_get_double (history, ids[i],
+                                               "warm_ms", NULL);
+      record->size_kb = g_key_file_get_integer (history, ids[i],
+                                                "size_kb", NULL);
+    }
+  g_strfreev (ids);
+
+  g_key_file_free (history);
+  return TRUE;
+}
+
+gboolean
+hd_prestart_policy_save (HdPrestartPolicy *policy, const gchar *fname)
+{
+  GKeyFile *history;
+  GHashTableIter iter;
+  const gchar *id;
+  HdPrestartRecord *record;
+  gchar *dir, *contents;
+  gsize len;
+  gboolean ret;
+
+  history = g_key_file_new ();
+  g_hash_table_iter_init (&iter, policy->records);
+  while (g_hash_table_iter_next (&iter, (gpointer *)&id, (gpointer *)&record))
+    {
+      g_key_file_set_double (history, id, "frequency", record->frequency);
+      g_key_file_set_double (history, id, "last_launch",
+                             (gdouble)record->last_launch / G_USEC_PER_SEC);
+      g_key_file_set_double (history, id, "cold_ms", record->cold_ms);
+      g_key_file_set_double (history, id, "warm_ms", record->warm_ms);
+      g_key_file_set_integer (history, id, "size_kb", record->size_kb);
+    }
+
+  dir = g_path_get_dirname (fname);
+  g_mkdir_with_parents (dir, 0755);
+  g_free (dir);
+
+  contents = g_key_file_to_data (history, &len, NULL);
+  ret = g_file_set_contents (fname, contents, len, NULL);
+  g_free (contents);
+  g_key_file_free (history);
+
+  return ret;
+}
+
+/* Appends the launches and closes of applications to @fname from now on,
+ * one per line, in the format tests/test-prestart-sim reads:
+ *   <time> launch <app-id> <cold-ms> <warm-ms> <size-kb>
+ *   <time> close <app-id>
+ * A launch is logged when its latency is known, with the current averages
+ * of the application.  Stops logging if @fname is %NULL. */
+gboolean
+hd_prestart_policy_set_trace (HdPrestartPolicy *policy, const gchar *fname)
+{
+  if (policy->trace)
+    {
+      fclose (policy->trace);
+      policy->trace = NULL;
+    }
+  if (!fname)
+    return TRUE;
+
+  if (!(policy->trace = fopen (fname, "a")))
+    {
+      g_warning ("%s: couldn't open %s", __FUNCTION__, fname);
+      return FALSE;
+    }
+  return TRUE;
+}
+
+static void
+hd_prestart_policy_trace_launch (HdPrestartPolicy *policy, const gchar *id,
+                                 const HdPrestartRecord *record, gint64 when)
+{
+  gdouble cold_ms, warm_ms;
+
+  /* We only have one of them for sure. */
+  cold_ms = record->cold_ms ? record->cold_ms
+    : record->warm_ms / DEFAULT_WARM_RATIO;
+  warm_ms = record->warm_ms ? record->warm_ms
+    : record->cold_ms * DEFAULT_WARM_RATIO;
+
+  fprintf (policy->trace, "%.3f launch %s %.0f %.0f %u\n",
+           (gdouble)when / G_USEC_PER_SEC, id, cold_ms, warm_ms,
+           record->size_kb ? record->size_kb : DEFAULT_SIZE_KB);
+  fflush (policy->trace);
+}
+
+/* To be called when the user launches @id.  Unless @kind is
+ * %HD_PRESTART_LAUNCH_OTHER, the time until hd_prestart_policy_shown()
+ * is taken as its cold or warm start latency. */
+void
+hd_prestart_policy_launched (HdPrestartPolicy *policy, const gchar *id,
+                             gint64 now, HdPrestartLaunchKind kind)
+{
+  HdPrestartRecord *record;
+
+  record = hd_prestart_policy_get_record (policy, id, TRUE);
+  record->frequency = hd_prestart_record_frequency (record, now) + 1;
+  record->last_launch = now;
+
+  record->pending = kind != HD_PRESTART_LAUNCH_OTHER ? now : 0;
+  record->pending_warm = kind == HD_PRESTART_LAUNCH_WARM;
+}
+
+/* To be called when the first window of @id appears. */
+void
+hd_prestart_policy_shown (HdPrestartPolicy *policy, const gchar *id,
+                          gint64 now)
+{
+  HdPrestartRecord *record;
+  gdouble ms;
+
+  record = hd_prestart_policy_get_record (policy, id, FALSE);
+  if (!record || !record->pending)
+    return;
+
+  ms = (gdouble)(now - record->pending) / 1000;
+  if (ms < 0 || ms > LATENCY_MAX_MS)
+    {
+      record->pending = 0;
+      return;
+    }
+
+  hd_prestart_record_average (record->pending_warm
+                              ? &record->warm_ms : &record->cold_ms, ms);
+  if (policy->trace)
+    hd_prestart_policy_trace_launch (policy, id, record, record->pending);
+  record->pending = 0;
+}
+
+/* To be called when the user's instance of @id goes away. */
+void
+hd_prestart_policy_closed (HdPrestartPolicy *policy, const gchar *id,
+                           gint64 now)
+{
+  HdPrestartRecord *record;
+
+  record = hd_prestart_policy_get_record (policy, id, FALSE);
+  if (record)
+    record->pending = 0;
+
+  if (policy->trace)
+    {
+      fprintf (policy->trace, "%.3f close %s\n",
+               (gdouble)now / G_USEC_PER_SEC, id);
+      fflush (policy->trace);
+    }
+}
+
+/* Sets how much memory @id takes when it's running. */
+void
+hd_prestart_policy_set_size (HdPrestartPolicy *policy, const gchar *id,
+                             guint size_kb)
+{
+  hd_prestart_policy_get_record (policy, id, TRUE)->size_kb = size_kb;
+}
+
+/* Returns how much memory @id is expected to take. */
+guint
+hd_prestart_policy_get_size (HdPrestartPolicy *policy, const gchar *id)
+{
+  HdPrestartRecord *record;
+
+  record = hd_prestart_policy_get_record (policy, id, FALSE);
+  return record && record->size_kb ? record->size_kb : DEFAULT_SIZE_KB;
+}
+
+/* Returns the decayed number of times @id has been launched. */
+gdouble
+hd_prestart_policy_frequency (HdPrestartPolicy *policy, const gchar *id,
+                              gint64 now)
+{
+  HdPrestartRecord *record;
+
+  record = hd_prestart_policy_get_record (policy, id, FALSE);
+  return record ? hd_prestart_record_frequency (record, now) : 0;
+}
+
+/* Returns how many milliseconds of launch latency prestarting @id is
+ * expected to save per MB of RAM, weighted by how often it's launched.
+ * It's 0 for applications we know nothing about. */
+gdouble
+hd_prestart_policy_score (HdPrestartPolicy *policy, const gchar *id,
+                          gint64 now)
+{
+  HdPrestartRecord *record;
+  gdouble saving;
+  guint size_kb;
+
+  record = hd_prestart_policy_get_record (policy, id, FALSE);
+  if (!record || !record->cold_ms)
+    return 0;
+
+  saving = record->cold_ms - (record->warm_ms
+                              ? record->warm_ms
+                              : record->cold_ms * DEFAULT_WARM_RATIO);
+  if (saving <= 0)
+    return 0;
+
+  size_kb = record->size_kb ? record->size_kb : DEFAULT_SIZE_KB;
+  if (size_kb < MIN_SIZE_KB)
+    size_kb = MIN_SIZE_KB;
+
+  return hd_prestart_record_frequency (record, now) * saving
+    / (size_kb / 1024.0);
+}
@@ -0,0 +1,85 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2009 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * HdPrestartPolicy keeps the launch history of applications: how often
+ * they are launched, how long it takes for their first window to appear
+ * when they are started from scratch and when they were prestarted, and
+ * how much memory they use.  From these it scores how much launch latency
+ * prestarting an application is expected to save per MB of RAM it takes.
+ *
+ * It only deals with application ids and times given by the caller, so
+ * it can be driven by HdAppMgr as well as by an offline simulator, and
+ * it can log the launches it sees as a trace for that simulator.
+ */
+
+#ifndef __HD_PRESTART_POLICY_H__
+#define __HD_PRESTART_POLICY_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _HdPrestartPolicy HdPrestartPolicy;
+
+typedef enum
+{
+  HD_PRESTART_LAUNCH_COLD,    /* started from scratch */
+  HD_PRESTART_LAUNCH_WARM,    /* was prestarted */
+  HD_PRESTART_LAUNCH_OTHER,   /* eg. woken up; only counted */
+} HdPrestartLaunchKind;
+
+HdPrestartPolicy *hd_prestart_policy_new      (void);
+void              hd_prestart_policy_free     (HdPrestartPolicy *policy);
+
+gboolean          hd_prestart_policy_load     (HdPrestartPolicy *policy,
+                                               const gchar *fname);
+gboolean          hd_prestart_policy_save     (HdPrestartPolicy *policy,
+                                               const gchar *fname);
+gboolean          hd_prestart_policy_set_trace (HdPrestartPolicy *policy,
+                                                const gchar *fname);
+
+void              hd_prestart_policy_launched (HdPrestartPolicy *policy,
+                                               const gchar *id,
+                                               gint64 now,
+                                               HdPrestartLaunchKind kind);
+void              hd_prestart_policy_shown    (HdPrestartPolicy *policy,
+                                               const gchar *id,
+                                               gint64 now);
+void              hd_prestart_policy_closed   (HdPrestartPolicy *policy,
+                                               const gchar *id,
+                                               gint64 now);
+void              hd_prestart_policy_set_size (HdPrestartPolicy *policy,
+                                               const gchar *id,
+                                               guint size_kb);
+guint             hd_prestart_policy_get_size (HdPrestartPolicy *policy,
+                                               const gchar *id);
+
+gdouble           hd_prestart_policy_frequency (HdPrestartPolicy *policy,
+                                                const gchar *id,
+                                                gint64 now);
+gdouble           hd_prestart_policy_score    (HdPrestartPolicy *policy,
+                                               const gchar *id,
+                                               gint64 now);
+
+G_END_DECLS
+
+#endif /* __HD_PRESTART_POLICY_H__ */
@@ -47,6 +47,7 @@
 #include "hd-util.h"
 #include "hd-dbus.h"
 #include "hd-volume-profile.h"
+#include "hd-stats.h"
 #include "launcher/hd-app-mgr.h"
 #include "home/hd-render-manager.h"
 #include "hd-transition.h"
@@ -875,6 +876,7 @@ main (int argc, char **argv)
   app_mgr = hd_app_mgr_get ();
 
   hd_volume_profile_init ();
+  hd_stats_init ();
 
   /* Check if orientation is locked to portrait or the device is in vertical position. */
   if (hd_orientation_lock_is_locked_to_portrait ()
@@ -43,6 +43,7 @@ static Atom scale_atom;
 static Atom anchor_atom;
 static Atom ready_atom;
 static Atom parent_atom;
+static Atom batch_atom;
 
 static gboolean atoms_initialized = 0;
 
@@ -53,31 +54,26 @@ hd_animation_actor_request_geometry (MBWindowManagerClient *client,
 				     MBGeometry            *new_geometry,
 				     MBWMClientReqGeomType  flags);
 
+/* Applies a batched message of @type to the actor of @data. */
 static void
-hd_animation_actor_client_message (XClientMessageEvent *xev, void *userdata)
+hd_animation_actor_apply (gpointer data, Atom type, const long *l)
 {
-  HdAnimationActor         *self = HD_ANIMATION_ACTOR (userdata);
+  HdAnimationActor         *self = HD_ANIMATION_ACTOR (data);
   MBWindowManagerClient    *client = MB_WM_CLIENT (self);
 
-  if (!client->window)
-  {
-      g_warning ("Stray client message: no window!\n");
+  if (!client->cm_client)
       return;
-  }
 
   MBWMCompMgrClutterClient *cclient = MB_WM_COMP_MGR_CLUTTER_CLIENT (client->cm_client);
   ClutterActor             *actor = mb_wm_comp_mgr_clutter_client_get_actor (cclient);
 
   if (!CLUTTER_IS_ACTOR(actor))
-  {
-      g_warning ("Stray client message: no actor!\n");
       return;
-  }
 
-  if (xev->message_type == show_atom)
+  if (type == show_atom)
   {
-      gboolean show = (gboolean) xev->data.l[0];
-      guint    opacity = (guint) xev->data.l[1] & 0xff;
+      gboolean show = (gboolean) l[0];
+      guint    opacity = (guint) l[1] & 0xff;
 
       CM_DEBUG ("AnimationActor %p: show(show=%d, opacity=%d)\n",
 	       	self, show, opacity);
@@ -92,24 +88,24 @@ hd_animation_actor_client_message (XClientMessageEvent *xev, void *userdata)
       clutter_actor_set_opacity (actor, opacity);
 
   }
-  else if (xev->message_type == position_atom)
+  else if (type == position_atom)
   {
-      gint x = (gint) xev->data.l[0];
-      gint y = (gint) xev->data.l[1];
-      gint depth = (gint) xev->data.l[2];
+      gint x = (gint) l[0];
+      gint y = (gint) l[1];
+      gint depth = (gint) l[2];
 
       CM_DEBUG ("AnimationActor %p: position(x=%d, y=%d, depth=%d)\n",
 	       	self, x, y, depth);
       clutter_actor_set_position (actor, x, y);
       clutter_actor_set_depth (actor, depth);
   }
-  else if (xev->message_type == rotation_atom)
+  else if (type == rotation_atom)
   {
-      guint  axis    = (guint)  xev->data.l[0];
-      gint32 degrees = (gint32) xev->data.l[1];
-      gint   x       = (gint)   xev->data.l[2];
-      gint   y       = (gint)   xev->data.l[3];
-      gint   z       = (gint)   xev->data.l[4];
+      guint  axis    = (guint)  l[0];
+      gint32 degrees = (gint32) l[1];
+      gint   x       = (gint)   l[2];
+      gint   y       = (gint)   l[3];
+      gint   z       = (gint)   l[4];
 
       CM_DEBUG ("AnimationActor %p: rotation(axis=%d, deg=%d, x=%d, y=%d, z=%d)\n",
                self, axis, degrees, x, y, z);
@@ -123,20 +119,20 @@ hd_animation_actor_client_message (XClientMessageEvent *xev, void *userdata)
 
       clutter_actor_set_rotation (actor, clutter_axis, degrees, x, y, z);
   }
-  else if (xev->message_type == scale_atom)
+  else if (type == scale_atom)
   {
-      gint32 x_scale = (gint32) xev->data.l[0];
-      gint32 y_scale = (gint32) xev->data.l[1];
+      gint32 x_scale = (gint32) l[0];
+      gint32 y_scale = (gint32) l[1];
 
       CM_DEBUG ("AnimationActor %p: scale(x_scale=%u, y_scale=%u)\n",
 	       self, x_scale, y_scale);
       clutter_actor_set_scale (actor, x_scale, y_scale);
   }
-  else if (xev->message_type == anchor_atom)
+  else if (type == anchor_atom)
   {
-      guint gravity = (guint) xev->data.l[0];
-      gint  x       = (gint)  xev->data.l[1];
-      gint  y       = (gint)  xev->data.l[2];
+      guint gravity = (guint) l[0];
+      gint  x       = (gint)  l[1];
+      gint  y       = (gint)  l[2];
 
       CM_DEBUG ("AnimationActor %p: anchor(gravity=%u, x=%d, y=%d)\n",
                self, gravity, x, y);
@@ -168,9 +164,33 @@ hd_animation_actor_client_message (XClientMessageEvent *xev, void *userdata)
 	      (actor, clutter_gravity);
       }
   }
-  else if (xev->message_type == parent_atom)
+}
+
+/* Handles a message of @type from the client of @self.  Returns whether
+ * it was understood. */
+static gboolean
+hd_animation_actor_handle_message (HdAnimationActor *self,
+                                   ClutterActor *actor,
+                                   Atom type, const long *l)
+{
+  MBWindowManagerClient    *client = MB_WM_CLIENT (self);
+
+  if (type == show_atom || type == position_atom
+      || type == scale_atom || type == anchor_atom)
+  {
+      hd_client_batch_add (&self->batch, type, 0, l);
+  }
+  else if (type == rotation_atom)
+  {
+      /* Rotations around different axes don't replace each other. */
+      hd_client_batch_add (&self->batch, type, (guint) l[0], l);
+  }
+  else if (type == parent_atom)
   {
-      Window win = (Window) xev->data.l[0];
+      /* Everything before it must be in place. */
+      hd_client_batch_flush (&self->batch);
+
+      Window win = (Window) l[0];
 
       CM_DEBUG ("AnimationActor %p: parent(win=%lu)\n",
                self, win);
@@ -215,6 +235,51 @@ hd_animation_actor_client_message (XClientMessageEvent *xev, void *userdata)
         clutter_actor_hide (actor);
   }
   else
+      return FALSE;
+
+  return TRUE;
+}
+
+static void
+hd_animation_actor_client_message (XClientMessageEvent *xev, void *userdata)
+{
+  HdAnimationActor         *self = HD_ANIMATION_ACTOR (userdata);
+  MBWindowManagerClient    *client = MB_WM_CLIENT (self);
+
+  if (!client->window)
+  {
+      g_warning ("Stray client message: no window!\n");
+      return;
+  }
+
+  MBWMCompMgrClutterClient *cclient = MB_WM_COMP_MGR_CLUTTER_CLIENT (client->cm_client);
+  ClutterActor             *actor = mb_wm_comp_mgr_clutter_client_get_actor (cclient);
+
+  if (!CLUTTER_IS_ACTOR(actor))
+  {
+      g_warning ("Stray client message: no actor!\n");
+      return;
+  }
+
+  if (xev->message_type == batch_atom)
+  {
+      long *messages;
+      guint i, n;
+
+      messages = hd_client_batch_read (client->wmref->xdpy,
+                                       client->window->xwindow,
+                                       batch_atom, &n);
+      CM_DEBUG ("AnimationActor %p: batch(n=%u)\n", self, n);
+      for (i = 0; i < n; i++)
+          hd_animation_actor_handle_message (self, actor,
+                                             (Atom) messages[i*6],
+                                             &messages[i*6+1]);
+      if (messages)
+          XFree (messages);
+  }
+  else if (!hd_animation_actor_handle_message (self, actor,
+                                               xev->message_type,
+                                               xev->data.l))
   {
       CM_DEBUG ("AnimationActor %p: UNKNOWN MESSAGE %lu (%lu,%lu,%lu,%lu,%lu)\n",
          self,
@@ -275,6 +340,8 @@ hd_animation_actor_realize (MBWindowManagerClient *client)
 	    (hmgr, HD_ATOM_HILDON_ANIMATION_CLIENT_MESSAGE_PARENT);
 	ready_atom = hd_comp_mgr_get_atom
 	    (hmgr, HD_ATOM_HILDON_ANIMATION_CLIENT_READY);
+	batch_atom = hd_comp_mgr_get_atom
+	    (hmgr, HD_ATOM_HILDON_ANIMATION_CLIENT_MESSAGE_BATCH);
 
 	atoms_initialized = 1;
     }
@@ -347,6 +414,10 @@ hd_animation_actor_destroy (MBWMObject *this)
                                                    ClientMessage,
                                                    self->client_message_handler_id);
     }
+
+    g_debug ("AnimationActor %p: %u messages in %u updates",
+             self, self->batch.n_messages, self->batch.n_flushes);
+    hd_client_batch_clear (&self->batch);
 }
 
 static int
@@ -361,6 +432,9 @@ hd_animation_actor_init (MBWMObject *this, va_list vap)
   if (!wm)
       return 0;
 
+  hd_client_batch_init (&HD_ANIMATION_ACTOR (this)->batch,
+                        hd_animation_actor_apply, this);
+
   geom.x = geom.y = 0;
   geom.width = win->geometry.width;
   geom.height = win->geometry.height;
@@ -27,6 +27,8 @@
 #include <matchbox/core/mb-wm.h>
 #include <matchbox/client-types/mb-wm-client-app.h>
 
+#include "hd-client-batch.h"
+
 typedef struct HdAnimationActor      HdAnimationActor;
 typedef struct HdAnimationActorClass HdAnimationActorClass;
 
@@ -43,6 +45,8 @@ struct HdAnimationActor
 
   unsigned long    client_message_handler_id;
   unsigned long    actor_destroy_handler_id;
+
+  HdClientBatch    batch;
 };
 
 struct HdAnimationActorClass
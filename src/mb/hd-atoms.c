@@ -64,6 +64,7 @@ hd_atoms_init (Display * xdpy, Atom * atoms)
     "_HILDON_ANIMATION_CLIENT_MESSAGE_ANCHOR",
     "_HILDON_ANIMATION_CLIENT_MESSAGE_PARENT",
     "_HILDON_ANIMATION_CLIENT_READY",
+    "_HILDON_ANIMATION_CLIENT_MESSAGE_BATCH",
 
     "_HILDON_TEXTURE_CLIENT_MESSAGE_SHM",
     "_HILDON_TEXTURE_CLIENT_MESSAGE_DAMAGE",
@@ -73,6 +74,10 @@ hd_atoms_init (Display * xdpy, Atom * atoms)
     "_HILDON_TEXTURE_CLIENT_MESSAGE_SCALE",
     "_HILDON_TEXTURE_CLIENT_MESSAGE_PARENT",
     "_HILDON_TEXTURE_CLIENT_READY",
+    "_HILDON_TEXTURE_CLIENT_MESSAGE_SHM_FD",
+    "_HILDON_TEXTURE_CLIENT_MESSAGE_SWAP",
+    "_HILDON_TEXTURE_CLIENT_MESSAGE_RELEASE",
+    "_HILDON_TEXTURE_CLIENT_MESSAGE_BATCH",
 
     "_HILDON_LOADING_SCREENSHOT",
 
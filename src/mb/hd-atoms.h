@@ -59,6 +59,7 @@ typedef enum HdAtoms
   HD_ATOM_HILDON_ANIMATION_CLIENT_MESSAGE_ANCHOR,
   HD_ATOM_HILDON_ANIMATION_CLIENT_MESSAGE_PARENT,
   HD_ATOM_HILDON_ANIMATION_CLIENT_READY,
+  HD_ATOM_HILDON_ANIMATION_CLIENT_MESSAGE_BATCH,
 
   HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_SHM,
   HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_DAMAGE,
@@ -68,6 +69,10 @@ typedef enum HdAtoms
   HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_SCALE,
   HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_PARENT,
   HD_ATOM_HILDON_TEXTURE_CLIENT_READY,
+  HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_SHM_FD,
+  HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_SWAP,
+  HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_RELEASE,
+  HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_BATCH,
 
   HD_ATOM_HILDON_LOADING_SCREENSHOT,
 
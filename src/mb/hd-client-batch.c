@@ -0,0 +1,145 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2009 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#include "hd-client-batch.h"
+#include "hd-util.h"
+#include "hd-stats.h"
+
+#include <X11/Xatom.h>
+#include <string.h>
+
+static gboolean
+hd_client_batch_flush_cb (gpointer data)
+{
+  HdClientBatch *batch = data;
+
+  batch->flush_id = 0;
+  hd_client_batch_flush (batch);
+  return FALSE;
+}
+
+void
+hd_client_batch_init (HdClientBatch *batch, HdClientBatchApplyFunc apply,
+                      gpointer user_data)
+{
+  memset (batch, 0, sizeof (*batch));
+  batch->apply = apply;
+  batch->user_data = user_data;
+}
+
+/* Drops the pending messages, eg. because the client is going away. */
+void
+hd_client_batch_clear (HdClientBatch *batch)
+{
+  if (batch->flush_id)
+    {
+      g_source_remove (batch->flush_id);
+      batch->flush_id = 0;
+    }
+  batch->n = 0;
+}
+
+/* Queues a message of @type, replacing the pending one of the same
+ * @type and @key. */
+void
+hd_client_batch_add (HdClientBatch *batch, Atom type, guint key,
+                     const long *data)
+{
+  guint i;
+
+  batch->n_messages++;
+  hd_stats_count (HD_STATS_ACTOR_MESSAGES);
+
+  for (i = 0; i < batch->n; i++)
+    if (batch->types[i] == type && batch->keys[i] == key)
+      break;
+  if (i < batch->n)
+    { /* Move it to the end to keep the order of arrival. */
+      memmove (&batch->types[i], &batch->types[i+1],
+               (batch->n - i - 1) * sizeof (batch->types[0]));
+      memmove (&batch->keys[i], &batch->keys[i+1],
+               (batch->n - i - 1) * sizeof (batch->keys[0]));
+      memmove (&batch->data[i], &batch->data[i+1],
+               (batch->n - i - 1) * sizeof (batch->data[0]));
+      batch->n--;
+    }
+  else if (batch->n == HD_CLIENT_BATCH_MAX)
+    /* Shouldn't happen with the kinds of messages we batch. */
+    hd_client_batch_flush (batch);
+
+  batch->types[batch->n] = type;
+  batch->keys[batch->n] = key;
+  memcpy (batch->data[batch->n], data, sizeof (batch->data[0]));
+  batch->n++;
+
+  /* Before Clutter's redraw. */
+  if (!batch->flush_id)
+    batch->flush_id = g_idle_add_full (G_PRIORITY_HIGH_IDLE,
+                                       hd_client_batch_flush_cb,
+                                       batch, NULL);
+}
+
+/* Applies the pending messages now, eg. before a message which can't be
+ * batched. */
+void
+hd_client_batch_flush (HdClientBatch *batch)
+{
+  guint i;
+
+  if (!batch->n)
+    return;
+
+  if (batch->flush_id)
+    {
+      g_source_remove (batch->flush_id);
+      batch->flush_id = 0;
+    }
+
+  for (i = 0; i < batch->n; i++)
+    batch->apply (batch->user_data, batch->types[i], batch->data[i]);
+  batch->n = 0;
+
+  batch->n_flushes++;
+  hd_stats_count (HD_STATS_ACTOR_UPDATES);
+}
+
+/* Returns the messages the client put in @prop of @xwin, six longs per
+ * message, to be XFree()d; or %NULL if there are none. */
+long *
+hd_client_batch_read (Display *xdpy, Window xwin, Atom prop,
+                      guint *n_messages)
+{
+  long *messages;
+  gint n_items;
+
+  messages = hd_util_get_win_prop_data_and_validate (xdpy, xwin, prop,
+                                                     XA_CARDINAL, 32, 0,
+                                                     &n_items);
+  if (messages && n_items < 6)
+    {
+      XFree (messages);
+      messages = NULL;
+    }
+
+  *n_messages = messages ? n_items / 6 : 0;
+  return messages;
+}
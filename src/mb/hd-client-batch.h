@@ -0,0 +1,74 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2009 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+/*
+ * Batching of the ClientMessages which animation actors and remote
+ * textures are driven with.  Instead of changing the actor right away,
+ * the last message of each kind is kept until just before the next frame,
+ * when they are applied together in the order they arrived.  Clients can
+ * also send a whole frame's worth of messages at once: they put them in
+ * a CARDINAL property of their window, each as the message type followed
+ * by its five data items, then send a single ClientMessage of the same
+ * type as the property.
+ */
+
+#ifndef _HAVE_HD_CLIENT_BATCH_H
+#define _HAVE_HD_CLIENT_BATCH_H
+
+#include <glib.h>
+#include <X11/Xlib.h>
+
+#define HD_CLIENT_BATCH_MAX 8
+
+/* Applies a message of @type with @data to @user_data. */
+typedef void (*HdClientBatchApplyFunc) (gpointer user_data, Atom type,
+                                        const long *data);
+
+typedef struct
+{
+  /* The pending messages, the oldest first.  @keys tell apart messages
+   * of the same type which don't replace each other. */
+  Atom    types[HD_CLIENT_BATCH_MAX];
+  guint   keys[HD_CLIENT_BATCH_MAX];
+  long    data[HD_CLIENT_BATCH_MAX][5];
+  guint   n;
+  guint   flush_id;
+
+  HdClientBatchApplyFunc apply;
+  gpointer               user_data;
+
+  /* Messages received and batches applied. */
+  guint   n_messages;
+  guint   n_flushes;
+} HdClientBatch;
+
+void   hd_client_batch_init     (HdClientBatch *batch,
+                                 HdClientBatchApplyFunc apply,
+                                 gpointer user_data);
+void   hd_client_batch_clear    (HdClientBatch *batch);
+void   hd_client_batch_add      (HdClientBatch *batch, Atom type, guint key,
+                                 const long *data);
+void   hd_client_batch_flush    (HdClientBatch *batch);
+long  *hd_client_batch_read     (Display *xdpy, Window xwin, Atom prop,
+                                 guint *n_messages);
+
+#endif
@@ -29,6 +29,7 @@
 #include "hd-dbus.h"
 #include "hd-atoms.h"
 #include "hd-util.h"
+#include "hd-stats.h"
 #include "hd-transition.h"
 #include "hd-wm.h"
 #include "hd-home-applet.h"
@@ -38,8 +39,10 @@
 #include "hd-animation-actor.h"
 #include "hd-render-manager.h"
 #include "hd-title-bar.h"
+#include "hd-clutter-cache.h"
 #include "hd-orientation-lock.h"
 #include "launcher/hd-app-mgr.h"
+#include "launcher/hd-launch-trace.h"
 #include "launcher/hd-launcher-editor.h"
 
 #include <matchbox/core/mb-wm.h>
@@ -54,6 +57,7 @@
 #include <clutter/x11/clutter-x11.h>
 
 #include "../tidy/tidy-blur-group.h"
+#include "../tidy/tidy-snapshot-effect.h"
 
 #include <dbus/dbus-glib-bindings.h>
 #include <mce/dbus-names.h>
@@ -123,6 +127,15 @@ struct HdCompMgrPrivate
 
   /* GConf client for orientation lock. */
   GConfClient* gconf_client;
+
+  /* Damage of TFP actors accumulated since the last frame, the actor
+   * (referenced) mapped to the ClutterGeometry of its damaged area. */
+  GHashTable            *damage;
+  /* Idle source flushing @damage before the stage is redrawn. */
+  guint                  damage_flush;
+  /* If more actors than this are damaged in a frame, just redraw
+   * the whole stage instead of working out each one's area. */
+  guint                  damage_max_actors;
 };
 
 /*
@@ -136,9 +149,18 @@ struct HdCompMgrClientPrivate
   guint                 hibernation_key;
   gboolean              can_hibernate : 1;
 
+  /* The WM_CLASS of the client once @class_hint_read,
+   * see hd_comp_mgr_client_get_class_hint(). */
+  gboolean              class_hint_read : 1;
+  gchar                *res_name, *res_class;
+
   gboolean              has_video_overlay;
 };
 
+static void hd_comp_mgr_client_get_class_hint (MBWindowManagerClient *c,
+                                               const gchar **res_name,
+                                               const gchar **res_class);
+
 extern gboolean hd_dbus_display_is_off;
 static guint portrait_freshness_counter;
 
@@ -146,6 +168,7 @@ HdRunningApp *hd_comp_mgr_client_get_app_key (HdCompMgrClient *client,
                                                HdCompMgr *hmgr);
 
 static void hd_comp_mgr_check_do_not_disturb_flag (HdCompMgr *hmgr);
+static void hd_comp_mgr_free_damage (gpointer area);
 
 static gboolean
 hd_comp_mgr_client_prefers_compositing (MBWindowManagerClient *c);
@@ -350,6 +373,8 @@ hd_comp_mgr_client_destroy (MBWMObject* obj)
       priv->app = NULL;
     }
 
+  g_free (priv->res_name);
+  g_free (priv->res_class);
   g_free (priv);
 }
 
@@ -579,6 +604,12 @@ hd_comp_mgr_init (MBWMObject *obj, va_list vap)
 			   g_direct_equal,
 			   NULL,
                (GDestroyNotify)mb_wm_object_unref);
+  priv->damage =
+    g_hash_table_new_full (g_direct_hash,
+                           g_direct_equal,
+                           g_object_unref,
+                           hd_comp_mgr_free_damage);
+  priv->damage_max_actors = hd_transition_get_int ("damage", "max_actors", 8);
 
   /* Be notified about all X window property changes around here. */
   priv->property_changed_cb_id = mb_wm_main_context_x_event_handler_add (
@@ -640,6 +671,10 @@ hd_comp_mgr_destroy (MBWMObject *obj)
 
   if (priv->stack_sync)
     g_source_remove (priv->stack_sync);
+  if (priv->damage_flush)
+    g_source_remove (priv->damage_flush);
+  if (priv->damage)
+    g_hash_table_destroy (priv->damage);
 }
 
 HdCompMgrClient *
@@ -686,6 +721,14 @@ hd_comp_mgr_client_property_changed (XPropertyEvent *event, HdCompMgr *hmgr)
 
   wm = MB_WM_COMP_MGR (hmgr)->wm;
 
+  if (event->atom == XA_WM_CLASS)
+    {
+      c = mb_wm_managed_client_from_xwindow (wm, event->window);
+      if (c && c->cm_client)
+        HD_COMP_MGR_CLIENT (c->cm_client)->priv->class_hint_read = FALSE;
+      return True;
+    }
+
   if (event->atom == wm->atoms[MBWM_ATOM_HILDON_LIVE_DESKTOP_BACKGROUND])
     {
       HdCompMgrPrivate *priv = hmgr->priv;
@@ -1413,17 +1456,131 @@ hd_comp_mgr_get_client_transient_for (MBWindowManagerClient *c)
     : NULL;
 }
 
+static void
+hd_comp_mgr_free_damage (gpointer area)
+{
+  g_slice_free (ClutterGeometry, area);
+}
+
+/* Works out whether @actor's damaged @area needs to be redrawn, and if so
+ * queues a redraw of it unless @full_redraw, in which case it's up to the
+ * caller to redraw the whole stage.  Returns whether anything needs to be
+ * redrawn. */
+static gboolean
+hd_comp_mgr_flush_actor_damage (ClutterActor *actor, ClutterGeometry *area,
+                                gboolean full_redraw)
+{
+  ClutterActor *parent;
+  ClutterActor *blurred = NULL;
+  ClutterActor *snapshot = NULL;
+  ClutterActor *actors_stage;
+  ClutterEffect *effect;
+
+  if (!clutter_actor_is_visible(actor))
+    return FALSE;
+
+  /* TFP textures are usually bundled into another group, and it is
+   * this group that sets visibility - so we must check it too */
+  parent = clutter_actor_get_parent(actor);
+  actors_stage = clutter_actor_get_stage(actor);
+  if (!actors_stage)
+    /* if it's not on stage, it's not visible */
+    return FALSE;
+
+  while (parent && parent != actors_stage)
+    {
+      if (!clutter_actor_is_visible(parent))
+        return FALSE;
+      /* if we're a child of a blur group, tell it what has changed,
+       * so it can re-blur just that part */
+      if (TIDY_IS_BLUR_GROUP(parent))
+        {
+          tidy_blur_group_add_damage(parent, actor, area);
+          /* ONLY redraw the blur group if the image is buffered ->
+           * we are actually blurred */
+          if (tidy_blur_group_source_buffered(parent))
+            blurred = parent;
+        }
+      /* if it's shown by a snapshot (a task switcher thumbnail),
+       * it will be refreshed when it's time, and only then redrawn */
+      if (!snapshot
+          && (effect = clutter_actor_get_effect(parent,
+                                           TIDY_SNAPSHOT_EFFECT_NAME))
+          && clutter_actor_meta_get_enabled(CLUTTER_ACTOR_META(effect)))
+        {
+          if (!tidy_snapshot_effect_damage(effect))
+            return FALSE;
+          snapshot = parent;
+        }
+      parent = clutter_actor_get_parent(parent);
+    }
+
+  /* The snapshot is scaled down, redraw all of it. */
+  if (snapshot && !blurred)
+    {
+      actor = snapshot;
+      area = NULL;
+    }
+
+  /* The blur spreads the damage around, so redraw the blurred group. */
+  if (blurred)
+    {
+      actor = blurred;
+      area = NULL;
+    }
+
+  /* Update the screen. This function checks for scaling/visibility and
+   * chooses the area to update accordingly */
+  if (!full_redraw)
+    hd_util_partial_redraw_if_possible(actor, area);
+  return TRUE;
+}
+
+/* Called once per frame, before the stage is redrawn, to turn the damage
+ * accumulated by hd_comp_mgr_texture_update_area() into redraws. */
+static gboolean
+hd_comp_mgr_flush_damage (HdCompMgr *hmgr)
+{
+  HdCompMgrPrivate *priv = hmgr->priv;
+  GHashTableIter iter;
+  gpointer actor, area;
+  gboolean full_redraw, redraw;
+  gint64 start;
+
+  start = hd_stats_now();
+  priv->damage_flush = 0;
+
+  full_redraw = g_hash_table_size (priv->damage) > priv->damage_max_actors;
+  redraw = FALSE;
+  g_hash_table_iter_init (&iter, priv->damage);
+  while (g_hash_table_iter_next (&iter, &actor, &area))
+    redraw |= hd_comp_mgr_flush_actor_damage (actor, area, full_redraw);
+  g_hash_table_remove_all (priv->damage);
+
+  if (full_redraw && redraw)
+    {
+      clutter_actor_queue_redraw (clutter_stage_get_default ());
+      hd_stats_count (HD_STATS_REDRAW_FULL);
+    }
+
+  hd_stats_add_time(HD_STATS_TEXTURE_UPDATE, start);
+  return FALSE;
+}
+
+/* "update-area" handler of TFP actors.  Applications can damage their
+ * windows many times per frame, so we only accumulate the damage here
+ * and deal with it once per frame in hd_comp_mgr_flush_damage(). */
 static void
 hd_comp_mgr_texture_update_area(HdCompMgr *hmgr,
                                 int x, int y, int width, int height,
                                 ClutterActor* actor)
 {
-  ClutterActor *parent;
-  gboolean blur_update = FALSE;
-  ClutterActor *actors_stage;
+  HdCompMgrPrivate *priv;
+  ClutterGeometry *area;
 
   if (!actor || !clutter_actor_is_visible(actor) || hmgr == 0)
     return;
+  priv = hmgr->priv;
 
   if (hd_dbus_display_is_off)
     {
@@ -1443,45 +1600,33 @@ hd_comp_mgr_texture_update_area(HdCompMgr *hmgr,
   if (hd_transition_rotate_ignore_damage())
     return;
 
-  /* TFP textures are usually bundled into another group, and it is
-   * this group that sets visibility - so we must check it too */
-  parent = clutter_actor_get_parent(actor);
-  actors_stage = clutter_actor_get_stage(actor);
-  if (!actors_stage)
-    /* if it's not on stage, it's not visible */
-    return;
-
-  while (parent && parent != actors_stage)
+  hd_stats_damage();
+  hd_launch_trace_damage(actor);
+  if ((area = g_hash_table_lookup (priv->damage, actor)) != NULL)
+    { /* Extend the pending @area to include this damage as well. */
+      gint x2 = MAX (area->x + (gint)area->width,  x + width);
+      gint y2 = MAX (area->y + (gint)area->height, y + height);
+
+      area->x = MIN (area->x, x);
+      area->y = MIN (area->y, y);
+      area->width  = x2 - area->x;
+      area->height = y2 - area->y;
+    }
+  else
     {
-      if (!clutter_actor_is_visible(parent))
-        return;
-      /* if we're a child of a blur group, tell it that it has changed */
-      if (TIDY_IS_BLUR_GROUP(parent))
-        {
-          /* we don't update blur on every change of
-           * an application now as it causes a flicker, so
-           * instead we just hint that next time we become
-           * unblurred, we need to recalculate. */
-          tidy_blur_group_hint_source_changed(parent);
-          /* ONLY set blur_update if the image is buffered ->
-           * we are actually blurred */
-          if (tidy_blur_group_source_buffered(parent))
-            blur_update = TRUE;
-        }
-      parent = clutter_actor_get_parent(parent);
+      area = g_slice_new (ClutterGeometry);
+      area->x = x;
+      area->y = y;
+      area->width = width;
+      area->height = height;
+      g_hash_table_insert (priv->damage, g_object_ref (actor), area);
     }
 
-  /* We no longer display changes that occur on blurred windows, so if
-   * this damage was actually on a blurred window, forget about it. */
-  if (blur_update)
-    return;
-
-  /* Update the screen. This function checks for scaling/visibility and
-   * chooses the area to update accordingly */
-  {
-    ClutterGeometry area = {x,y,width, height};
-    hd_util_partial_redraw_if_possible(actor, &area);
-  }
+  /* Flush before clutter's redraw (CLUTTER_PRIORITY_REDRAW) is run. */
+  if (!priv->damage_flush)
+    priv->damage_flush = g_idle_add_full (G_PRIORITY_HIGH_IDLE + 40,
+                                  (GSourceFunc)hd_comp_mgr_flush_damage,
+                                  hmgr, NULL);
 }
 
 /* Hook onto and X11 texture pixmap children of this actor */
@@ -1665,16 +1810,13 @@ hd_comp_mgr_is_non_composited (MBWindowManagerClient *client,
   if (!HD_APP (client)->non_composited_read)
     {
       /* check if the window is blacklisted */
-      XClassHint class_hint;
-      memset (&class_hint, 0, sizeof (XClassHint));
-      mb_wm_util_async_trap_x_errors (wm->xdpy);
-      ret = XGetClassHint (wm->xdpy, client->window->xwindow, &class_hint);
-      mb_wm_util_async_untrap_x_errors ();
+      const gchar *res_name, *res_class;
 
-      if (ret && class_hint.res_class)
+      hd_comp_mgr_client_get_class_hint (client, &res_name, &res_class);
+      if (res_class)
         {
-          if (!strcmp (class_hint.res_class, "Chessui") ||
-              !strcmp (class_hint.res_class, "Mahjong"))
+          if (!strcmp (res_class, "Chessui") ||
+              !strcmp (res_class, "Mahjong"))
             {
               /* g_printerr ("%s: mahjong or chess\n", __func__); */
               HD_APP (client)->non_composited_read = True;
@@ -1682,12 +1824,6 @@ hd_comp_mgr_is_non_composited (MBWindowManagerClient *client,
               HD_APP (client)->force_composited = True;
             }
         }
-
-      if (class_hint.res_class)
-        XFree (class_hint.res_class);
-
-      if (class_hint.res_name)
-        XFree (class_hint.res_name);
     }
 
   if (HD_APP (client)->force_composited)
@@ -2194,9 +2330,12 @@ hd_comp_mgr_map_notify (MBWMCompMgr *mgr, MBWindowManagerClient *c)
   actor = mb_wm_comp_mgr_clutter_client_get_actor (cclient);
 
   if (hclient->priv->app)
-    g_object_set_data (G_OBJECT (actor),
-           "HD-ApplicationId",
-           (gchar *)hd_running_app_get_id (hclient->priv->app));
+    {
+      g_object_set_data (G_OBJECT (actor),
+             "HD-ApplicationId",
+             (gchar *)hd_running_app_get_id (hclient->priv->app));
+      hd_launch_trace_mapped (hclient->priv->app, actor);
+    }
 
   hd_comp_mgr_hook_update_area(HD_COMP_MGR (mgr), actor);
 
@@ -3802,6 +3941,8 @@ hd_comp_mgr_dump_debug_info (const gchar *tag)
 
   dump_clutter_actor_tree (clutter_stage_get_default (), NULL);
   hd_app_mgr_dump_app_list (TRUE);
+  hd_clutter_cache_dump_debug_info ();
+  hd_stats_dump ();
 #endif
 }
 
@@ -3890,14 +4031,107 @@ hd_comp_mgr_update_applets_on_current_desktop_property (HdCompMgr *hmgr)
   mb_wm_util_async_untrap_x_errors ();
 }
 
+/* Returns the WM_CLASS hint of @c in *@res_name and *@res_class,
+ * either of which can be %NULL.  They're only fetched from the server
+ * the first time and after the property has changed.  The strings
+ * are owned by @c's #HdCompMgrClient. */
+static void
+hd_comp_mgr_client_get_class_hint (MBWindowManagerClient *c,
+                                   const gchar **res_name,
+                                   const gchar **res_class)
+{
+  HdCompMgrClientPrivate *priv;
+
+  *res_name = *res_class = NULL;
+  if (!c->cm_client)
+    return;
+
+  priv = HD_COMP_MGR_CLIENT (c->cm_client)->priv;
+  if (!priv->class_hint_read)
+    {
+      XClassHint class_hint;
+      Status ret;
+
+      g_free (priv->res_name);
+      g_free (priv->res_class);
+      priv->res_name = priv->res_class = NULL;
+
+      memset (&class_hint, 0, sizeof (XClassHint));
+      mb_wm_util_async_trap_x_errors (c->wmref->xdpy);
+      ret = XGetClassHint (c->wmref->xdpy, c->window->xwindow, &class_hint);
+      mb_wm_util_async_untrap_x_errors ();
+
+      if (ret && class_hint.res_class)
+        {
+          priv->res_name = g_strdup (class_hint.res_name);
+          priv->res_class = g_strdup (class_hint.res_class);
+        }
+
+      if (class_hint.res_class)
+        XFree (class_hint.res_class);
+      if (class_hint.res_name)
+        XFree (class_hint.res_name);
+
+      priv->class_hint_read = TRUE;
+    }
+
+  *res_name = priv->res_name;
+  *res_class = priv->res_class;
+}
+
+/* A list of window names in the "thp_tweaks" section of transitions.ini,
+ * parsed into a set when transitions.ini is (re)loaded. */
+typedef struct
+{
+  const gchar *key;
+  GHashTable  *names;
+  guint        generation;
+} HdCompMgrNameList;
+
+static HdCompMgrNameList hd_comp_mgr_whitelist = { "whitelist" };
+static HdCompMgrNameList hd_comp_mgr_blacklist = { "blacklist" };
+
+/* Returns whether @name is on @list. */
+static gboolean
+hd_comp_mgr_name_list_contains (HdCompMgrNameList *list, const gchar *name)
+{
+  guint generation;
+
+  if (!name)
+    return FALSE;
+
+  generation = hd_transition_get_generation ();
+  if (!list->names || list->generation != generation)
+    {
+      gchar *str, **names;
+      guint i;
+
+      if (list->names)
+        g_hash_table_remove_all (list->names);
+      else
+        list->names = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                             g_free, NULL);
+
+      str = hd_transition_get_string ("thp_tweaks", list->key, "");
+      names = g_strsplit_set (str, " \t,;", -1);
+      for (i = 0; names[i]; i++)
+        if (*names[i])
+          g_hash_table_insert (list->names, g_strdup (names[i]),
+                               GINT_TO_POINTER (TRUE));
+      g_strfreev (names);
+      g_free (str);
+
+      list->generation = generation;
+    }
+
+  return g_hash_table_lookup (list->names, name) != NULL;
+}
+
 gboolean
 hd_comp_mgr_is_whitelisted(MBWindowManager *wm, MBWindowManagerClient *c)
 {
-  gchar *whitelist;
-  XClassHint class_hint;
-  Status ret;
-  gchar *wname = NULL;
-  gboolean is_on_whitelist = FALSE;
+  const gchar *wname, *wclass;
+  gboolean is_on_whitelist;
 
   if ((!c) || !MB_WINDOW_MANAGER(wm) || c == wm->desktop)
     return FALSE;
@@ -3908,23 +4142,9 @@ hd_comp_mgr_is_whitelisted(MBWindowManager *wm, MBWindowManagerClient *c)
       return FALSE;
   }
 
-  whitelist = g_strdup(hd_transition_get_string("thp_tweaks", "whitelist", ""));
-  memset(&class_hint, 0, sizeof(XClassHint));
-  mb_wm_util_async_trap_x_errors (wm->xdpy);
-  ret = XGetClassHint (wm->xdpy, c->window->xwindow, &class_hint);
-  mb_wm_util_async_untrap_x_errors ();
-
-  if (ret && class_hint.res_class)
-    wname = g_strdup(class_hint.res_name);
-
-  if (class_hint.res_class)
-    XFree(class_hint.res_class);
-
-  if (class_hint.res_name)
-    XFree(class_hint.res_name);
-
-  if (g_strrstr(whitelist, wname))
-    is_on_whitelist = TRUE;
+  hd_comp_mgr_client_get_class_hint (c, &wname, &wclass);
+  is_on_whitelist = hd_comp_mgr_name_list_contains (&hd_comp_mgr_whitelist,
+                                                    wname);
 
   PORTRAIT ("Whitelist: WName %s; Supp: %d; Req: %d; SuppInh: %d, ReqInh: %d", wname, c->portrait_supported, c->portrait_requested, c->portrait_supported_inherited, c->portrait_requested_inherited);
 #ifdef DEBUG_WINDOWS
@@ -3932,19 +4152,13 @@ hd_comp_mgr_is_whitelisted(MBWindowManager *wm, MBWindowManagerClient *c)
       PORTRAIT("Whitelist: Parent Sup: %d Req: %d", c->transient_for->portrait_supported, c->transient_for->portrait_requested);
 #endif
 
-  g_free(whitelist);
-  g_free(wname);
-
   return is_on_whitelist;
 }
 
 gboolean
 hd_comp_mgr_is_blacklisted(MBWindowManager *wm, MBWindowManagerClient *c)
 {
-  gchar *blacklist;
-  XClassHint class_hint;
-  Status ret;
-  gchar *wname = NULL;
+  const gchar *wname, *wclass;
   gboolean blacklisted = FALSE;
   gboolean blacklisted_by_desktopfile = FALSE;
   gboolean forcerotation = hd_transition_get_int("thp_tweaks", "forcerotation", 0);
@@ -3952,27 +4166,16 @@ hd_comp_mgr_is_blacklisted(MBWindowManager *wm, MBWindowManagerClient *c)
   if ((!c) || !HD_IS_APP (c) || !MB_WINDOW_MANAGER(wm) || c == wm->desktop)
     return FALSE;
 
-  blacklist = g_strdup (hd_transition_get_string ("thp_tweaks", "blacklist", ""));
-  memset (&class_hint, 0, sizeof (XClassHint));
-  mb_wm_util_async_trap_x_errors (wm->xdpy);
-  ret = XGetClassHint (wm->xdpy, c->window->xwindow, &class_hint);
-  mb_wm_util_async_untrap_x_errors ();
-
-  if (ret && class_hint.res_class)
-    wname = g_strdup (class_hint.res_name);
+  hd_comp_mgr_client_get_class_hint (c, &wname, &wclass);
 
   /* Check, if X-CSSU-Force-Landscape=true. */
-  blacklisted_by_desktopfile = hd_comp_mgr_is_blacklisted_parse_desktop_file (wname, class_hint.res_class, c->window->pid);
-
-  if (class_hint.res_class)
-    XFree(class_hint.res_class);
-
-  if (class_hint.res_name)
-    XFree(class_hint.res_name);
+  blacklisted_by_desktopfile = hd_comp_mgr_is_blacklisted_parse_desktop_file (
+                                   (char *)wname, (char *)wclass,
+                                   c->window->pid);
 
   if (!blacklisted_by_desktopfile)
     {
-      if (g_strrstr(blacklist, wname))
+      if (hd_comp_mgr_name_list_contains (&hd_comp_mgr_blacklist, wname))
         blacklisted = TRUE;
 
       if (c->stacked_below && (wname == NULL))
@@ -3980,9 +4183,6 @@ hd_comp_mgr_is_blacklisted(MBWindowManager *wm, MBWindowManagerClient *c)
           blacklisted = TRUE;
     }
 
-  g_free (blacklist);
-  g_free (wname);
-
   if (blacklisted_by_desktopfile)
     return TRUE;
 
@@ -4024,35 +4224,13 @@ hd_comp_mgr_is_blacklisted_parse_desktop_file(char *res_name,
 gboolean
 hd_comp_mgr_is_callui_window (MBWindowManager *wm, MBWindowManagerClient *c)
 {
-  gchar *whitelist = "rtcom-call-ui";
-  XClassHint class_hint;
-  Status ret;
-  gchar *wname = NULL;
-  gboolean is_callui_window = FALSE;
+  const gchar *wname, *wclass;
 
   if ((!c) || !MB_WINDOW_MANAGER(wm) || c == wm->desktop)
     return FALSE;
 
-  memset(&class_hint, 0, sizeof(XClassHint));
-  mb_wm_util_async_trap_x_errors (wm->xdpy);
-  ret = XGetClassHint (wm->xdpy, c->window->xwindow, &class_hint);
-  mb_wm_util_async_untrap_x_errors ();
-
-  if (ret && class_hint.res_class)
-    wname = g_strdup(class_hint.res_name);
-
-  if (class_hint.res_class)
-    XFree(class_hint.res_class);
-
-  if (class_hint.res_name)
-    XFree(class_hint.res_name);
-
-  if (g_strrstr(whitelist, wname))
-    is_callui_window = TRUE;
-
-  g_free(wname);
-
-  return is_callui_window;
+  hd_comp_mgr_client_get_class_hint (c, &wname, &wclass);
+  return !g_strcmp0 (wname, "rtcom-call-ui");
 }
 
 gboolean
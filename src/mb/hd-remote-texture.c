@@ -28,8 +28,26 @@
 
 #include <sys/time.h>
 #include <sys/shm.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
 #include <time.h>
 
+/* Not exposed with our _XOPEN_SOURCE, but the kernel has had them since
+ * 3.17. */
+#ifndef F_GET_SEALS
+# define F_GET_SEALS    (1024 + 10)
+#endif
+#ifndef F_SEAL_SHRINK
+# define F_SEAL_SHRINK  0x0002
+#endif
+#ifndef O_CLOEXEC
+# define O_CLOEXEC      0
+#endif
+
 #define CLIENT_MESSAGE_DEBUG 0//1
 
 #if CLIENT_MESSAGE_DEBUG == 1
@@ -46,6 +64,10 @@ static guint32 offset_atom;
 static guint32 scale_atom;
 static guint32 parent_atom;
 static guint32 ready_atom;
+static guint32 shm_fd_atom;
+static guint32 swap_atom;
+static guint32 release_atom;
+static guint32 batch_atom;
 static gboolean atoms_initialized = 0;
 
 void
@@ -57,60 +79,33 @@ hd_remote_texture_request_geometry (MBWindowManagerClient *client,
 static void
 hd_remote_texture_set_shm(HdRemoteTexture *tex, key_t key,
                           guint width, guint height, guint bpp);
+static void
+hd_remote_texture_set_shm_fd(HdRemoteTexture *tex, pid_t pid, gint fd,
+                             guint width, guint height, guint bpp);
+static void
+hd_remote_texture_swap(HdRemoteTexture *tex, guint buffer,
+                       gint x, gint y, gint width, gint height);
 
-static Bool
-hd_remote_texture_client_message (XClientMessageEvent *xev, void *userdata)
+/* Applies a batched message of @type to the texture of @data. */
+static void
+hd_remote_texture_apply (gpointer data, Atom type, const long *l)
 {
-  HdRemoteTexture         *self = HD_REMOTE_TEXTURE (userdata);
+  HdRemoteTexture         *self = HD_REMOTE_TEXTURE (data);
   MBWindowManagerClient    *client = MB_WM_CLIENT (self);
 
-  if (!client->window)
-  {
-      g_warning ("Stray client message: no window!\n");
-      return False;
-  }
+  if (!client->cm_client || !self->texture)
+      return;
 
   MBWMCompMgrClutterClient *cclient = MB_WM_COMP_MGR_CLUTTER_CLIENT (client->cm_client);
   ClutterActor             *actor = mb_wm_comp_mgr_clutter_client_get_actor (cclient);
 
   if (!actor)
-  {
-      g_warning ("Stray client message: no actor!\n");
-      return False;
-  }
-
-  if (xev->message_type == shm_atom)
-    {
-        key_t shm_key = (key_t) xev->data.l[0];
-        guint shm_width = (guint) xev->data.l[1];
-        guint shm_height = (guint) xev->data.l[2];
-        guint shm_bpp = (guint) xev->data.l[3];
-
-        hd_remote_texture_set_shm(self, shm_key,
-            shm_width,
-            shm_height,
-            shm_bpp);
-
-        CM_DEBUG ("RemoteTexture %p: shm(key=%d, width=%d, height=%d, bpp=%d)\n",
-                  self, shm_key,
-                  shm_width, shm_height, shm_bpp);
-    }
-  else if (xev->message_type == damage_atom)
-    {
-        gint x = (gint) xev->data.l[0];
-        gint y = (gint) xev->data.l[1];
-        gint width = (gint) xev->data.l[2];
-        gint height = (gint) xev->data.l[3];
+      return;
 
-        CM_DEBUG ("RemoteTexture %p: "
-                  "damage(x=%d, y=%d, width=%d, height=%d)\n",
-                  self, x, y, width, height);
-        tidy_mem_texture_damage(self->texture, x, y, width, height);
-    }
-  else if (xev->message_type == show_atom)
+  if (type == show_atom)
   {
-      gboolean show = (gboolean) xev->data.l[0];
-      guint    opacity = (guint) xev->data.l[1] & 0xff;
+      gboolean show = (gboolean) l[0];
+      guint    opacity = (guint) l[1] & 0xff;
 
       CM_DEBUG ("RemoteTexture %p: show(show=%d, opacity=%d)\n",
 	       	self, show, opacity);
@@ -122,12 +117,12 @@ hd_remote_texture_client_message (XClientMessageEvent *xev, void *userdata)
       clutter_actor_set_opacity (CLUTTER_ACTOR(self->texture), opacity);
 
   }
-  else if (xev->message_type == position_atom)
+  else if (type == position_atom)
   {
-    gint x = (gint) xev->data.l[0];
-    gint y = (gint) xev->data.l[1];
-    gint width = (gint) xev->data.l[2];
-    gint height = (gint) xev->data.l[3];
+    gint x = (gint) l[0];
+    gint y = (gint) l[1];
+    gint width = (gint) l[2];
+    gint height = (gint) l[3];
 
     CM_DEBUG ("AnimationActor %p: position(x=%d, y=%d, width=%d, height=%d)\n",
                self, x, y, width, height);
@@ -138,28 +133,105 @@ hd_remote_texture_client_message (XClientMessageEvent *xev, void *userdata)
                            0, 0,
                            width, height);
   }
-  else if (xev->message_type == offset_atom)
+  else if (type == offset_atom)
     {
-        gint x =  xev->data.l[0];
-        gint y =  xev->data.l[1];
+        gint x =  l[0];
+        gint y =  l[1];
 
         CM_DEBUG ("RemoteTexture %p: position(x=%d, y=%d)\n",
                   self, x, y);
         tidy_mem_texture_set_offset(self->texture, x, y);
     }
-
-  else if (xev->message_type == scale_atom)
+  else if (type == scale_atom)
   {
-      guint x_scale =  xev->data.l[0];
-      guint y_scale =  xev->data.l[1];
+      guint x_scale =  l[0];
+      guint y_scale =  l[1];
 
       CM_DEBUG ("RemoteTexture %p: scale(x_scale=%u, y_scale=%u)\n",
                 self, x_scale, y_scale);
       tidy_mem_texture_set_scale(self->texture, x_scale, y_scale);
   }
-  else if (xev->message_type == parent_atom)
+}
+
+/* Handles a message of @type from the client of @self.  Returns whether
+ * it was understood.  Frames and damage are taken right away, so that
+ * buffers are released as soon as possible, but the geometry is only
+ * changed before the next paint. */
+static Bool
+hd_remote_texture_handle_message (HdRemoteTexture *self, ClutterActor *actor,
+                                  Atom type, const long *l)
+{
+  MBWindowManagerClient    *client = MB_WM_CLIENT (self);
+
+  if (type == shm_atom)
     {
-      Window win = (Window) xev->data.l[0];
+        key_t shm_key = (key_t) l[0];
+        guint shm_width = (guint) l[1];
+        guint shm_height = (guint) l[2];
+        guint shm_bpp = (guint) l[3];
+
+        hd_remote_texture_set_shm(self, shm_key,
+            shm_width,
+            shm_height,
+            shm_bpp);
+
+        CM_DEBUG ("RemoteTexture %p: shm(key=%d, width=%d, height=%d, bpp=%d)\n",
+                  self, shm_key,
+                  shm_width, shm_height, shm_bpp);
+    }
+  else if (type == shm_fd_atom)
+    {
+        gint fd = (gint) l[0];
+        guint shm_width = (guint) l[1];
+        guint shm_height = (guint) l[2];
+        guint shm_bpp = (guint) l[3];
+        pid_t pid = (pid_t) l[4];
+
+        hd_remote_texture_set_shm_fd(self, pid, fd,
+            shm_width,
+            shm_height,
+            shm_bpp);
+
+        CM_DEBUG ("RemoteTexture %p: shm_fd(pid=%d, fd=%d, width=%d, "
+                  "height=%d, bpp=%d)\n",
+                  self, pid, fd, shm_width, shm_height, shm_bpp);
+    }
+  else if (type == swap_atom)
+    {
+        guint buffer = (guint) l[0];
+        gint x = (gint) l[1];
+        gint y = (gint) l[2];
+        gint width = (gint) l[3];
+        gint height = (gint) l[4];
+
+        CM_DEBUG ("RemoteTexture %p: swap(buffer=%u, x=%d, y=%d, "
+                  "width=%d, height=%d)\n",
+                  self, buffer, x, y, width, height);
+        hd_remote_texture_swap(self, buffer, x, y, width, height);
+    }
+  else if (type == damage_atom)
+    {
+        gint x = (gint) l[0];
+        gint y = (gint) l[1];
+        gint width = (gint) l[2];
+        gint height = (gint) l[3];
+
+        CM_DEBUG ("RemoteTexture %p: "
+                  "damage(x=%d, y=%d, width=%d, height=%d)\n",
+                  self, x, y, width, height);
+        tidy_mem_texture_damage(self->texture, x, y, width, height);
+    }
+  else if (type == show_atom || type == position_atom
+           || type == offset_atom || type == scale_atom)
+    {
+      hd_client_batch_add (&self->batch, type, 0, l);
+    }
+  else if (type == parent_atom)
+    {
+      /* Everything before it must be in place. */
+      hd_client_batch_flush (&self->batch);
+
+      Window win = (Window) l[0];
 
       CM_DEBUG ("RemoteTexture %p: parent(win=%lu)\n",
                self, win);
@@ -210,6 +282,51 @@ hd_remote_texture_client_message (XClientMessageEvent *xev, void *userdata)
           clutter_actor_hide (actor);
   }
   else
+      return False;
+
+  return True;
+}
+
+static Bool
+hd_remote_texture_client_message (XClientMessageEvent *xev, void *userdata)
+{
+  HdRemoteTexture         *self = HD_REMOTE_TEXTURE (userdata);
+  MBWindowManagerClient    *client = MB_WM_CLIENT (self);
+
+  if (!client->window)
+  {
+      g_warning ("Stray client message: no window!\n");
+      return False;
+  }
+
+  MBWMCompMgrClutterClient *cclient = MB_WM_COMP_MGR_CLUTTER_CLIENT (client->cm_client);
+  ClutterActor             *actor = mb_wm_comp_mgr_clutter_client_get_actor (cclient);
+
+  if (!actor)
+  {
+      g_warning ("Stray client message: no actor!\n");
+      return False;
+  }
+
+  if (xev->message_type == batch_atom)
+    {
+      long *messages;
+      guint i, n;
+
+      messages = hd_client_batch_read (client->wmref->xdpy,
+                                       client->window->xwindow,
+                                       batch_atom, &n);
+      CM_DEBUG ("RemoteTexture %p: batch(n=%u)\n", self, n);
+      for (i = 0; i < n; i++)
+          hd_remote_texture_handle_message (self, actor,
+                                            (Atom) messages[i*6],
+                                            &messages[i*6+1]);
+      if (messages)
+          XFree (messages);
+    }
+  else if (!hd_remote_texture_handle_message (self, actor,
+                                              xev->message_type,
+                                              xev->data.l))
   {
       CM_DEBUG ("RemoteTexture %p: UNKNOWN MESSAGE %lu (%lu,%lu,%lu,%lu,%lu)\n",
 	       self,
@@ -272,6 +389,14 @@ hd_remote_texture_realize (MBWindowManagerClient *client)
 	    (hmgr, HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_PARENT);
 	ready_atom = hd_comp_mgr_get_atom
 	    (hmgr, HD_ATOM_HILDON_TEXTURE_CLIENT_READY);
+	shm_fd_atom = hd_comp_mgr_get_atom
+	    (hmgr, HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_SHM_FD);
+	swap_atom = hd_comp_mgr_get_atom
+	    (hmgr, HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_SWAP);
+	release_atom = hd_comp_mgr_get_atom
+	    (hmgr, HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_RELEASE);
+	batch_atom = hd_comp_mgr_get_atom
+	    (hmgr, HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_BATCH);
 
 	atoms_initialized = 1;
     }
@@ -345,6 +470,9 @@ hd_remote_texture_destroy (MBWMObject *this)
                                                  ClientMessage,
                                                  self->client_message_handler_id);
   }
+  g_debug ("RemoteTexture %p: %u messages in %u updates",
+           self, self->batch.n_messages, self->batch.n_flushes);
+  hd_client_batch_clear (&self->batch);
   /* unattach ourselves if we were attached */
   hd_remote_texture_set_shm(self, 0, 0, 0, 0);
   /* free our texture */
@@ -365,6 +493,7 @@ hd_remote_texture_init (MBWMObject *this, va_list vap)
       return 0;
 
   tex->texture = g_object_ref(tidy_mem_texture_new());
+  hd_client_batch_init (&tex->batch, hd_remote_texture_apply, tex);
 
   /* Animation actors are not reactive and, therefore, are input-transparent.
    * Since they are going to be moved around using clutter calls, X will know
@@ -459,6 +588,20 @@ hd_remote_texture_set_shm(HdRemoteTexture *tex, key_t key,
                           guint width, guint height, guint bpp)
 {
   int shm_id;
+  /* unmap the client's buffers */
+  if (tex->map_addr)
+    {
+      tidy_mem_texture_set_data(tex->texture,
+            0, 0, 0, 0);
+      munmap(tex->map_addr, tex->map_size);
+      tex->map_addr = 0;
+      tex->map_size = 0;
+      tex->map_buffers = 0;
+      tex->map_front = 0;
+      tex->shm_width = 0;
+      tex->shm_height = 0;
+      tex->shm_bpp = 0;
+    }
   /* un-attach this segment */
   if (tex->shm_addr)
     {
@@ -508,4 +651,148 @@ hd_remote_texture_set_shm(HdRemoteTexture *tex, key_t key,
       tex->shm_bpp);
 }
 
+/*
+ * Instead of a SysV segment the client can give us a memfd or POSIX shm
+ * file descriptor holding one or more frames of @width x @height, one
+ * after the other.  We can't be passed the descriptor over X, so we open
+ * it through /proc, which works as long as the client runs as our user.
+ *
+ * The frames are double-buffered.  We start showing the first frame,
+ * and the others are free for the client to draw into.  Once it's drawn
+ * a free frame, the client tells us to show it with a SWAP message,
+ * which damages the area that changed since the frame we were showing.
+ * From then on we only read the new frame, so the previous one is
+ * released to the client right away with a RELEASE message.  The frame
+ * being shown is never written to, so the damaged area is uploaded
+ * straight from it without tearing.
+ */
+static void
+hd_remote_texture_set_shm_fd(HdRemoteTexture *tex, pid_t pid, gint fd,
+                             guint width, guint height, guint bpp)
+{
+  MBWMClientWindow *win = MB_WM_CLIENT(tex)->window;
+  gchar *path;
+  gsize frame_size;
+  struct stat st;
+  void *addr;
+  int map_fd, seals;
+
+  /* un-attach whatever we had */
+  hd_remote_texture_set_shm(tex, 0, 0, 0, 0);
+
+  frame_size = (gsize)width * height * bpp;
+  if (!frame_size)
+    return;
+
+  /* Only map the client's own files, not anybody's it names. */
+  if (!win || pid <= 0 || win->pid != pid)
+    {
+      g_critical("%s: pid %d is not the owner of the window",
+                 __FUNCTION__, pid);
+      return;
+    }
 
+  /* Don't block on a FIFO or the like. */
+  path = g_strdup_printf("/proc/%d/fd/%d", pid, fd);
+  map_fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+  if (map_fd < 0)
+    {
+      g_critical("%s: %s: %s", __FUNCTION__, path, g_strerror(errno));
+      g_free(path);
+      return;
+    }
+  g_free(path);
+
+  if (fstat(map_fd, &st) < 0 || !S_ISREG(st.st_mode))
+    {
+      g_critical("%s: not a regular file", __FUNCTION__);
+      close(map_fd);
+      return;
+    }
+
+  /* If the client could shrink it under us, uploading the texture would
+   * crash on SIGBUS, so it must be a memfd sealed against that. */
+  seals = fcntl(map_fd, F_GET_SEALS);
+  if (seals < 0 || !(seals & F_SEAL_SHRINK))
+    {
+      g_critical("%s: buffer is not sealed against shrinking",
+                 __FUNCTION__);
+      close(map_fd);
+      return;
+    }
+
+  if ((gsize)st.st_size < frame_size)
+    {
+      g_critical("%s: buffer too small for %ux%ux%u",
+                 __FUNCTION__, width, height, bpp);
+      close(map_fd);
+      return;
+    }
+
+  tex->map_buffers = st.st_size / frame_size;
+  tex->map_size = tex->map_buffers * frame_size;
+  addr = mmap(NULL, tex->map_size, PROT_READ, MAP_SHARED, map_fd, 0);
+  close(map_fd);
+  if (addr == MAP_FAILED)
+    {
+      g_critical("%s: mmap: %s", __FUNCTION__, g_strerror(errno));
+      tex->map_buffers = 0;
+      tex->map_size = 0;
+      return;
+    }
+
+  tex->map_addr = addr;
+  tex->map_front = 0;
+  tex->shm_width = width;
+  tex->shm_height = height;
+  tex->shm_bpp = bpp;
+  tidy_mem_texture_set_data(tex->texture,
+      tex->map_addr,
+      tex->shm_width, tex->shm_height,
+      tex->shm_bpp);
+}
+
+/* Tells the client it can draw into @buffer again. */
+static void
+hd_remote_texture_release(HdRemoteTexture *tex, guint buffer)
+{
+  MBWindowManagerClient *client = MB_WM_CLIENT (tex);
+  MBWindowManager       *wm = client->wmref;
+  XClientMessageEvent    xev;
+
+  memset(&xev, 0, sizeof(xev));
+  xev.type = ClientMessage;
+  xev.window = client->window->xwindow;
+  xev.message_type = release_atom;
+  xev.format = 32;
+  xev.data.l[0] = buffer;
+
+  mb_wm_util_async_trap_x_errors (wm->xdpy);
+  XSendEvent (wm->xdpy, xev.window, False, NoEventMask, (XEvent *)&xev);
+  XFlush (wm->xdpy);
+  mb_wm_util_async_untrap_x_errors ();
+}
+
+static void
+hd_remote_texture_swap(HdRemoteTexture *tex, guint buffer,
+                       gint x, gint y, gint width, gint height)
+{
+  gsize frame_size;
+  guint old;
+
+  if (!tex->map_addr || buffer >= tex->map_buffers)
+    {
+      g_warning("%s: no buffer %u", __FUNCTION__, buffer);
+      return;
+    }
+
+  frame_size = (gsize)tex->shm_width * tex->shm_height * tex->shm_bpp;
+  old = tex->map_front;
+  tex->map_front = buffer;
+  tidy_mem_texture_swap_data(tex->texture,
+                             tex->map_addr + buffer * frame_size);
+  tidy_mem_texture_damage(tex->texture, x, y, width, height);
+
+  if (old != buffer)
+    hd_remote_texture_release(tex, old);
+}
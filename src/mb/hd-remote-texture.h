@@ -28,6 +28,8 @@
 #include <matchbox/client-types/mb-wm-client-app.h>
 #include <tidy/tidy-mem-texture.h>
 
+#include "hd-client-batch.h"
+
 typedef struct HdRemoteTexture      HdRemoteTexture;
 typedef struct HdRemoteTextureClass HdRemoteTextureClass;
 
@@ -49,6 +51,15 @@ struct HdRemoteTexture
   guint         shm_height;
   guint         shm_bpp;
   const guchar *shm_addr;
+
+  /* Frames mapped from a file descriptor of the client instead of
+   * @shm_key, and the one we're showing. */
+  guchar       *map_addr;
+  gsize         map_size;
+  guint         map_buffers;
+  guint         map_front;
+
+  HdClientBatch batch;
 };
 
 struct HdRemoteTextureClass
@@ -7,6 +7,9 @@
 #include "tidy-blur-effect.h"
 
 #include <string.h>
+#include <math.h>
+
+#include "util/hd-stats.h"
 
 #define TIDY_BLUR_EFFECT_CLASS(klass)        (G_TYPE_CHECK_CLASS_CAST ((klass), TIDY_TYPE_BLUR_EFFECT, TidyBlurEffectClass))
 #define TIDY_IS_BLUR_EFFECT_CLASS(klass)     (G_TYPE_CHECK_CLASS_TYPE ((klass), TIDY_TYPE_BLUR_EFFECT))
@@ -55,6 +58,32 @@ static const gchar *blur_glsl_texture_shader =
     "       texture2D (cogl_sampler, vec2(cogl_tex_coord0_in.x, cogl_tex_coord0_in.y)) * 0.5; \n"
     "cogl_texel = color;\n";
 
+/* Upsampling half of the dual filter: 4 diagonal taps half a texel away
+ * and 4 straight ones a texel away, see tidy_blur_effect_do_pyramid(). */
+static const gchar *blur_glsl_upsample_shader =
+    "MEDIUMP vec2 tex_coord_c = 2.0 * tex_coord_a - tex_coord;\n"
+    "MEDIUMP vec2 tex_coord_d = 2.0 * tex_coord_b - tex_coord;\n"
+    "LOWP vec4 color =\n"
+    "       texture2D (cogl_sampler, vec2(tex_coord_a.x, tex_coord_a.y)) * 0.166667 + \n"
+    "       texture2D (cogl_sampler, vec2(tex_coord_a.x, tex_coord_b.y)) * 0.166667 + \n"
+    "       texture2D (cogl_sampler, vec2(tex_coord_b.x, tex_coord_b.y)) * 0.166667 + \n"
+    "       texture2D (cogl_sampler, vec2(tex_coord_b.x, tex_coord_a.y)) * 0.166667 + \n"
+    "       texture2D (cogl_sampler, vec2(tex_coord_c.x, tex_coord.y)) * 0.083333 + \n"
+    "       texture2D (cogl_sampler, vec2(tex_coord_d.x, tex_coord.y)) * 0.083333 + \n"
+    "       texture2D (cogl_sampler, vec2(tex_coord.x, tex_coord_c.y)) * 0.083333 + \n"
+    "       texture2D (cogl_sampler, vec2(tex_coord.x, tex_coord_d.y)) * 0.083333; \n"
+    "cogl_texel = color;\n";
+
+/* The maximal number of levels in pyramid mode. */
+#define TIDY_BLUR_EFFECT_MAX_LEVELS 6
+
+/* If the damage needs more than this fraction of the blurred texture
+ * to be re-rendered we re-render all of it. */
+#define TIDY_BLUR_EFFECT_MAX_DAMAGE 0.5
+
+/* Damage made of more rectangles than this is re-blurred as a whole. */
+#define TIDY_BLUR_EFFECT_MAX_DAMAGE_RECTS 8
+
 struct _TidyBlurEffect
 {
   ClutterOffscreenEffect parent_instance;
@@ -75,6 +104,35 @@ struct _TidyBlurEffect
   CoglHandle fb[2];
   int fb_index;
 
+  /* Third texture tidy_blur_effect_update_damage() iterates with
+   * so as not to overwrite the blurred image outside the damage. */
+  CoglHandle scratch_tex;
+  CoglHandle scratch_fb;
+
+  /* In pyramid mode (pyramid_levels != 0) we don't use tex[] and fb[]
+   * but successively halved levels of pyramid_tex[], the first being
+   * half the size of the actor.  [0] are the downsampled and [1] the
+   * upsampled levels, so that every pass has a texture of its own
+   * which can be updated in part.  They are created when first needed.
+   * pyramid_depth is the number of levels used by the last blur. */
+  guint pyramid_levels;
+  guint pyramid_depth;
+  CoglHandle pyramid_tex[2][TIDY_BLUR_EFFECT_MAX_LEVELS];
+  CoglHandle pyramid_fb[2][TIDY_BLUR_EFFECT_MAX_LEVELS];
+  CoglPipeline *down_pipeline;
+  CoglPipeline *up_pipeline;
+  gint down_uniform;
+  gint up_uniform;
+
+  /* The area of the actor which has changed since it was blurred. */
+  cairo_region_t *damage;
+  /* What asked for tidy_blur_effect_queue_invalidate() since the last
+   * paint, or the effect itself if several things did. */
+  gconstpointer invalid_origin;
+  /* All the actors which asked for it, whose damage is only enough
+   * if they haven't moved. */
+  GPtrArray *redrawn;
+
   guint blur;
   guint current_blur;
   guint max_blur;
@@ -88,6 +146,7 @@ struct _TidyBlurEffectClass
 
   CoglPipeline *base_pipeline;
   CoglPipeline *shader_pipeline;
+  CoglPipeline *up_pipeline;
 };
 
 G_DEFINE_TYPE (TidyBlurEffect,
@@ -117,9 +176,48 @@ tidy_blur_effect_create_textures(ClutterOffscreenEffect *effect,
       clutter_offscreen_effect_create_texture (effect, width, height);
   self->fb[0] = cogl_offscreen_new_with_texture (self->tex[0]);
   self->fb[1] = cogl_offscreen_new_with_texture (self->tex[1]);
+
+  if (self->scratch_fb)
+    {
+      cogl_object_unref(self->scratch_fb);
+      cogl_object_unref(self->scratch_tex);
+      self->scratch_fb = NULL;
+      self->scratch_tex = NULL;
+    }
 }
 
 
+static void
+tidy_blur_effect_free_pyramid(TidyBlurEffect *self)
+{
+  guint chain, i;
+
+  for (chain = 0; chain < 2; chain++)
+    for (i = 0; i < TIDY_BLUR_EFFECT_MAX_LEVELS; i++)
+      if (self->pyramid_fb[chain][i])
+        {
+          cogl_object_unref(self->pyramid_fb[chain][i]);
+          cogl_object_unref(self->pyramid_tex[chain][i]);
+          self->pyramid_fb[chain][i] = NULL;
+          self->pyramid_tex[chain][i] = NULL;
+        }
+}
+
+/* Forgets about the blurred image, so it's rendered from scratch the next
+ * time we're painted. */
+static void
+tidy_blur_effect_reset(TidyBlurEffect *self)
+{
+  self->current_blur = 0;
+  self->max_blur = 0;
+  self->invalid_origin = NULL;
+  if (self->damage)
+    {
+      cairo_region_destroy(self->damage);
+      self->damage = NULL;
+    }
+}
+
 static gboolean
 tidy_blur_effect_pre_paint (ClutterEffect *effect)
 {
@@ -164,6 +262,8 @@ tidy_blur_effect_pre_paint (ClutterEffect *effect)
           tidy_blur_effect_create_textures(offscreen_effect,
                                                     tex_width / 2,
                                                     tex_height / 2);
+          tidy_blur_effect_free_pyramid(self);
+          tidy_blur_effect_reset(self);
           self->tex_width = tex_width;
           self->tex_height = tex_height;
 
@@ -180,9 +280,8 @@ tidy_blur_effect_pre_paint (ClutterEffect *effect)
       self->texture = texture;
       cogl_pipeline_set_layer_texture (self->pipeline, 0, texture);
 
-      self->current_blur = 0;
-      self->max_blur = 0;
-
+      /* We keep the blurred image between paints unless we're told
+       * the actor has changed. */
       return TRUE;
     }
   else
@@ -210,6 +309,312 @@ tidy_blur_effect_do_blur(ClutterOffscreenEffect *effect, gint steps)
     }
 }
 
+/* Returns how many levels of the pyramid to use for the current blur.
+ * Each level doubles the radius of the blur, while the same takes four
+ * times as many iterations of tidy_blur_effect_do_blur(). */
+static guint
+tidy_blur_effect_pyramid_depth(TidyBlurEffect *self)
+{
+  guint levels;
+
+  levels = (g_bit_storage(self->blur) + 1) / 2;
+  levels = MIN(levels, self->pyramid_levels);
+
+  /* Don't go below a pixel. */
+  while (levels > 1 && ((self->tex_width >> levels) < 1
+                         || (self->tex_height >> levels) < 1))
+    levels--;
+
+  return MAX(levels, 1);
+}
+
+/* Returns @area grown by @grow pixels in each direction, then scaled by
+ * @mul / @div rounding outwards and clipped to @width x @height. */
+static cairo_region_t *
+tidy_blur_effect_grow_region(const cairo_region_t *area, gint grow,
+                             gint mul, gint div, gint width, gint height)
+{
+  cairo_region_t *grown;
+  cairo_rectangle_int_t rect, bounds = { 0, 0, width, height };
+  gint i, n, x1, y1, x2, y2;
+
+  grown = cairo_region_create();
+  n = cairo_region_num_rectangles(area);
+  for (i = 0; i < n; i++)
+    {
+      cairo_region_get_rectangle(area, i, &rect);
+      x1 = floor((gdouble)(rect.x - grow) * mul / div);
+      y1 = floor((gdouble)(rect.y - grow) * mul / div);
+      x2 = ceil((gdouble)(rect.x + rect.width + grow) * mul / div);
+      y2 = ceil((gdouble)(rect.y + rect.height + grow) * mul / div);
+      rect.x = x1;
+      rect.y = y1;
+      rect.width = x2 - x1;
+      rect.height = y2 - y1;
+      cairo_region_union_rectangle(grown, &rect);
+    }
+  cairo_region_intersect_rectangle(grown, &bounds);
+
+  return grown;
+}
+
+/* Returns whether @area covers too much of @fb to bother rendering it
+ * in parts. */
+static gboolean
+tidy_blur_effect_region_too_big(const cairo_region_t *area, CoglHandle fb)
+{
+  cairo_rectangle_int_t rect;
+  gint i, n, covered;
+
+  n = cairo_region_num_rectangles(area);
+  for (i = covered = 0; i < n; i++)
+    {
+      cairo_region_get_rectangle(area, i, &rect);
+      covered += rect.width * rect.height;
+    }
+
+  return covered > TIDY_BLUR_EFFECT_MAX_DAMAGE
+                   * cogl_framebuffer_get_width (fb)
+                   * cogl_framebuffer_get_height (fb);
+}
+
+/* Renders @src into @fb with @pipeline.  If @uniform is not -1 it's set
+ * to half a texel of @src, which is how far the shader samples around
+ * each pixel.  Only the @area of @fb is rendered unless it's NULL. */
+static void
+tidy_blur_effect_pass(CoglHandle fb, CoglPipeline *pipeline,
+                      gint uniform, CoglHandle src,
+                      const cairo_region_t *area)
+{
+  cairo_rectangle_int_t rect;
+  gfloat w, h;
+  gint i, n;
+
+  if (uniform != -1)
+    {
+      gfloat halfpixel[2];
+
+      halfpixel[0] = 0.5f / cogl_texture_get_width (src);
+      halfpixel[1] = 0.5f / cogl_texture_get_height (src);
+      cogl_pipeline_set_uniform_float (pipeline, uniform,
+                                       2, /* n_components */
+                                       1, /* count */
+                                       halfpixel);
+    }
+  cogl_pipeline_set_layer_texture (pipeline, 0, src);
+
+  if (!area)
+    {
+      cogl_framebuffer_draw_rectangle (fb, pipeline, -1.0, 1.0, 1.0, -1.0);
+      return;
+    }
+
+  /* The same as above, but only the @area's part of it. */
+  w = cogl_framebuffer_get_width (fb);
+  h = cogl_framebuffer_get_height (fb);
+  n = cairo_region_num_rectangles(area);
+  for (i = 0; i < n; i++)
+    {
+      gfloat tx1, ty1, tx2, ty2;
+
+      cairo_region_get_rectangle(area, i, &rect);
+      tx1 = rect.x / w;
+      ty1 = rect.y / h;
+      tx2 = (rect.x + rect.width) / w;
+      ty2 = (rect.y + rect.height) / h;
+      cogl_framebuffer_draw_textured_rectangle (fb, pipeline,
+                                                tx1 * 2 - 1, 1 - ty1 * 2,
+                                                tx2 * 2 - 1, 1 - ty2 * 2,
+                                                tx1, ty1, tx2, ty2);
+    }
+}
+
+/* Returns the framebuffer of a level of the pyramid, creating it if
+ * needed.  @chain is 0 for the downsampled and 1 for the upsampled ones. */
+static CoglHandle
+tidy_blur_effect_get_pyramid_fb(TidyBlurEffect *self, guint chain,
+                                guint level)
+{
+  if (!self->pyramid_fb[chain][level])
+    {
+      self->pyramid_tex[chain][level] =
+        clutter_offscreen_effect_create_texture (
+                                   CLUTTER_OFFSCREEN_EFFECT (self),
+                                   MAX(self->tex_width >> (level + 1), 1),
+                                   MAX(self->tex_height >> (level + 1), 1));
+      self->pyramid_fb[chain][level] =
+        cogl_offscreen_new_with_texture (self->pyramid_tex[chain][level]);
+    }
+
+  return self->pyramid_fb[chain][level];
+}
+
+/* Returns the result of the last tidy_blur_effect_do_pyramid(). */
+static CoglHandle
+tidy_blur_effect_get_pyramid_result(TidyBlurEffect *self)
+{
+  return self->pyramid_depth > 1 ? self->pyramid_tex[1][0]
+                                 : self->pyramid_tex[0][0];
+}
+
+/* Dual filter blur: downsample the actor's texture level by level,
+ * filtering as we go, then upsample it back to half of its size.  This
+ * gives a much wider blur than tidy_blur_effect_do_blur() for the same
+ * number of passes, and most of them are on small textures.
+ *
+ * If @damage is not NULL only what it affects is re-rendered, which is
+ * the @damage plus the reach of the filter, growing with every pass.
+ * Since every pass has its own texture, the rest of them still holds
+ * the right image from the last time. */
+static void
+tidy_blur_effect_do_pyramid(TidyBlurEffect *self,
+                            const cairo_region_t *damage)
+{
+  cairo_region_t *area, *dst_area;
+  CoglHandle fb, src;
+  guint levels, i;
+
+  levels = tidy_blur_effect_pyramid_depth(self);
+  if (damage && levels != self->pyramid_depth)
+    damage = NULL;
+  self->pyramid_depth = levels;
+
+  area = damage ? cairo_region_copy(damage) : NULL;
+  src = self->texture;
+  for (i = 0; i < levels; i++)
+    {
+      fb = tidy_blur_effect_get_pyramid_fb(self, 0, i);
+      dst_area = NULL;
+      if (area)
+        { /* The filter reaches a texel of @src, and halves. */
+          dst_area = tidy_blur_effect_grow_region(area, 1, 1, 2,
+                                cogl_framebuffer_get_width (fb),
+                                cogl_framebuffer_get_height (fb));
+          cairo_region_destroy(area);
+          area = dst_area;
+        }
+
+      tidy_blur_effect_pass(fb, self->down_pipeline,
+                            self->down_uniform, src, dst_area);
+      src = self->pyramid_tex[0][i];
+    }
+
+  for (i = levels - 1; i > 0; i--)
+    {
+      fb = tidy_blur_effect_get_pyramid_fb(self, 1, i - 1);
+      dst_area = NULL;
+      if (area)
+        { /* The filter reaches two texels of @src, and doubles. */
+          dst_area = tidy_blur_effect_grow_region(area, 2, 2, 1,
+                                cogl_framebuffer_get_width (fb),
+                                cogl_framebuffer_get_height (fb));
+          cairo_region_destroy(area);
+          area = dst_area;
+        }
+
+      tidy_blur_effect_pass(fb, self->up_pipeline,
+                            self->up_uniform, src, dst_area);
+      src = self->pyramid_tex[1][i - 1];
+    }
+
+  if (area)
+    cairo_region_destroy(area);
+  hd_stats_count_n (HD_STATS_BLUR_PASSES, 2 * levels - 1);
+}
+
+/* Re-renders the part of the iterated blur affected by self->damage.
+ * Unlike the pyramid, the passes share two textures, one of which holds
+ * the result.  So we iterate with the other and a scratch texture, and
+ * the last pass writes the result.  Since the texture of a pass has
+ * been overwritten by another pass we can't use what's outside the
+ * damage there.  Instead every pass must re-render the area the
+ * following passes read, which is the area the blur changes grown by
+ * the reach of the passes still to go.  Returns FALSE if that would be
+ * too much. */
+static gboolean
+tidy_blur_effect_update_iterated(TidyBlurEffect *self)
+{
+  CoglHandle result, fbs[2], texs[2], src;
+  cairo_region_t *area;
+  guint steps, i;
+  gint width, height;
+
+  result = self->fb[(self->fb_index + 1) % 2];
+  width = cogl_framebuffer_get_width (result);
+  height = cogl_framebuffer_get_height (result);
+  steps = self->current_blur;
+
+  /* Every pass reaches a pixel of the half-size textures, that is two
+   * pixels of the actor, so the blur changes the damage grown by 2*steps
+   * and the first pass needs to render 2*(steps-1) more. */
+  area = tidy_blur_effect_grow_region(self->damage, 2 * (2 * steps - 1),
+                                      1, 2, width, height);
+  if (tidy_blur_effect_region_too_big(area, result))
+    {
+      cairo_region_destroy(area);
+      return FALSE;
+    }
+
+  if (!self->scratch_fb)
+    {
+      self->scratch_tex = clutter_offscreen_effect_create_texture (
+                                   CLUTTER_OFFSCREEN_EFFECT (self),
+                                   width, height);
+      self->scratch_fb = cogl_offscreen_new_with_texture (self->scratch_tex);
+    }
+  fbs[0] = self->fb[self->fb_index];
+  texs[0] = self->tex[self->fb_index];
+  fbs[1] = self->scratch_fb;
+  texs[1] = self->scratch_tex;
+
+  /* Like the first step of tidy_blur_effect_paint_target(). */
+  tidy_blur_effect_pass(steps > 1 ? fbs[0] : result, self->pipeline, -1,
+                        self->texture, area);
+  src = texs[0];
+  for (i = 1; i < steps; i++)
+    {
+      cairo_region_destroy(area);
+      area = tidy_blur_effect_grow_region(self->damage,
+                                          2 * (2 * steps - 1 - i),
+                                          1, 2, width, height);
+
+      tidy_blur_effect_pass(i < steps - 1 ? fbs[i % 2] : result,
+                            self->shader_pipeline, -1, src, area);
+      src = texs[i % 2];
+    }
+  cairo_region_destroy(area);
+
+  /* Let tidy_blur_effect_do_blur() carry on from the result. */
+  cogl_pipeline_set_layer_texture (self->shader_pipeline, 0,
+                                   self->tex[(self->fb_index + 1) % 2]);
+  hd_stats_count_n (HD_STATS_BLUR_PASSES, steps);
+
+  return TRUE;
+}
+
+/* Re-renders the part of the blurred image affected by self->damage.
+ * Returns FALSE if it's better to start over. */
+static gboolean
+tidy_blur_effect_update_damage(TidyBlurEffect *self)
+{
+  if (self->pyramid_levels)
+    {
+      CoglHandle fb = tidy_blur_effect_get_pyramid_fb(self, 0, 0);
+      cairo_region_t *area;
+
+      area = tidy_blur_effect_grow_region(self->damage, 0, 1, 2,
+                                          cogl_framebuffer_get_width (fb),
+                                          cogl_framebuffer_get_height (fb));
+      tidy_blur_effect_do_pyramid(self,
+                     tidy_blur_effect_region_too_big(area, fb)
+                     ? NULL : self->damage);
+      cairo_region_destroy(area);
+      return TRUE;
+    }
+  else
+    return tidy_blur_effect_update_iterated(self);
+}
+
 static void
 tidy_blur_effect_vignette(gfloat width, gfloat height, gint opacity,
                                 gfloat zoom)
@@ -284,6 +689,57 @@ tidy_blur_effect_vignette(gfloat width, gfloat height, gint opacity,
   cogl_polygon (vertices, 6, TRUE);
 }
 
+/* Returns whether any of the actors which queued a redraw since the last
+ * paint has moved, resized or been transformed within our actor, and
+ * forgets about them. */
+static gboolean
+tidy_blur_effect_check_moved(TidyBlurEffect *self)
+{
+  static GQuark quark;
+  gboolean moved;
+  guint i;
+
+  if (!self->redrawn)
+    return FALSE;
+  if (!quark)
+    quark = g_quark_from_static_string("tidy-blur-effect-box");
+
+  moved = FALSE;
+  for (i = 0; i < self->redrawn->len; i++)
+    {
+      ClutterActor *actor = self->redrawn->pdata[i];
+      ClutterVertex corners[4];
+      ClutterActorBox box, *last;
+      gfloat w, h;
+      gint j;
+
+      clutter_actor_get_size(actor, &w, &h);
+      corners[0].x = 0; corners[0].y = 0; corners[0].z = 0;
+      corners[1].x = w; corners[1].y = 0; corners[1].z = 0;
+      corners[2].x = 0; corners[2].y = h; corners[2].z = 0;
+      corners[3].x = w; corners[3].y = h; corners[3].z = 0;
+      for (j = 0; j < 4; j++)
+        clutter_actor_apply_relative_transform_to_point(actor, self->actor,
+                                                        &corners[j],
+                                                        &corners[j]);
+      clutter_actor_box_from_vertices(&box, corners);
+
+      /* We don't know where it was if we see it first. */
+      last = g_object_get_qdata(G_OBJECT(actor), quark);
+      if (!last || !clutter_actor_box_equal(last, &box))
+        {
+          moved = TRUE;
+          g_object_set_qdata_full(G_OBJECT(actor), quark,
+                                  clutter_actor_box_copy(&box),
+                                  (GDestroyNotify)clutter_actor_box_free);
+        }
+      g_object_unref(actor);
+    }
+  g_ptr_array_set_size(self->redrawn, 0);
+
+  return moved;
+}
+
 static void
 tidy_blur_effect_paint_target (ClutterOffscreenEffect *effect)
 {
@@ -293,11 +749,45 @@ tidy_blur_effect_paint_target (ClutterOffscreenEffect *effect)
   guint8 brigtness = opacity * self->brigtness;
   gfloat blur_opacity = 1.0f;
 
+  if (tidy_blur_effect_check_moved(self) || self->invalid_origin)
+    tidy_blur_effect_reset(self);
+
   if (self->blur)
     {
-      if (self->blur > self->max_blur)
+      if (self->damage)
+        {
+          gint64 start = hd_stats_now ();
+
+          /* We can only update the image we've finished blurring,
+           * not the one we're blurring in or out from. */
+          if (self->blur != self->max_blur
+              || !tidy_blur_effect_update_damage(self))
+            {
+              self->max_blur = 0;
+              self->current_blur = 0;
+            }
+          else
+            hd_stats_add_time (HD_STATS_BLUR, start);
+          cairo_region_destroy(self->damage);
+          self->damage = NULL;
+        }
+
+      if (self->blur > self->max_blur && self->pyramid_levels)
+        {
+          gint64 start = hd_stats_now ();
+
+          /* The pyramid is always rendered from scratch, but it's cheap. */
+          tidy_blur_effect_do_pyramid(self, NULL);
+          self->max_blur = self->blur;
+          self->current_blur = self->blur;
+          hd_stats_add_time (HD_STATS_BLUR, start);
+        }
+      else if (self->blur > self->max_blur)
         {
           guint steps = self->blur - self->current_blur;
+          gint64 start = hd_stats_now ();
+
+          hd_stats_count_n (HD_STATS_BLUR_PASSES, steps);
 
           if (!self->current_blur)
             {
@@ -316,6 +806,7 @@ tidy_blur_effect_paint_target (ClutterOffscreenEffect *effect)
           tidy_blur_effect_do_blur(effect, steps);
           self->max_blur = self->blur;
           self->current_blur = self->blur;
+          hd_stats_add_time (HD_STATS_BLUR, start);
         }
       else
         {
@@ -324,12 +815,14 @@ tidy_blur_effect_paint_target (ClutterOffscreenEffect *effect)
           blur_opacity = ((gfloat)(self->blur)) / ((gfloat)(self->max_blur));
         }
 
-      texture = self->tex[(self->fb_index + 1) % 2];
+      if (self->pyramid_levels)
+        texture = tidy_blur_effect_get_pyramid_result(self);
+      else
+        texture = self->tex[(self->fb_index + 1) % 2];
     }
   else
   {
-      self->max_blur = 0;
-      self->current_blur = 0;
+      tidy_blur_effect_reset(self);
       texture = self->texture;
   }
 
@@ -392,6 +885,13 @@ tidy_blur_effect_dispose (GObject *gobject)
 {
   TidyBlurEffect *self = TIDY_BLUR_EFFECT (gobject);
 
+  if (self->redrawn != NULL)
+    {
+      g_ptr_array_foreach (self->redrawn, (GFunc)g_object_unref, NULL);
+      g_ptr_array_free (self->redrawn, TRUE);
+      self->redrawn = NULL;
+    }
+
   if (self->pipeline != NULL)
     {
       cogl_object_unref (self->pipeline);
@@ -404,6 +904,29 @@ tidy_blur_effect_dispose (GObject *gobject)
       self->shader_pipeline = NULL;
     }
 
+  if (self->down_pipeline != NULL)
+    {
+      cogl_object_unref (self->down_pipeline);
+      self->down_pipeline = NULL;
+    }
+
+  if (self->up_pipeline != NULL)
+    {
+      cogl_object_unref (self->up_pipeline);
+      self->up_pipeline = NULL;
+    }
+
+  if (self->scratch_fb)
+    {
+      cogl_object_unref(self->scratch_fb);
+      cogl_object_unref(self->scratch_tex);
+      self->scratch_fb = NULL;
+      self->scratch_tex = NULL;
+    }
+
+  tidy_blur_effect_free_pyramid(self);
+  tidy_blur_effect_reset(self);
+
   if (self->fb[0])
     {
       cogl_object_unref(self->fb[0]);
@@ -437,6 +960,46 @@ tidy_blur_effect_class_init (TidyBlurEffectClass *klass)
   offscreen_class->paint_target = tidy_blur_effect_paint_target;
 }
 
+/* Creates a pipeline running @texture_shader on its only layer. */
+static CoglPipeline *
+tidy_blur_effect_create_shader_pipeline (CoglContext *ctx,
+                                         const gchar *texture_shader)
+{
+  CoglPipeline *pipeline;
+  CoglSnippet *snippet;
+
+  pipeline = cogl_pipeline_new (ctx);
+
+  /* vertex shader */
+  snippet = cogl_snippet_new (COGL_SNIPPET_HOOK_VERTEX,
+                              blur_glsl_vertex_declarations,
+                              blur_glsl_vertext_shader);
+  cogl_pipeline_add_snippet (pipeline, snippet);
+  cogl_object_unref (snippet);
+
+  /* texture lookup shader */
+  snippet = cogl_snippet_new (COGL_SNIPPET_HOOK_TEXTURE_LOOKUP,
+                              blur_glsl_texture_declarations,
+                              NULL);
+
+  cogl_snippet_set_replace (snippet, texture_shader);
+
+  cogl_pipeline_add_layer_snippet (pipeline, 0, snippet);
+  cogl_object_unref (snippet);
+
+  cogl_pipeline_set_layer_null_texture (pipeline,
+                                        0, /* layer number */
+                                        COGL_TEXTURE_TYPE_2D);
+  cogl_pipeline_set_layer_filters (pipeline,
+                                   0, /* layer_index */
+                                   COGL_PIPELINE_FILTER_LINEAR,
+                                   COGL_PIPELINE_FILTER_LINEAR);
+  cogl_pipeline_set_layer_wrap_mode (pipeline, 0,
+                                     COGL_PIPELINE_WRAP_MODE_MIRRORED_REPEAT);
+
+  return pipeline;
+}
+
 static void
 tidy_blur_effect_init (TidyBlurEffect *self)
 {
@@ -445,39 +1008,16 @@ tidy_blur_effect_init (TidyBlurEffect *self)
 
   if (G_UNLIKELY (klass->base_pipeline == NULL))
     {
-      CoglSnippet *snippet;
       CoglContext *ctx =
         clutter_backend_get_cogl_context (clutter_get_default_backend ());
 
-      /* pipeline with blur shaders */
-      klass->shader_pipeline = cogl_pipeline_new (ctx);
-
-      /* vertex shader */
-      snippet = cogl_snippet_new (COGL_SNIPPET_HOOK_VERTEX,
-                                  blur_glsl_vertex_declarations,
-                                  blur_glsl_vertext_shader);
-      cogl_pipeline_add_snippet (klass->shader_pipeline, snippet);
-      cogl_object_unref (snippet);
-
-      /* texture lookup shader */
-      snippet = cogl_snippet_new (COGL_SNIPPET_HOOK_TEXTURE_LOOKUP,
-                                  blur_glsl_texture_declarations,
-                                  NULL);
-
-      cogl_snippet_set_replace (snippet, blur_glsl_texture_shader);
-
-      cogl_pipeline_add_layer_snippet (klass->shader_pipeline, 0, snippet);
-      cogl_object_unref (snippet);
-
-      cogl_pipeline_set_layer_null_texture (klass->shader_pipeline,
-                                            0, /* layer number */
-                                            COGL_TEXTURE_TYPE_2D);
-      cogl_pipeline_set_layer_filters (klass->shader_pipeline,
-                                       0, /* layer_index */
-                                       COGL_PIPELINE_FILTER_LINEAR,
-                                       COGL_PIPELINE_FILTER_LINEAR);
-      cogl_pipeline_set_layer_wrap_mode (klass->shader_pipeline, 0,
-                                         COGL_PIPELINE_WRAP_MODE_MIRRORED_REPEAT);
+      /* pipelines with blur shaders */
+      klass->shader_pipeline =
+        tidy_blur_effect_create_shader_pipeline (ctx,
+                                                 blur_glsl_texture_shader);
+      klass->up_pipeline =
+        tidy_blur_effect_create_shader_pipeline (ctx,
+                                                 blur_glsl_upsample_shader);
 
       /* pipeline with no shaders */
       klass->base_pipeline = cogl_pipeline_new (ctx);
@@ -494,6 +1034,15 @@ tidy_blur_effect_init (TidyBlurEffect *self)
   self->blur_uniform =
       cogl_pipeline_get_uniform_location (self->shader_pipeline, "blur");
 
+  /* The downsampling half of the dual filter is the same 5 taps,
+   * but with a different offset per level. */
+  self->down_pipeline = cogl_pipeline_copy (klass->shader_pipeline);
+  self->down_uniform =
+      cogl_pipeline_get_uniform_location (self->down_pipeline, "blur");
+  self->up_pipeline = cogl_pipeline_copy (klass->up_pipeline);
+  self->up_uniform =
+      cogl_pipeline_get_uniform_location (self->up_pipeline, "blur");
+
   self->blur = 0;
   self->current_blur = 0;
   self->zoom = 1.0f;
@@ -523,6 +1072,116 @@ tidy_blur_effect_set_blur(ClutterEffect *effect, guint blur)
     }
 }
 
+/* Sets the maximal number of levels of the pyramid to use, or 0 to blur
+ * by iterating a full-size filter.  In pyramid mode the value given to
+ * tidy_blur_effect_set_blur() chooses how many of the levels are used. */
+void
+tidy_blur_effect_set_pyramid_levels(ClutterEffect *effect, guint levels)
+{
+  TidyBlurEffect *self;
+
+  if (!TIDY_IS_BLUR_EFFECT(effect))
+    return;
+
+  self = TIDY_BLUR_EFFECT(effect);
+  levels = MIN(levels, TIDY_BLUR_EFFECT_MAX_LEVELS);
+
+  if (self->pyramid_levels != levels)
+    {
+      self->pyramid_levels = levels;
+      /* Make paint_target() start over. */
+      tidy_blur_effect_reset(self);
+      tidy_blur_effect_free_pyramid(self);
+      clutter_effect_queue_repaint (effect);
+    }
+}
+
+guint
+tidy_blur_effect_get_pyramid_levels(ClutterEffect *self)
+{
+  if (!TIDY_IS_BLUR_EFFECT(self))
+      return 0;
+
+  return TIDY_BLUR_EFFECT(self)->pyramid_levels;
+}
+
+/* Tells the effect that the @area of its actor (in the actor's coordinates)
+ * has changed, so that only what it affects is re-blurred the next time
+ * the actor is painted.  It's up to the caller to queue that paint.
+ * @origin is what changed, and it cancels the pending
+ * tidy_blur_effect_queue_invalidate() of the same @origin, unless it
+ * turns out to have moved too by the time we're painted. */
+void
+tidy_blur_effect_add_damage(ClutterEffect *effect, ClutterActor *origin,
+                            const cairo_rectangle_int_t *area)
+{
+  TidyBlurEffect *self;
+
+  if (!TIDY_IS_BLUR_EFFECT(effect))
+    return;
+
+  self = TIDY_BLUR_EFFECT(effect);
+  if (origin && self->invalid_origin == origin)
+    self->invalid_origin = NULL;
+  if (!self->max_blur)
+    /* Nothing blurred yet, nothing to update. */
+    return;
+
+  if (!self->damage)
+    self->damage = cairo_region_create_rectangle(area);
+  else
+    {
+      cairo_region_union_rectangle(self->damage, area);
+      if (cairo_region_num_rectangles(self->damage)
+          > TIDY_BLUR_EFFECT_MAX_DAMAGE_RECTS)
+        {
+          cairo_rectangle_int_t extents;
+
+          cairo_region_get_extents(self->damage, &extents);
+          cairo_region_destroy(self->damage);
+          self->damage = cairo_region_create_rectangle(&extents);
+        }
+    }
+}
+
+/* Tells the effect that its actor has changed in some unknown way, so
+ * it needs to be re-blurred entirely. */
+void
+tidy_blur_effect_invalidate(ClutterEffect *effect)
+{
+  if (!TIDY_IS_BLUR_EFFECT(effect))
+    return;
+
+  tidy_blur_effect_reset(TIDY_BLUR_EFFECT(effect));
+}
+
+/* Like tidy_blur_effect_invalidate(), but only when the actor is painted
+ * next, unless the change of @origin turns out to be just damage reported
+ * with tidy_blur_effect_add_damage() by then.  Textures queue their redraw
+ * before their damage is known. */
+void
+tidy_blur_effect_queue_invalidate(ClutterEffect *effect, ClutterActor *origin)
+{
+  TidyBlurEffect *self;
+  guint i;
+
+  if (!TIDY_IS_BLUR_EFFECT(effect))
+    return;
+
+  self = TIDY_BLUR_EFFECT(effect);
+  if (!self->invalid_origin)
+    self->invalid_origin = origin;
+  else if (self->invalid_origin != origin)
+    self->invalid_origin = self;
+
+  if (!self->redrawn)
+    self->redrawn = g_ptr_array_new();
+  for (i = 0; i < self->redrawn->len; i++)
+    if (self->redrawn->pdata[i] == origin)
+      return;
+  g_ptr_array_add(self->redrawn, g_object_ref(origin));
+}
+
 guint
 tidy_blur_effect_get_blur(ClutterEffect *self)
 {
@@ -18,6 +18,13 @@ ClutterEffect *tidy_blur_effect_new (void);
 
 void tidy_blur_effect_set_blur(ClutterEffect *self, guint blur);
 guint tidy_blur_effect_get_blur(ClutterEffect *self);
+void tidy_blur_effect_set_pyramid_levels(ClutterEffect *self, guint levels);
+void tidy_blur_effect_add_damage(ClutterEffect *self, ClutterActor *origin,
+                                 const cairo_rectangle_int_t *area);
+void tidy_blur_effect_invalidate(ClutterEffect *self);
+void tidy_blur_effect_queue_invalidate(ClutterEffect *self,
+                                       ClutterActor *origin);
+guint tidy_blur_effect_get_pyramid_levels(ClutterEffect *self);
 void tidy_blur_effect_set_zoom(ClutterEffect *self, gfloat zoom);
 gfloat tidy_blur_effect_get_zoom(ClutterEffect *self);
 void tidy_blur_effect_set_brigtness(ClutterEffect *self, gfloat brigtness);
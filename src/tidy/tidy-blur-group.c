@@ -21,6 +21,7 @@
 
 #include <string.h>
 #include <locale.h>
+#include <math.h>
 
 #include "util/hd-transition.h"
 
@@ -142,6 +143,30 @@ tidy_blur_group_do_chequer(TidyBlurGroup *group, guint width, guint height)
   g_object_unref (pipeline);
 }
 
+/* Anything but damage reported by tidy_blur_group_add_damage() means
+ * the whole blurred image may be out of date.  Changes of our children
+ * (or their children) propagate here as a queued redraw, while the
+ * redraws we queue ourselves are just because of our own properties.
+ * A damaged texture queues its redraw before the damage is reported,
+ * so whether to re-blur everything is only decided at the next paint. */
+static void
+tidy_blur_group_queue_redraw (ClutterActor *actor, ClutterActor *origin)
+{
+  TidyBlurGroupPrivate *priv = TIDY_BLUR_GROUP(actor)->priv;
+
+  if (origin != actor && priv->blur_effect)
+    tidy_blur_effect_queue_invalidate(priv->blur_effect, origin);
+}
+
+static void
+tidy_blur_group_actor_removed (ClutterActor *actor, ClutterActor *child)
+{
+  TidyBlurGroupPrivate *priv = TIDY_BLUR_GROUP(actor)->priv;
+
+  if (priv->blur_effect)
+    tidy_blur_effect_invalidate(priv->blur_effect);
+}
+
 static void
 tidy_blur_group_dispose (GObject *gobject)
 {
@@ -212,10 +237,17 @@ tidy_blur_group_init (TidyBlurGroup *self)
     else
       {
         priv->blur_effect = tidy_blur_effect_new();
+        tidy_blur_effect_set_pyramid_levels(priv->blur_effect,
+                          hd_transition_get_int("blur", "pyramid_levels", 0));
         clutter_actor_add_effect_with_name (CLUTTER_ACTOR(self), "blur",
                                             priv->blur_effect);
       }
   }
+
+  g_signal_connect (self, "queue-redraw",
+                    G_CALLBACK (tidy_blur_group_queue_redraw), NULL);
+  g_signal_connect (self, "actor-removed",
+                    G_CALLBACK (tidy_blur_group_actor_removed), NULL);
 }
 
 /*
@@ -415,6 +447,8 @@ tidy_blur_group_set_source_changed(ClutterActor *blur_group)
     return;
 
   priv = TIDY_BLUR_GROUP(blur_group)->priv;
+  if (priv->blur_effect)
+    tidy_blur_effect_invalidate(priv->blur_effect);
   clutter_actor_queue_redraw(blur_group);
 }
 
@@ -431,9 +465,75 @@ tidy_blur_group_hint_source_changed(ClutterActor *blur_group)
 
   if (!TIDY_IS_SANE_BLUR_GROUP(blur_group))
     return;
-/*
+
   priv = TIDY_BLUR_GROUP(blur_group)->priv;
-  priv->source_changed = TRUE;*/
+  if (priv->blur_effect)
+    tidy_blur_effect_invalidate(priv->blur_effect);
+}
+
+/**
+ * tidy_blur_group_add_damage:
+ *
+ * Notifies the blur group that the @area of its descendant @source has
+ * changed, so that it only needs to re-blur what that affects.  If @area
+ * is %NULL or empty all of @source has changed.  The caller needs to
+ * queue a redraw of the blur group.
+ */
+void
+tidy_blur_group_add_damage(ClutterActor *blur_group, ClutterActor *source,
+                           const ClutterGeometry *area)
+{
+  TidyBlurGroupPrivate *priv;
+  ClutterVertex corners[4];
+  cairo_rectangle_int_t rect;
+  gfloat x1, y1, x2, y2, w, h;
+  gint i;
+
+  if (!TIDY_IS_SANE_BLUR_GROUP(blur_group))
+    return;
+
+  priv = TIDY_BLUR_GROUP(blur_group)->priv;
+  if (!priv->blur_effect)
+    return;
+
+  if (area && area->width && area->height)
+    {
+      x1 = area->x;
+      y1 = area->y;
+      x2 = area->x + area->width;
+      y2 = area->y + area->height;
+    }
+  else
+    {
+      clutter_actor_get_size(source, &w, &h);
+      x1 = y1 = 0;
+      x2 = w;
+      y2 = h;
+    }
+
+  corners[0].x = x1; corners[0].y = y1; corners[0].z = 0;
+  corners[1].x = x2; corners[1].y = y1; corners[1].z = 0;
+  corners[2].x = x1; corners[2].y = y2; corners[2].z = 0;
+  corners[3].x = x2; corners[3].y = y2; corners[3].z = 0;
+  for (i = 0; i < 4; i++)
+    clutter_actor_apply_relative_transform_to_point(source, blur_group,
+                                                    &corners[i], &corners[i]);
+
+  x1 = x2 = corners[0].x;
+  y1 = y2 = corners[0].y;
+  for (i = 1; i < 4; i++)
+    {
+      x1 = MIN(x1, corners[i].x);
+      y1 = MIN(y1, corners[i].y);
+      x2 = MAX(x2, corners[i].x);
+      y2 = MAX(y2, corners[i].y);
+    }
+
+  rect.x = floor(x1);
+  rect.y = floor(y1);
+  rect.width = ceil(x2) - rect.x;
+  rect.height = ceil(y2) - rect.y;
+  tidy_blur_effect_add_damage(priv->blur_effect, source, &rect);
 }
 
 void
@@ -12,6 +12,7 @@
 #include <clutter/clutter.h>
 
 #include <string.h>
+#include <math.h>
 #include "cogl/cogl.h"
 
 #define EXACT_ROW_LENGTH 0
@@ -63,9 +64,16 @@ struct _TidyMemTexturePrivate
   gfloat scale_x;
   gfloat scale_y;
 
-  GList *tiles; /* of TidyMemTextureTile */
+  /* tiles_x * tiles_y tiles, row by row */
+  TidyMemTextureTile *tiles;
+  gint tiles_x, tiles_y;
+  /* bit per tile, set if it has a modified area to upload */
+  guint32 *dirty;
+  gint n_dirty;
 };
 
+#define TILE_DIRTY(priv, i) ((priv)->dirty[(i) / 32] & (1u << ((i) % 32)))
+
 /* ------------------------------------------------------------------------- */
 
 static void
@@ -84,6 +92,11 @@ static gboolean
 tidy_mem_texture_tile_visible(TidyMemTexture *texture,
                               TidyMemTextureTile *tile,
                               gint width, gint height);
+static void
+tidy_mem_texture_visible_tiles(TidyMemTexture *texture,
+                               gint width, gint height,
+                               gint *x1, gint *y1,
+                               gint *x2, gint *y2);
 /* ------------------------------------------------------------------------- */
 
 static void
@@ -95,7 +108,7 @@ tidy_mem_texture_paint (ClutterActor *self)
   CoglColor                    col;
   ClutterActorBox box;
   gfloat                       width, height;
-  GList                       *tiles;
+  gint                         tx1, ty1, tx2, ty2, tx, ty;
 
   priv = TIDY_MEM_TEXTURE (self)->priv;
 
@@ -115,30 +128,37 @@ tidy_mem_texture_paint (ClutterActor *self)
   width = x_2 - x_1;
   height = y_2 - y_1;
 
+  /* only the tiles in this range can be visible */
+  tidy_mem_texture_visible_tiles(texture, width, height,
+                                 &tx1, &ty1, &tx2, &ty2);
+
   /* changetextures before we start our rendering pass */
-  for (tiles = priv->tiles; tiles; tiles = tiles->next)
-    {
-      TidyMemTextureTile *tile = tiles->data;
-      if (tidy_mem_texture_tile_visible(texture, tile, width, height))
-        {
-          /* we're visible, so update if modified, and render... */
-          if (tile->modified.width>0 && tile->modified.height>0)
-            tidy_mem_texture_update_modified(texture, tile);
-        }
-    }
-  /*next, do our rendering */
-  for (tiles = priv->tiles; tiles; tiles = tiles->next)
-    {
-      TidyMemTextureTile *tile = tiles->data;
-      if (tidy_mem_texture_tile_visible(texture, tile, width, height))
+  if (priv->n_dirty)
+    for (ty = ty1; ty <= ty2; ty++)
+      for (tx = tx1; tx <= tx2; tx++)
         {
-          gfloat x1,y1,x2,y2;
-          tidy_mem_texture_tile_coords(texture, tile, &x1, &y1, &x2, &y2);
-          cogl_set_source_texture (tile->texture);
-          cogl_rectangle_with_texture_coords (x1, y1, x2, y2,
-                                              0, 0, 1.0, 1.0);
+          gint i = ty * priv->tiles_x + tx;
+          if (TILE_DIRTY(priv, i) &&
+              tidy_mem_texture_tile_visible(texture, &priv->tiles[i],
+                                            width, height))
+            /* we're visible, so update if modified, and render... */
+            tidy_mem_texture_update_modified(texture, &priv->tiles[i]);
         }
-    }
+  /*next, do our rendering - the rectangles are batched up by Cogl's
+   * journal until it's flushed */
+  for (ty = ty1; ty <= ty2; ty++)
+    for (tx = tx1; tx <= tx2; tx++)
+      {
+        TidyMemTextureTile *tile = &priv->tiles[ty * priv->tiles_x + tx];
+        gfloat x1,y1,x2,y2;
+
+        if (!tidy_mem_texture_tile_visible(texture, tile, width, height))
+          continue;
+        tidy_mem_texture_tile_coords(texture, tile, &x1, &y1, &x2, &y2);
+        cogl_set_source_texture (tile->texture);
+        cogl_rectangle_with_texture_coords (x1, y1, x2, y2,
+                                            0, 0, 1.0, 1.0);
+      }
 }
 
 
@@ -192,6 +212,10 @@ tidy_mem_texture_init (TidyMemTexture *self)
   priv->scale_y = 1.0;
 
   priv->tiles = 0;
+  priv->tiles_x = 0;
+  priv->tiles_y = 0;
+  priv->dirty = 0;
+  priv->n_dirty = 0;
 }
 
 /**
@@ -222,15 +246,19 @@ tidy_mem_texture_free_data(TidyMemTexture *texture)
     return;
   priv = texture->priv;
 
-  while (priv->tiles)
+  if (priv->tiles)
     {
-      TidyMemTextureTile *tile = priv->tiles->data;
-      cogl_texture_unref(tile->texture);
-      g_free(tile);
-      priv->tiles = priv->tiles->next;
+      gint i;
+      for (i = 0; i < priv->tiles_x * priv->tiles_y; i++)
+        cogl_texture_unref(priv->tiles[i].texture);
+      g_free(priv->tiles);
+      priv->tiles = 0;
     }
-  g_list_free(priv->tiles);
-  priv->tiles = 0;
+  priv->tiles_x = 0;
+  priv->tiles_y = 0;
+  g_free(priv->dirty);
+  priv->dirty = 0;
+  priv->n_dirty = 0;
 
 #if EXACT_ROW_LENGTH
   if (priv->tile_buffer)
@@ -269,6 +297,35 @@ tidy_mem_texture_tile_visible(TidyMemTexture *texture,
           y1 <= height);
 }
 
+/* Returns the range of tiles which may be visible in an actor of
+ * @width x @height; it's empty if *@x1 > *@x2. */
+static void
+tidy_mem_texture_visible_tiles(TidyMemTexture *texture,
+                               gint width, gint height,
+                               gint *x1, gint *y1,
+                               gint *x2, gint *y2)
+{
+  TidyMemTexturePrivate *priv = texture->priv;
+
+  *x1 = *y1 = 0;
+  *x2 = priv->tiles_x - 1;
+  *y2 = priv->tiles_y - 1;
+
+  /* invert tidy_mem_texture_tile_coords(), conservatively */
+  if (priv->scale_x > 0)
+    {
+      *x1 = MAX(*x1, (gint)floorf(-priv->offset_x / TILE_SIZE_X) - 1);
+      *x2 = MIN(*x2, (gint)floorf((width / priv->scale_x - priv->offset_x)
+                                  / TILE_SIZE_X));
+    }
+  if (priv->scale_y > 0)
+    {
+      *y1 = MAX(*y1, (gint)floorf(-priv->offset_y / TILE_SIZE_Y) - 1);
+      *y2 = MIN(*y2, (gint)floorf((height / priv->scale_y - priv->offset_y)
+                                  / TILE_SIZE_Y));
+    }
+}
+
 /* Copies the pixels into a buffer with the correct row stride so
  * we can get the data into OpenGL quickly. */
 static void
@@ -277,6 +334,7 @@ tidy_mem_texture_update_modified(TidyMemTexture *texture,
 {
   TidyMemTexturePrivate *priv = texture->priv;
   gint rowstride = priv->texture_width * priv->texture_bpp;
+  gint i;
 #if EXACT_ROW_LENGTH
   gint y;
   gint rowlength = tile->modified.width * priv->texture_bpp;
@@ -315,6 +373,9 @@ tidy_mem_texture_update_modified(TidyMemTexture *texture,
 #endif
 
   /* set modified area to 0 */
+  i = tile - priv->tiles;
+  priv->dirty[i / 32] &= ~(1u << (i % 32));
+  priv->n_dirty--;
   tile->modified.x = 0;
   tile->modified.y = 0;
   tile->modified.width = 0;
@@ -364,12 +425,18 @@ void tidy_mem_texture_set_data(TidyMemTexture *texture,
       /* allocate tile buffer */
       priv->tile_buffer = g_malloc(TILE_SIZE_X * TILE_SIZE_Y * priv->texture_bpp);
 #endif
-      /* allocate tiles */
+      /* allocate tiles, all of them dirty */
+      priv->tiles_x = tiles_x;
+      priv->tiles_y = tiles_y;
+      priv->tiles = g_new(TidyMemTextureTile, tiles_x * tiles_y);
+      priv->dirty = g_new0(guint32, (tiles_x * tiles_y + 31) / 32);
+      priv->n_dirty = tiles_x * tiles_y;
       for (y=0;y<tiles_y;y++)
         for (x=0;x<tiles_x;x++)
           {
-            TidyMemTextureTile *tile = g_malloc(sizeof(TidyMemTextureTile));
-            priv->tiles = g_list_append(priv->tiles, tile);
+            TidyMemTextureTile *tile = &priv->tiles[y * tiles_x + x];
+            gint i = y * tiles_x + x;
+            priv->dirty[i / 32] |= 1u << (i % 32);
             /* set coords */
             tile->pos.x = x*TILE_SIZE_X;
             tile->pos.y = y*TILE_SIZE_Y;
@@ -402,75 +469,111 @@ void tidy_mem_texture_set_data(TidyMemTexture *texture,
     }
 }
 
+/* Makes @texture read its pixels from @data, which is laid out like the
+ * previous data, without reallocating the tiles.  Only the areas damaged
+ * afterwards are uploaded from @data. */
+void tidy_mem_texture_swap_data(TidyMemTexture *texture,
+                                const guchar *data)
+{
+  TidyMemTexturePrivate *priv;
+  if (!TIDY_IS_MEM_TEXTURE(texture))
+    return;
+  priv = texture->priv;
+
+  if (priv->texture_ptr && data)
+    priv->texture_ptr = data;
+}
+
 void tidy_mem_texture_damage(TidyMemTexture *texture,
                              gint x, gint y,
                              gint width, gint height)
 {
   TidyMemTexturePrivate *priv;
-  GList *tiles;
   gfloat actor_width, actor_height;
+  gint tx1, ty1, tx2, ty2, tx, ty;
   gboolean redraw = FALSE;
 
   if (!TIDY_IS_MEM_TEXTURE(texture))
     return;
   priv = texture->priv;
 
+  /* clip the damage to the texture */
+  if (x < 0)
+    {
+      width += x;
+      x = 0;
+    }
+  if (y < 0)
+    {
+      height += y;
+      y = 0;
+    }
+  if (x+width > priv->texture_width)
+    width = priv->texture_width - x;
+  if (y+height > priv->texture_height)
+    height = priv->texture_height - y;
+  if (width <= 0 || height <= 0 || !priv->tiles)
+    return;
+
   clutter_actor_get_size(CLUTTER_ACTOR(texture), &actor_width, &actor_height);
 
-  for (tiles = priv->tiles; tiles; tiles = tiles->next)
-    {
-      TidyMemTextureTile *tile = tiles->data;
+  /* only look at the tiles the damage touches */
+  tx1 = x / TILE_SIZE_X;
+  ty1 = y / TILE_SIZE_Y;
+  tx2 = (x+width-1) / TILE_SIZE_X;
+  ty2 = (y+height-1) / TILE_SIZE_Y;
+  for (ty = ty1; ty <= ty2; ty++)
+    for (tx = tx1; tx <= tx2; tx++)
+      {
+        gint i = ty * priv->tiles_x + tx;
+        TidyMemTextureTile *tile = &priv->tiles[i];
+        /* work out geometry of modified area */
+        ClutterGeometry mod;
+        mod.x = x - tile->pos.x;
+        mod.y = y - tile->pos.y;
+        if (mod.x < 0) mod.x = 0;
+        if (mod.y < 0) mod.y = 0;
+        mod.width = (x+width) - (tile->pos.x + mod.x);
+        mod.height = (y+height) - (tile->pos.y + mod.y);
+        if (mod.width+mod.x > tile->pos.width)
+          mod.width = tile->pos.width - mod.x;
+        if (mod.height+mod.y > tile->pos.height)
+          mod.height = tile->pos.height - mod.y;
+
+        if (TILE_DIRTY(priv, i))
+          {
+            /* if we already have damage, extend damaged area */
+            gint oldx2, oldy2, newx2, newy2;
+            oldx2 = tile->modified.x + tile->modified.width;
+            oldy2 = tile->modified.y + tile->modified.height;
+            newx2 = mod.x + mod.width;
+            newy2 = mod.y + mod.height;
+
+            if (mod.x < tile->modified.x)
+              tile->modified.x = mod.x;
+            if (mod.y < tile->modified.y)
+              tile->modified.y = mod.y;
+            if (newx2 > oldx2)
+              oldx2 = newx2;
+            if (newy2 > oldy2)
+              oldy2 = newy2;
+            tile->modified.width = oldx2 - tile->modified.x;
+            tile->modified.height = oldy2 - tile->modified.y;
+          }
+        else
+          {
+            /* else just set damaged area */
+            tile->modified = mod;
+            priv->dirty[i / 32] |= 1u << (i % 32);
+            priv->n_dirty++;
+          }
 
-      if (tile->pos.x <= x+width &&
-          tile->pos.y <= y+height &&
-          tile->pos.x+tile->pos.width >= x &&
-          tile->pos.y+tile->pos.height >= y)
-        {
-          /* work out geometry of modified area */
-          ClutterGeometry mod;
-          mod.x = x - tile->pos.x;
-          mod.y = y - tile->pos.y;
-          if (mod.x < 0) mod.x = 0;
-          if (mod.y < 0) mod.y = 0;
-          mod.width = (x+width) - (tile->pos.x + mod.x);
-          mod.height = (y+height) - (tile->pos.y + mod.y);
-          if (mod.width+mod.x > tile->pos.width)
-            mod.width = tile->pos.width - mod.x;
-          if (mod.height+mod.y > tile->pos.height)
-            mod.height = tile->pos.height - mod.y;
-
-          if (tile->modified.width>0 && tile->modified.height>0)
-            {
-              /* if we already have damage, extend damaged area */
-              gint oldx2, oldy2, newx2, newy2;
-              oldx2 = tile->modified.x + tile->modified.width;
-              oldy2 = tile->modified.y + tile->modified.height;
-              newx2 = mod.x + mod.width;
-              newy2 = mod.y + mod.height;
-
-              if (mod.x < tile->modified.x)
-                tile->modified.x = mod.x;
-              if (mod.y < tile->modified.y)
-                tile->modified.y = mod.y;
-              if (newx2 > oldx2)
-                oldx2 = newx2;
-              if (newy2 > oldy2)
-                oldy2 = newy2;
-              tile->modified.width = oldx2 - tile->modified.x;
-              tile->modified.height = oldy2 - tile->modified.y;
-            }
-          else
-            {
-              /* else just set damaged area */
-              tile->modified = mod;
-            }
-
-          /* only redraw if the changed tile is visible */
-          if (tidy_mem_texture_tile_visible(texture, tile,
-                                            actor_width, actor_height))
-            redraw = TRUE;
-        }
-    }
+        /* only redraw if the changed tile is visible */
+        if (!redraw &&
+            tidy_mem_texture_tile_visible(texture, tile,
+                                          actor_width, actor_height))
+          redraw = TRUE;
+      }
 
   if (redraw)
     clutter_actor_queue_redraw(CLUTTER_ACTOR(texture));
@@ -0,0 +1,356 @@
+/*
+ * TidySnapshotEffect renders its actor into a texture only as large as
+ * the actor appears on the stage, then paints that texture instead of
+ * the actor until it's damaged.  The texture covers the children of the
+ * actor in the actor's own coordinate space, so the actor can be moved
+ * around, eg. scrolled, without rendering it again.  Refreshes after
+ * damage are rate-limited to one per @interval milliseconds.
+ */
+
+#define CLUTTER_ENABLE_EXPERIMENTAL_API
+#define COGL_ENABLE_EXPERIMENTAL_API
+
+#include <clutter/clutter.h>
+#include <cogl/cogl.h>
+
+#include "tidy-snapshot-effect.h"
+
+#include <string.h>
+#include <math.h>
+
+struct _TidySnapshotEffect
+{
+  ClutterEffect parent_instance;
+
+  /* The snapshot and what it shows of the actor, in actor coordinates. */
+  CoglHandle texture;
+  CoglHandle fb;
+  CoglPipeline *pipeline;
+  ClutterActorBox box;
+
+  /* The paint opacity of the actor when the snapshot was taken. */
+  guint8 opacity;
+
+  /* Whether the snapshot is out of date, when it was last refreshed
+   * and the timeout to refresh it when @interval is over. */
+  gboolean dirty;
+  gint64 refreshed;
+  guint interval;
+  guint refresh_timeout;
+
+  gulong queue_redraw_cb_id;
+};
+
+struct _TidySnapshotEffectClass
+{
+  ClutterEffectClass parent_class;
+};
+
+G_DEFINE_TYPE (TidySnapshotEffect,
+               tidy_snapshot_effect,
+               CLUTTER_TYPE_EFFECT)
+
+static void
+tidy_snapshot_effect_free_texture (TidySnapshotEffect *self)
+{
+  if (self->fb)
+    {
+      cogl_object_unref (self->fb);
+      cogl_object_unref (self->texture);
+      self->fb = NULL;
+      self->texture = NULL;
+    }
+}
+
+static gboolean
+tidy_snapshot_effect_refresh_timeout (gpointer data)
+{
+  TidySnapshotEffect *self = TIDY_SNAPSHOT_EFFECT (data);
+  ClutterActor *actor;
+
+  self->refresh_timeout = 0;
+  actor = clutter_actor_meta_get_actor (CLUTTER_ACTOR_META (self));
+  if (actor && self->dirty)
+    clutter_actor_queue_redraw (actor);
+
+  return FALSE;
+}
+
+/* Returns whether the snapshot can be refreshed right now.  If not,
+ * makes sure the actor is redrawn when it can be. */
+static gboolean
+tidy_snapshot_effect_can_refresh (TidySnapshotEffect *self)
+{
+  gint64 remaining;
+
+  if (self->refresh_timeout)
+    return FALSE;
+
+  remaining = self->refreshed + (gint64)self->interval * 1000
+    - g_get_monotonic_time ();
+  if (remaining <= 0)
+    return TRUE;
+
+  self->refresh_timeout =
+    g_timeout_add ((remaining + 999) / 1000,
+                   tidy_snapshot_effect_refresh_timeout, self);
+  return FALSE;
+}
+
+/* The bounding box of the visible children of @actor in its coordinates.
+ * Returns FALSE if it's empty. */
+static gboolean
+tidy_snapshot_effect_get_box (ClutterActor *actor, ClutterActorBox *box)
+{
+  ClutterActor *child;
+  gboolean empty = TRUE;
+
+  for (child = clutter_actor_get_first_child (actor); child;
+       child = clutter_actor_get_next_sibling (child))
+    {
+      ClutterActorBox cbox;
+
+      if (!clutter_actor_is_visible (child))
+        continue;
+
+      clutter_actor_get_allocation_box (child, &cbox);
+      if (empty)
+        *box = cbox;
+      else
+        {
+          box->x1 = MIN (box->x1, cbox.x1);
+          box->y1 = MIN (box->y1, cbox.y1);
+          box->x2 = MAX (box->x2, cbox.x2);
+          box->y2 = MAX (box->y2, cbox.y2);
+        }
+      empty = FALSE;
+    }
+
+  return !empty && box->x2 > box->x1 && box->y2 > box->y1;
+}
+
+/* Renders the children of @actor in @box into a @width x @height
+ * snapshot. */
+static void
+tidy_snapshot_effect_refresh (TidySnapshotEffect *self, ClutterActor *actor,
+                              const ClutterActorBox *box,
+                              guint width, guint height, guint8 opacity)
+{
+  if (self->texture
+      && (cogl_texture_get_width (self->texture) != width
+          || cogl_texture_get_height (self->texture) != height))
+    tidy_snapshot_effect_free_texture (self);
+
+  if (!self->texture)
+    {
+      self->texture = cogl_texture_new_with_size (width, height,
+                                          COGL_TEXTURE_NO_SLICING,
+                                          COGL_PIXEL_FORMAT_RGBA_8888_PRE);
+      self->fb = cogl_offscreen_new_with_texture (self->texture);
+      cogl_pipeline_set_layer_texture (self->pipeline, 0, self->texture);
+    }
+
+  /* Map @box onto the whole texture. */
+  cogl_push_framebuffer (self->fb);
+  cogl_framebuffer_clear4f (self->fb, COGL_BUFFER_BIT_COLOR, 0, 0, 0, 0);
+  cogl_framebuffer_orthographic (self->fb, box->x1, box->y1,
+                                 box->x2, box->y2, -1000, 1000);
+  cogl_framebuffer_identity_matrix (self->fb);
+  clutter_actor_continue_paint (actor);
+  cogl_pop_framebuffer ();
+
+  self->box = *box;
+  self->opacity = opacity;
+  self->dirty = FALSE;
+  self->refreshed = g_get_monotonic_time ();
+}
+
+static void
+tidy_snapshot_effect_paint (ClutterEffect *effect,
+                            ClutterEffectPaintFlags flags)
+{
+  TidySnapshotEffect *self = TIDY_SNAPSHOT_EFFECT (effect);
+  ClutterActor *actor;
+  ClutterActorBox box;
+  ClutterVertex corners[3], stage[3];
+  guint width, height, alpha, i;
+  guint8 opacity;
+
+  actor = clutter_actor_meta_get_actor (CLUTTER_ACTOR_META (effect));
+  if (!tidy_snapshot_effect_get_box (actor, &box))
+    {
+      clutter_actor_continue_paint (actor);
+      return;
+    }
+
+  /* Make the snapshot as large as @box appears on the stage,
+   * but don't magnify it. */
+  corners[0].x = box.x1; corners[0].y = box.y1;
+  corners[1].x = box.x2; corners[1].y = box.y1;
+  corners[2].x = box.x1; corners[2].y = box.y2;
+  for (i = 0; i < G_N_ELEMENTS (corners); i++)
+    {
+      corners[i].z = 0;
+      clutter_actor_apply_transform_to_point (actor, &corners[i], &stage[i]);
+    }
+  width  = ceilf (hypotf (stage[1].x - stage[0].x, stage[1].y - stage[0].y));
+  height = ceilf (hypotf (stage[2].x - stage[0].x, stage[2].y - stage[0].y));
+  width  = CLAMP (width,  1, ceilf (box.x2 - box.x1));
+  height = CLAMP (height, 1, ceilf (box.y2 - box.y1));
+
+  /* The opacity of the actor is baked into the snapshot.  If it has
+   * decreased since we can make up for it when painting, otherwise
+   * the snapshot needs to be refreshed right now. */
+  opacity = clutter_actor_get_paint_opacity (actor);
+  if (!self->texture || opacity > self->opacity)
+    tidy_snapshot_effect_refresh (self, actor, &box, width, height, opacity);
+  else
+    {
+      /* If the size has changed use the old snapshot until the end of
+       * the @interval.  It's probably being animated. */
+      if (cogl_texture_get_width (self->texture) != width
+          || cogl_texture_get_height (self->texture) != height
+          || memcmp (&box, &self->box, sizeof (box)))
+        self->dirty = TRUE;
+      if (self->dirty && tidy_snapshot_effect_can_refresh (self))
+        tidy_snapshot_effect_refresh (self, actor, &box,
+                                      width, height, opacity);
+    }
+
+  alpha = self->opacity ? 255 * opacity / self->opacity : 255;
+  cogl_pipeline_set_color4ub (self->pipeline, alpha, alpha, alpha, alpha);
+  cogl_framebuffer_draw_textured_rectangle (cogl_get_draw_framebuffer (),
+                                            self->pipeline,
+                                            self->box.x1, self->box.y1,
+                                            self->box.x2, self->box.y2,
+                                            0, 0, 1, 1);
+}
+
+/* "queue-redraw" handler of the actor: something has changed in it. */
+static void
+tidy_snapshot_effect_queue_redraw (ClutterActor *actor, ClutterActor *origin,
+                                   TidySnapshotEffect *self)
+{
+  /* Our own redraws don't mean damage. */
+  if (origin != actor)
+    self->dirty = TRUE;
+}
+
+static void
+tidy_snapshot_effect_set_actor (ClutterActorMeta *meta, ClutterActor *actor)
+{
+  TidySnapshotEffect *self = TIDY_SNAPSHOT_EFFECT (meta);
+  ClutterActor *old;
+
+  old = clutter_actor_meta_get_actor (meta);
+  if (old && self->queue_redraw_cb_id)
+    g_signal_handler_disconnect (old, self->queue_redraw_cb_id);
+  self->queue_redraw_cb_id = 0;
+
+  CLUTTER_ACTOR_META_CLASS (tidy_snapshot_effect_parent_class)->set_actor (
+                                                                 meta, actor);
+
+  if (actor)
+    self->queue_redraw_cb_id =
+      g_signal_connect (actor, "queue-redraw",
+                        G_CALLBACK (tidy_snapshot_effect_queue_redraw), self);
+  tidy_snapshot_effect_invalidate (CLUTTER_EFFECT (self));
+}
+
+static void
+tidy_snapshot_effect_dispose (GObject *gobject)
+{
+  TidySnapshotEffect *self = TIDY_SNAPSHOT_EFFECT (gobject);
+
+  if (self->refresh_timeout)
+    {
+      g_source_remove (self->refresh_timeout);
+      self->refresh_timeout = 0;
+    }
+
+  tidy_snapshot_effect_free_texture (self);
+
+  if (self->pipeline)
+    {
+      cogl_object_unref (self->pipeline);
+      self->pipeline = NULL;
+    }
+
+  G_OBJECT_CLASS (tidy_snapshot_effect_parent_class)->dispose (gobject);
+}
+
+static void
+tidy_snapshot_effect_class_init (TidySnapshotEffectClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  ClutterActorMetaClass *meta_class = CLUTTER_ACTOR_META_CLASS (klass);
+  ClutterEffectClass *effect_class = CLUTTER_EFFECT_CLASS (klass);
+
+  gobject_class->dispose = tidy_snapshot_effect_dispose;
+  meta_class->set_actor = tidy_snapshot_effect_set_actor;
+  effect_class->paint = tidy_snapshot_effect_paint;
+}
+
+static void
+tidy_snapshot_effect_init (TidySnapshotEffect *self)
+{
+  CoglContext *ctx =
+    clutter_backend_get_cogl_context (clutter_get_default_backend ());
+
+  self->pipeline = cogl_pipeline_new (ctx);
+  cogl_pipeline_set_layer_null_texture (self->pipeline, 0,
+                                        COGL_TEXTURE_TYPE_2D);
+  cogl_pipeline_set_layer_filters (self->pipeline, 0,
+                                   COGL_PIPELINE_FILTER_LINEAR,
+                                   COGL_PIPELINE_FILTER_LINEAR);
+  self->dirty = TRUE;
+}
+
+/* Creates an effect which refreshes its snapshot
+ * at most once in @interval milliseconds. */
+ClutterEffect *
+tidy_snapshot_effect_new (guint interval)
+{
+  TidySnapshotEffect *self;
+
+  self = g_object_new (TIDY_TYPE_SNAPSHOT_EFFECT, NULL);
+  self->interval = interval;
+
+  return CLUTTER_EFFECT (self);
+}
+
+/* Tells the effect that the contents of its actor have changed in a way
+ * it couldn't notice (eg. a texture-from-pixmap was updated).  Returns
+ * whether the actor should be redrawn right away, otherwise it will be
+ * when the snapshot can be refreshed. */
+gboolean
+tidy_snapshot_effect_damage (ClutterEffect *effect)
+{
+  TidySnapshotEffect *self;
+
+  if (!TIDY_IS_SNAPSHOT_EFFECT (effect))
+    return TRUE;
+
+  self = TIDY_SNAPSHOT_EFFECT (effect);
+  self->dirty = TRUE;
+  return tidy_snapshot_effect_can_refresh (self);
+}
+
+/* Drops the snapshot, it's taken again when the actor is next painted. */
+void
+tidy_snapshot_effect_invalidate (ClutterEffect *effect)
+{
+  TidySnapshotEffect *self;
+
+  if (!TIDY_IS_SNAPSHOT_EFFECT (effect))
+    return;
+
+  self = TIDY_SNAPSHOT_EFFECT (effect);
+  if (self->refresh_timeout)
+    {
+      g_source_remove (self->refresh_timeout);
+      self->refresh_timeout = 0;
+    }
+  tidy_snapshot_effect_free_texture (self);
+  self->dirty = TRUE;
+}
@@ -0,0 +1,28 @@
+#ifndef TIDYSNAPSHOTEFFECT_H
+#define TIDYSNAPSHOTEFFECT_H
+
+#include <clutter/clutter.h>
+
+G_BEGIN_DECLS
+
+#define TIDY_TYPE_SNAPSHOT_EFFECT    (tidy_snapshot_effect_get_type ())
+#define TIDY_SNAPSHOT_EFFECT(obj)    (G_TYPE_CHECK_INSTANCE_CAST ((obj), TIDY_TYPE_SNAPSHOT_EFFECT, TidySnapshotEffect))
+#define TIDY_IS_SNAPSHOT_EFFECT(obj) (G_TYPE_CHECK_INSTANCE_TYPE ((obj), TIDY_TYPE_SNAPSHOT_EFFECT))
+
+/* The name the effect is added to actors with, so it can be found
+ * by clutter_actor_get_effect(). */
+#define TIDY_SNAPSHOT_EFFECT_NAME    "snapshot"
+
+typedef struct _TidySnapshotEffect       TidySnapshotEffect;
+typedef struct _TidySnapshotEffectClass  TidySnapshotEffectClass;
+
+GType tidy_snapshot_effect_get_type (void) G_GNUC_CONST;
+
+ClutterEffect *tidy_snapshot_effect_new (guint interval);
+
+gboolean tidy_snapshot_effect_damage(ClutterEffect *self);
+void tidy_snapshot_effect_invalidate(ClutterEffect *self);
+
+G_END_DECLS
+
+#endif /* TIDYSNAPSHOTEFFECT_H */
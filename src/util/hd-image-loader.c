@@ -0,0 +1,165 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2009 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "hd-image-loader.h"
+
+/* How many images may be decoded at the same time. */
+#define HD_IMAGE_LOADER_THREADS 2
+
+struct _HdImageLoaderJob
+{
+  gchar                    *fname;
+  HdImageLoaderPrepareFunc  prepare;
+  guint                     width, height;
+  gint                      priority;
+  HdImageLoaderDoneFunc     done;
+  gpointer                  user_data;
+
+  /* Set by hd_image_loader_cancel() in the main loop, checked by
+   * the worker thread to skip the work if it can. */
+  volatile gint             cancelled;
+
+  /* The results of the worker thread. */
+  GdkPixbuf                *pixbuf;
+  GError                   *error;
+};
+
+static GThreadPool *Pool;
+
+static void
+hd_image_loader_job_free (HdImageLoaderJob *job)
+{
+  if (job->pixbuf)
+    g_object_unref (job->pixbuf);
+  if (job->error)
+    g_error_free (job->error);
+  g_free (job->fname);
+  g_slice_free (HdImageLoaderJob, job);
+}
+
+/* Delivers the result of @job in the main loop. */
+static gboolean
+hd_image_loader_finish (gpointer data)
+{
+  HdImageLoaderJob *job = data;
+
+  if (!g_atomic_int_get (&job->cancelled))
+    job->done (job, job->pixbuf, job->error, job->user_data);
+  hd_image_loader_job_free (job);
+
+  return FALSE;
+}
+
+/* Runs on a worker thread. */
+static void
+hd_image_loader_work (gpointer data, gpointer unused)
+{
+  HdImageLoaderJob *job = data;
+
+  if (!g_atomic_int_get (&job->cancelled))
+    job->pixbuf = gdk_pixbuf_new_from_file (job->fname, &job->error);
+  if (job->pixbuf && job->prepare && !g_atomic_int_get (&job->cancelled))
+    job->pixbuf = job->prepare (job->pixbuf, job->width, job->height);
+
+  g_idle_add_full (job->priority, hd_image_loader_finish, job, NULL);
+}
+
+/* Starts loading @fname on a worker thread, then @prepare's it for
+ * @width x @height unless it's %NULL.  When it's done @done is called
+ * from an idle source of @priority.  Returns a handle to the job, which
+ * is valid until @done is called or it's cancelled. */
+HdImageLoaderJob *
+hd_image_loader_load (const gchar *fname,
+                      HdImageLoaderPrepareFunc prepare,
+                      guint width, guint height,
+                      gint priority,
+                      HdImageLoaderDoneFunc done,
+                      gpointer user_data)
+{
+  HdImageLoaderJob *job;
+  GError *error = NULL;
+
+  if (!Pool)
+    Pool = g_thread_pool_new (hd_image_loader_work, NULL,
+                              HD_IMAGE_LOADER_THREADS, FALSE, NULL);
+
+  job = g_slice_new0 (HdImageLoaderJob);
+  job->fname = g_strdup (fname);
+  job->prepare = prepare;
+  job->width = width;
+  job->height = height;
+  job->priority = priority;
+  job->done = done;
+  job->user_data = user_data;
+
+  /* Even if it couldn't start a new thread the job is queued, and
+   * it's run when a thread of the pool gets to it. */
+  g_thread_pool_push (Pool, job, &error);
+  if (error)
+    {
+      g_warning ("%s: %s", __FUNCTION__, error->message);
+      g_error_free (error);
+    }
+
+  return job;
+}
+
+/* Makes sure the done callback of @job won't be called, eg. because
+ * its user data is going away.  @job mustn't be used afterwards. */
+void
+hd_image_loader_cancel (HdImageLoaderJob *job)
+{
+  g_atomic_int_set (&job->cancelled, TRUE);
+}
+
+/* Uploads @pixbuf into a new #ClutterTexture.  Returns %NULL on failure. */
+ClutterActor *
+hd_image_loader_pixbuf_to_texture (GdkPixbuf *pixbuf, GError **error)
+{
+  ClutterActor *texture;
+
+  if (gdk_pixbuf_get_colorspace (pixbuf) != GDK_COLORSPACE_RGB
+      || gdk_pixbuf_get_bits_per_sample (pixbuf) != 8
+      || gdk_pixbuf_get_n_channels (pixbuf) !=
+         (gdk_pixbuf_get_has_alpha (pixbuf) ? 4 : 3))
+    {
+      g_set_error (error, GDK_PIXBUF_ERROR, GDK_PIXBUF_ERROR_UNKNOWN_TYPE,
+                   "image not in expected rgb/8bps format");
+      return NULL;
+    }
+
+  texture = clutter_texture_new ();
+  if (!clutter_texture_set_from_rgb_data (CLUTTER_TEXTURE (texture),
+                                          gdk_pixbuf_get_pixels (pixbuf),
+                                          gdk_pixbuf_get_has_alpha (pixbuf),
+                                          gdk_pixbuf_get_width (pixbuf),
+                                          gdk_pixbuf_get_height (pixbuf),
+                                          gdk_pixbuf_get_rowstride (pixbuf),
+                                          gdk_pixbuf_get_n_channels (pixbuf),
+                                          0, error))
+    {
+      g_object_ref_sink (texture);
+      g_object_unref (texture);
+      return NULL;
+    }
+
+  return texture;
+}
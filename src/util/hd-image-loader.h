@@ -0,0 +1,66 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2009 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * Decodes images on worker threads, so the main loop isn't blocked while
+ * large backgrounds or screenshots are loaded.  The decoded image can be
+ * transformed (eg. scaled) on the worker thread too, then it's handed
+ * over in the main loop, which only needs to upload it to a texture.
+ */
+
+#ifndef __HD_IMAGE_LOADER_H__
+#define __HD_IMAGE_LOADER_H__
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <clutter/clutter.h>
+
+G_BEGIN_DECLS
+
+typedef struct _HdImageLoaderJob HdImageLoaderJob;
+
+/* Called on a worker thread to transform a decoded @pixbuf to fit
+ * @width x @height in some way.  Returns the result, taking over
+ * @pixbuf; it can return @pixbuf itself.  Must be thread-safe. */
+typedef GdkPixbuf *(*HdImageLoaderPrepareFunc) (GdkPixbuf *pixbuf,
+                                                guint width, guint height);
+
+/* Called in the main loop with the loaded @pixbuf, or %NULL and @error
+ * if it couldn't be loaded.  @pixbuf is unref'd after the callback. */
+typedef void (*HdImageLoaderDoneFunc) (HdImageLoaderJob *job,
+                                       GdkPixbuf *pixbuf,
+                                       const GError *error,
+                                       gpointer user_data);
+
+HdImageLoaderJob *hd_image_loader_load (const gchar *fname,
+                                        HdImageLoaderPrepareFunc prepare,
+                                        guint width, guint height,
+                                        gint priority,
+                                        HdImageLoaderDoneFunc done,
+                                        gpointer user_data);
+void hd_image_loader_cancel (HdImageLoaderJob *job);
+
+ClutterActor *hd_image_loader_pixbuf_to_texture (GdkPixbuf *pixbuf,
+                                                 GError **error);
+
+G_END_DECLS
+
+#endif /* __HD_IMAGE_LOADER_H__ */
@@ -0,0 +1,266 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2009 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "hd-stats.h"
+
+#include <clutter/clutter.h>
+#include <string.h>
+
+/* Upper bounds of the histogram buckets in microseconds, the last one
+ * catching everything longer. */
+static const gint64 Bucket_limits[HD_STATS_HISTOGRAM_BUCKETS] =
+{
+      100,     200,     300,     500,     750,
+     1000,    1500,    2000,    3000,    4000,
+     5000,    6000,    8000,   10000,   12500,
+    15000,   17500,   20000,   25000,   30000,
+    35000,   40000,   50000,   60000,   80000,
+   100000,  150000,  200000,  300000,  500000,
+  1000000,  1500000,  2000000,  3000000,  5000000,
+  7500000, 10000000, 20000000, 30000000, G_MAXINT64,
+};
+
+static const gchar *Timer_names[HD_STATS_N_TIMERS] =
+{
+  "texture-update",
+  "restack",
+  "set-visibilities",
+  "blur",
+  "paint",
+  "frame",
+  "damage-latency",
+};
+
+static const gchar *Counter_names[HD_STATS_N_COUNTERS] =
+{
+  "redraw-full",
+  "redraw-clipped",
+  "blur-passes",
+  "restacked-actors",
+  "tweens",
+  "window-matches",
+  "launcher-matches",
+  "actor-messages",
+  "actor-updates",
+  "transition-lookups",
+  "transition-frame-lookups",
+  "state-changes",
+};
+
+static struct
+{
+  HdStatsHistogram timers[HD_STATS_N_TIMERS];
+  guint            counters[HD_STATS_N_COUNTERS];
+
+  /* When the statistics were last reset. */
+  gint64           since;
+  /* When the current paint started and when the previous one did. */
+  gint64           paint_start, last_paint_start;
+  /* When the first damage not yet painted arrived, or 0. */
+  gint64           first_damage;
+} Stats;
+
+void
+hd_stats_histogram_add (HdStatsHistogram *hist, gint64 usecs)
+{
+  guint lo, hi;
+
+  /* Binary search the first bucket which can hold @usecs. */
+  lo = 0;
+  hi = HD_STATS_HISTOGRAM_BUCKETS - 1;
+  while (lo < hi)
+    {
+      guint mid = (lo + hi) / 2;
+
+      if (usecs <= Bucket_limits[mid])
+        hi = mid;
+      else
+        lo = mid + 1;
+    }
+
+  hist->buckets[lo]++;
+  hist->n++;
+  hist->sum += usecs;
+  if (hist->max < usecs)
+    hist->max = usecs;
+}
+
+/* Returns the upper bound of the bucket where the @percent:th percentile
+ * of @hist falls into, or the maximum if that's less. */
+gint64
+hd_stats_histogram_percentile (const HdStatsHistogram *hist, guint percent)
+{
+  guint i, seen, wanted;
+
+  if (!hist->n)
+    return 0;
+
+  wanted = (hist->n * percent + 99) / 100;
+  for (i = seen = 0; i < HD_STATS_HISTOGRAM_BUCKETS - 1; i++)
+    if ((seen += hist->buckets[i]) >= wanted)
+      break;
+  return MIN (Bucket_limits[i], hist->max);
+}
+
+void
+hd_stats_histogram_print (GString *str, const gchar *name,
+                          const HdStatsHistogram *hist)
+{
+  g_string_append_printf (str,
+            "%s: n=%u avg=%lldus p50=%lldus p95=%lldus p99=%lldus "
+            "max=%lldus\n", name, hist->n,
+            hist->n ? (long long)(hist->sum / hist->n) : 0LL,
+            (long long)hd_stats_histogram_percentile (hist, 50),
+            (long long)hd_stats_histogram_percentile (hist, 95),
+            (long long)hd_stats_histogram_percentile (hist, 99),
+            (long long)hist->max);
+}
+
+gint64
+hd_stats_now (void)
+{
+  return g_get_monotonic_time ();
+}
+
+/* Adds the time elapsed @since to @timer. */
+void
+hd_stats_add_time (HdStatsTimer timer, gint64 since)
+{
+  hd_stats_histogram_add (&Stats.timers[timer], hd_stats_now () - since);
+}
+
+void
+hd_stats_count (HdStatsCounter counter)
+{
+  Stats.counters[counter]++;
+}
+
+void
+hd_stats_count_n (HdStatsCounter counter, guint n)
+{
+  Stats.counters[counter] += n;
+}
+
+guint
+hd_stats_get_count (HdStatsCounter counter)
+{
+  return Stats.counters[counter];
+}
+
+const HdStatsHistogram *
+hd_stats_get_timer (HdStatsTimer timer)
+{
+  return &Stats.timers[timer];
+}
+
+/* Called when something on the screen was damaged, to measure how long
+ * it takes until it's painted. */
+void
+hd_stats_damage (void)
+{
+  if (!Stats.first_damage)
+    Stats.first_damage = hd_stats_now ();
+}
+
+static void
+stage_paint_started (ClutterActor *stage)
+{
+  Stats.paint_start = hd_stats_now ();
+  if (Stats.last_paint_start)
+    hd_stats_histogram_add (&Stats.timers[HD_STATS_FRAME],
+                            Stats.paint_start - Stats.last_paint_start);
+  Stats.last_paint_start = Stats.paint_start;
+}
+
+static void
+stage_paint_finished (ClutterActor *stage)
+{
+  if (!Stats.paint_start)
+    return;
+
+  hd_stats_add_time (HD_STATS_PAINT, Stats.paint_start);
+  if (Stats.first_damage)
+    {
+      hd_stats_add_time (HD_STATS_DAMAGE_LATENCY, Stats.first_damage);
+      Stats.first_damage = 0;
+    }
+}
+
+/* Starts measuring the paints of the default stage. */
+void
+hd_stats_init (void)
+{
+  ClutterActor *stage = clutter_stage_get_default ();
+
+  Stats.since = hd_stats_now ();
+  g_signal_connect (stage, "paint", G_CALLBACK (stage_paint_started), NULL);
+  g_signal_connect_after (stage, "paint",
+                          G_CALLBACK (stage_paint_finished), NULL);
+}
+
+void
+hd_stats_reset (void)
+{
+  memset (Stats.timers, 0, sizeof (Stats.timers));
+  memset (Stats.counters, 0, sizeof (Stats.counters));
+  Stats.since = hd_stats_now ();
+  Stats.last_paint_start = 0;
+  Stats.first_damage = 0;
+}
+
+/* Returns the statistics since the last reset as human-readable text,
+ * one line per timer and counter. */
+gchar *
+hd_stats_to_string (void)
+{
+  GString *str;
+  gdouble secs;
+  guint i;
+
+  str = g_string_new (NULL);
+  secs = (hd_stats_now () - Stats.since) / 1000000.0;
+  g_string_append_printf (str, "period: %.1fs, redraws/s: %.1f\n", secs,
+                          secs > 0 ? Stats.timers[HD_STATS_PAINT].n / secs
+                                   : 0.0);
+  for (i = 0; i < HD_STATS_N_TIMERS; i++)
+    hd_stats_histogram_print (str, Timer_names[i], &Stats.timers[i]);
+  for (i = 0; i < HD_STATS_N_COUNTERS; i++)
+    g_string_append_printf (str, "%s: %u\n", Counter_names[i],
+                            Stats.counters[i]);
+
+  return g_string_free (str, FALSE);
+}
+
+void
+hd_stats_dump (void)
+{
+  gchar *str, **lines;
+  guint i;
+
+  str = hd_stats_to_string ();
+  lines = g_strsplit (str, "\n", 0);
+  g_debug ("%s:", __FUNCTION__);
+  for (i = 0; lines[i]; i++)
+    if (*lines[i])
+      g_debug ("  %s", lines[i]);
+  g_strfreev (lines);
+  g_free (str);
+}
@@ -0,0 +1,102 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2009 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * Cheap, always-on timing of the compositor's hot paths.  Code to be
+ * measured takes a timestamp with hd_stats_now() and reports the time
+ * spent with hd_stats_add_time(); events are counted with
+ * hd_stats_count().  Everything is aggregated into fixed-size histograms
+ * which can be printed with hd_stats_dump() (done on SIGUSR1) or fetched
+ * as text over D-Bus.
+ */
+
+#ifndef __HD_STATS_H__
+#define __HD_STATS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* What we measure the duration of. */
+typedef enum
+{
+  HD_STATS_TEXTURE_UPDATE,   /* hd_comp_mgr_texture_update_area() */
+  HD_STATS_RESTACK,          /* hd_render_manager_restack() */
+  HD_STATS_SET_VISIBILITIES, /* hd_render_manager_set_visibilities() */
+  HD_STATS_BLUR,             /* blur passes of TidyBlurEffect */
+  HD_STATS_PAINT,            /* painting the stage */
+  HD_STATS_FRAME,            /* time between the start of two paints */
+  HD_STATS_DAMAGE_LATENCY,   /* first damage to the end of the paint */
+  HD_STATS_N_TIMERS
+} HdStatsTimer;
+
+/* What we count. */
+typedef enum
+{
+  HD_STATS_REDRAW_FULL,      /* whole-stage redraws queued */
+  HD_STATS_REDRAW_CLIPPED,   /* clipped redraws queued */
+  HD_STATS_BLUR_PASSES,      /* blur shader passes rendered */
+  HD_STATS_RESTACKED_ACTORS, /* actors raised by restacks */
+  HD_STATS_TWEENS,           /* switcher effects advanced by a frame */
+  HD_STATS_WINDOW_MATCHES,   /* hd_app_mgr_match_window() calls */
+  HD_STATS_LAUNCHER_MATCHES, /* launchers compared with a window */
+  HD_STATS_ACTOR_MESSAGES,   /* batchable animation actor/remote texture
+                              * messages */
+  HD_STATS_ACTOR_UPDATES,    /* batches of them applied */
+  HD_STATS_TRANSITION_LOOKUPS, /* transitions.ini values looked up */
+  HD_STATS_TRANSITION_FRAME_LOOKUPS, /* of which by new-frame callbacks,
+                                      * which should be none */
+  HD_STATS_STATE_CHANGES,    /* hd_render_manager_set_state() changes */
+  HD_STATS_N_COUNTERS
+} HdStatsCounter;
+
+/* Histogram of durations in microseconds.  The buckets are 0.1-1ms wide
+ * up to 5ms, 1-10ms wide up to 60ms, where frame times fall, and then
+ * coarser up to 30s, plus one for anything longer. */
+#define HD_STATS_HISTOGRAM_BUCKETS 40
+typedef struct
+{
+  guint  buckets[HD_STATS_HISTOGRAM_BUCKETS];
+  guint  n;
+  gint64 sum, max;
+} HdStatsHistogram;
+
+void   hd_stats_histogram_add        (HdStatsHistogram *hist, gint64 usecs);
+gint64 hd_stats_histogram_percentile (const HdStatsHistogram *hist,
+                                      guint percent);
+void   hd_stats_histogram_print      (GString *str, const gchar *name,
+                                      const HdStatsHistogram *hist);
+
+void   hd_stats_init       (void);
+gint64 hd_stats_now        (void);
+void   hd_stats_add_time   (HdStatsTimer timer, gint64 since);
+void   hd_stats_count      (HdStatsCounter counter);
+void   hd_stats_count_n    (HdStatsCounter counter, guint n);
+void   hd_stats_damage     (void);
+guint  hd_stats_get_count  (HdStatsCounter counter);
+const HdStatsHistogram *hd_stats_get_timer (HdStatsTimer timer);
+void   hd_stats_reset      (void);
+gchar *hd_stats_to_string  (void);
+void   hd_stats_dump       (void);
+
+G_END_DECLS
+
+#endif /* __HD_STATS_H__ */
@@ -48,6 +48,7 @@
 #include "hd-volume-profile.h"
 #include "hd-util.h"
 #include "hd-dbus.h"
+#include "hd-stats.h"
 
 /* The master of puppets */
 #define TRANSITIONS_INI             "/usr/share/hildon-desktop/transitions.ini"
@@ -74,6 +75,10 @@ typedef struct _HDEffectData
   /* In Fade effects, final_alpha specifies the alpha value when the
    * window/note if fully faded in. */
   float                     final_alpha;
+  /* transitions.ini tweaks looked up when the effect starts, so that
+   * new-frame callbacks needn't. */
+  gboolean                  use_zaxis;
+  gboolean                  is_cool;
 } HDEffectData;
 
 /* %HPTimer %GSource state. */
@@ -175,6 +180,10 @@ static struct
    * necessary we stop waiting for damages immedeately.
    */
   guint patience_requests;
+
+  /* rotate::damage_timeout_max and damage_timeout_plus, looked up when
+   * we start waiting for damages rather than at every damage. */
+  gint damage_timeout_max, damage_timeout_plus;
 } Orientation_change;
 
 /* The number of transitions in progress requesting for @fixup_visibilities.
@@ -186,6 +195,11 @@ static guint Transitions_running;
  * and we can watch it. */
 static gboolean transitions_ini_is_dirty;
 
+/* The number of transition new-frame callbacks being run.  They're
+ * expected to have everything they need in their #HDEffectData, so
+ * hd_transition_lookup() complains if it's called meanwhile. */
+static guint In_new_frame;
+
 /* ------------------------------------------------------------------------- */
 /* ------------------------------------------------------------------------- */
 /* ------------------------------------------------------------------------- */
@@ -340,6 +354,33 @@ hd_transition_timeline_new(const gchar *transition,
       hd_transition_get_int(transition, key, default_length) );
 }
 
+static void
+hd_transition_frame_begin(ClutterTimeline *timeline, guint msecs,
+                          gpointer unused)
+{
+  In_new_frame++;
+}
+
+static void
+hd_transition_frame_end(ClutterTimeline *timeline, guint msecs,
+                        gpointer unused)
+{
+  In_new_frame--;
+}
+
+/* Connects @new_frame to the "new-frame" signal of @timeline, between
+ * handlers telling hd_transition_lookup() it's in a new-frame callback. */
+static void
+hd_transition_connect_new_frame(ClutterTimeline *timeline,
+                                GCallback new_frame, HDEffectData *data)
+{
+  g_signal_connect (timeline, "new-frame",
+                    G_CALLBACK (hd_transition_frame_begin), NULL);
+  g_signal_connect (timeline, "new-frame", new_frame, data);
+  g_signal_connect (timeline, "new-frame",
+                    G_CALLBACK (hd_transition_frame_end), NULL);
+}
+
 /* ------------------------------------------------------------------------- */
 /* ------------------------------------------------------------------------- */
 /* ------------------------------------------------------------------------- */
@@ -598,8 +639,7 @@ on_notification_timeline_new_frame(ClutterTimeline *timeline,
   clutter_actor_get_position(actor, &px, &py);
   now = msecs / (float)clutter_timeline_get_duration(timeline);
 
-  if (hd_comp_mgr_is_portrait()
-      && hd_transition_get_int("notification", "is_cool", 0))
+  if (hd_comp_mgr_is_portrait() && data->is_cool)
     {
       /* In portrait fly from right to left, stay in the corner
        * then fly away, following a bezier curve.  At the start
@@ -770,7 +810,6 @@ on_rotate_screen_timeline_new_frame(ClutterTimeline *timeline,
 {
   float amt, dim_amt, angle;
   gint duration;
-  gint use_zaxis = hd_transition_get_int ("thp_tweaks", "zaxisrotation", 0);
   ClutterActor *actor;
 
   duration = clutter_timeline_get_duration(timeline);
@@ -788,13 +827,13 @@ on_rotate_screen_timeline_new_frame(ClutterTimeline *timeline,
   angle = data->angle * amt;
 
   actor = CLUTTER_ACTOR(hd_render_manager_get());
-  clutter_actor_set_rotation(actor, use_zaxis ? CLUTTER_Z_AXIS :
+  clutter_actor_set_rotation(actor, data->use_zaxis ? CLUTTER_Z_AXIS :
       (hd_comp_mgr_is_portrait () ? CLUTTER_Y_AXIS : CLUTTER_X_AXIS),
       msecs < duration ? angle : 0,
       hd_comp_mgr_get_current_screen_width()/2,
       hd_comp_mgr_get_current_screen_height()/2, 0);
 
-  if (!use_zaxis)
+  if (!data->use_zaxis)
     {
       clutter_actor_set_depth(actor, -amt * 150);
       /* use this actor to dim out the screen */
@@ -937,8 +976,8 @@ hd_transition_popup(HdCompMgr                  *mgr,
   data->cclient_actor = g_object_ref (actor);
   data->hmgr = HD_COMP_MGR (mgr);
   data->timeline = hd_transition_timeline_new("popup", event, 250);
-  g_signal_connect (data->timeline, "new-frame",
-                        G_CALLBACK (on_popup_timeline_new_frame), data);
+  hd_transition_connect_new_frame (data->timeline,
+                                  G_CALLBACK (on_popup_timeline_new_frame), data);
   g_signal_connect (data->timeline, "completed",
                         G_CALLBACK (hd_transition_completed), data);
   data->geo = geo;
@@ -961,6 +1000,7 @@ hd_transition_popup(HdCompMgr                  *mgr,
                               MBWMCompMgrClutterClientEffectRunning);
 
   hd_comp_mgr_set_effect_running(mgr, TRUE);
+  hd_render_manager_remove_occlusion_clip(data->cclient_actor);
 
   /* Add actor for the background when we pop a bit too far */
   data->particles[0] = g_object_ref(clutter_rectangle_new());
@@ -1012,8 +1052,8 @@ hd_transition_fade(HdCompMgr                  *mgr,
     /* Leave @data->geo 0, we needn't move the actor around. */
     data->final_alpha = 1;
 
-  g_signal_connect (data->timeline, "new-frame",
-                        G_CALLBACK (on_fade_timeline_new_frame), data);
+  hd_transition_connect_new_frame (data->timeline,
+                                  G_CALLBACK (on_fade_timeline_new_frame), data);
   g_signal_connect (data->timeline, "completed",
                         G_CALLBACK (hd_transition_completed), data);
 
@@ -1021,6 +1061,7 @@ hd_transition_fade(HdCompMgr                  *mgr,
                               MBWMCompMgrClutterClientDontUpdate |
                               MBWMCompMgrClutterClientEffectRunning);
   hd_comp_mgr_set_effect_running(mgr, TRUE);
+  hd_render_manager_remove_occlusion_clip(data->cclient_actor);
 
   /* first call to stop flicker */
   on_fade_timeline_new_frame(data->timeline, 0, data);
@@ -1058,8 +1099,8 @@ hd_transition_fade_out_loading_screen(ClutterActor *loading_image)
         }
       }
 
-    g_signal_connect (data->timeline, "new-frame",
-                          G_CALLBACK (on_fade_timeline_new_frame), data);
+    hd_transition_connect_new_frame (data->timeline,
+                                    G_CALLBACK (on_fade_timeline_new_frame), data);
     g_signal_connect (data->timeline, "completed",
                           G_CALLBACK (hd_transition_completed), data);
     clutter_actor_add_child (CLUTTER_ACTOR(hd_render_manager_get_front_group()),
@@ -1125,8 +1166,8 @@ hd_transition_close_app (HdCompMgr                  *mgr,
   data->hmgr = HD_COMP_MGR (mgr);
   data->timeline = clutter_timeline_new (
                     hd_transition_get_int("app_close", "duration", 500));
-  g_signal_connect (data->timeline, "new-frame",
-                    G_CALLBACK (on_close_timeline_new_frame), data);
+  hd_transition_connect_new_frame (data->timeline,
+                                  G_CALLBACK (on_close_timeline_new_frame), data);
   g_signal_connect (clutter_stage_get_default (), "notify::allocation",
                     G_CALLBACK (on_screen_size_changed), data);
   g_signal_connect (data->timeline, "completed",
@@ -1158,6 +1199,7 @@ hd_transition_close_app (HdCompMgr                  *mgr,
     }
 
   hd_comp_mgr_set_effect_running(mgr, TRUE);
+  hd_render_manager_remove_occlusion_clip(actor);
   clutter_timeline_start (data->timeline);
 
   hd_transition_play_sound (HDCM_WINDOW_CLOSED_SOUND);
@@ -1184,9 +1226,10 @@ hd_transition_notification(HdCompMgr                  *mgr,
       mb_wm_comp_mgr_clutter_client_get_actor( data->cclient ) );
   data->hmgr = HD_COMP_MGR (mgr);
   data->timeline = hd_transition_timeline_new("notification", event, 500);
+  data->is_cool = hd_transition_get_int("notification", "is_cool", 0);
 
-  g_signal_connect (data->timeline, "new-frame",
-                        G_CALLBACK (on_notification_timeline_new_frame), data);
+  hd_transition_connect_new_frame (data->timeline,
+                                  G_CALLBACK (on_notification_timeline_new_frame), data);
   g_signal_connect (data->timeline, "completed",
                         G_CALLBACK (hd_transition_completed), data);
 
@@ -1194,6 +1237,7 @@ hd_transition_notification(HdCompMgr                  *mgr,
                               MBWMCompMgrClutterClientDontUpdate |
                               MBWMCompMgrClutterClientEffectRunning);
   hd_comp_mgr_set_effect_running(mgr, TRUE);
+  hd_render_manager_remove_occlusion_clip(data->cclient_actor);
 
   /* first call to stop flicker */
   on_notification_timeline_new_frame(data->timeline, 0, data);
@@ -1271,6 +1315,7 @@ hd_transition_subview(HdCompMgr                  *mgr,
                                       MBWMCompMgrClutterClientDontUpdate |
                                       MBWMCompMgrClutterClientEffectRunning);
           HD_COMP_MGR_CLIENT (cclient_subview)->effect = data;
+          hd_render_manager_remove_occlusion_clip(data->cclient_actor);
         }
       return;
     }
@@ -1302,6 +1347,7 @@ hd_transition_subview(HdCompMgr                  *mgr,
                                       MBWMCompMgrClutterClientDontUpdate |
                                       MBWMCompMgrClutterClientEffectRunning);
           HD_COMP_MGR_CLIENT (cclient_mainview)->effect = data;
+          hd_render_manager_remove_occlusion_clip(data->cclient2_actor);
         }
       return;
     }
@@ -1322,8 +1368,8 @@ hd_transition_subview(HdCompMgr                  *mgr,
   Transitions_running += data->fixup_visibilities = TRUE;
   data->timeline = hd_transition_timeline_new("subview", event, 250);
 
-  g_signal_connect (data->timeline, "new-frame",
-                        G_CALLBACK (on_subview_timeline_new_frame), data);
+  hd_transition_connect_new_frame (data->timeline,
+                                  G_CALLBACK (on_subview_timeline_new_frame), data);
   g_signal_connect (data->timeline, "completed",
                         G_CALLBACK (hd_transition_completed), data);
 
@@ -1335,6 +1381,8 @@ hd_transition_subview(HdCompMgr                  *mgr,
                                 MBWMCompMgrClutterClientEffectRunning);
 
   hd_comp_mgr_set_effect_running(mgr, TRUE);
+  hd_render_manager_remove_occlusion_clip(data->cclient_actor);
+  hd_render_manager_remove_occlusion_clip(data->cclient2_actor);
   HD_COMP_MGR_CLIENT (cclient_mainview)->effect = data;
   HD_COMP_MGR_CLIENT (cclient_subview)->effect  = data;
 
@@ -1382,9 +1430,10 @@ hd_transition_fade_and_rotate(gboolean first_part,
   data->event = first_part ? MBWMCompMgrClientEventMap :
                              MBWMCompMgrClientEventUnmap;
   data->timeline = hd_transition_timeline_new("rotate", data->event, 300);
+  data->use_zaxis = use_zaxis;
 
-  g_signal_connect (data->timeline, "new-frame",
-                        G_CALLBACK (on_rotate_screen_timeline_new_frame), data);
+  hd_transition_connect_new_frame (data->timeline,
+                                  G_CALLBACK (on_rotate_screen_timeline_new_frame), data);
   g_signal_connect (data->timeline, "completed",
                          G_CALLBACK (hd_transition_completed), data);
   if (finished_callback)
@@ -1448,7 +1497,7 @@ patience (XClientMessageEvent *event, void *unused)
       if (Orientation_change.timeout_id)
         {
           /* remaining := max(damage_timeout_max-elapsed, 0) */
-          max  = hd_transition_get_int("rotate", "damage_timeout_max", 1000);
+          max  = Orientation_change.damage_timeout_max;
           max -= g_timer_elapsed(Orientation_change.timer, NULL) * 1000.0;
           if (max > 0)
             Orientation_change.timeout_id->remaining = max;
@@ -1630,10 +1679,13 @@ trans_start_error:
             hd_util_root_window_configured(Orientation_change.wm);
 
             g_assert(!Orientation_change.timeout_id);
+            Orientation_change.damage_timeout_max =
+              hd_transition_get_int("rotate", "damage_timeout_max", 1000);
+            Orientation_change.damage_timeout_plus =
+              hd_transition_get_int("rotate", "damage_timeout_plus", 50);
             Orientation_change.timeout_id = hptimer_new(
                   Orientation_change.patience_requests
-                    ? hd_transition_get_int("rotate", "damage_timeout_max",
-                                            1000)
+                    ? Orientation_change.damage_timeout_max
                     : hd_transition_get_int("rotate", "damage_timeout", 50),
                   (GSourceFunc)hd_transition_rotating_fsm,
                   &Orientation_change.timeout_id,
@@ -1830,14 +1882,13 @@ hd_transition_rotate_ignore_damage()
        * remaining := min(max(remaining, damage_timeout_plus),
        *                  max(damage_timeout_max-elapsed, 0))
        */
-      max  = hd_transition_get_int("rotate", "damage_timeout_max", 1000);
+      max  = Orientation_change.damage_timeout_max;
       max -= g_timer_elapsed(Orientation_change.timer, NULL) * 1000.0;
       if (max > 0)
         {
           gint remaining;
 
-          remaining = hd_transition_get_int("rotate", "damage_timeout_plus",
-                                            50);
+          remaining = Orientation_change.damage_timeout_plus;
           if (Orientation_change.timeout_id->remaining < remaining)
             Orientation_change.timeout_id->remaining = remaining;
           if (Orientation_change.timeout_id->remaining > max)
@@ -1957,10 +2008,103 @@ transitions_ini_changed(GIOChannel *chnl, GIOCondition cond, gpointer unused)
   return TRUE;
 }
 
-static GKeyFile *
-hd_transition_get_keyfile(void)
+/* A value of transitions.ini, parsed in every way it may be asked for
+ * when the file is loaded, so lookups needn't parse anything. */
+typedef struct
+{
+  gchar *string;
+  gint int_val;
+  gdouble double_val;
+  HdKeyFrameList *keyframes;
+  guint is_int : 1;
+  guint is_double : 1;
+} HdTransitionValue;
+
+/* The current contents of transitions.ini: a table of groups, each mapping
+ * key names to HdTransitionValue:s.  It's replaced as a whole when the file
+ * is reloaded and never changed otherwise. */
+static GHashTable *transitions_ini;
+
+/* Incremented whenever a new transitions.ini is loaded. */
+static guint transitions_ini_generation;
+
+static void
+hd_transition_value_free(HdTransitionValue *value)
+{
+  g_free(value->string);
+  hd_key_frame_list_free(value->keyframes);
+  g_slice_free(HdTransitionValue, value);
+}
+
+/* Makes a new @transitions_ini out of @ini. */
+static GHashTable *
+hd_transition_compile(GKeyFile *ini)
+{
+  GHashTable *groups;
+  gchar **group_names;
+  guint i;
+
+  groups = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                 (GDestroyNotify)g_hash_table_destroy);
+  group_names = g_key_file_get_groups(ini, NULL);
+  for (i = 0; group_names[i]; i++)
+    {
+      GHashTable *keys;
+      gchar **key_names;
+      guint j;
+
+      keys = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                   (GDestroyNotify)hd_transition_value_free);
+      key_names = g_key_file_get_keys(ini, group_names[i], NULL, NULL);
+      for (j = 0; key_names && key_names[j]; j++)
+        {
+          HdTransitionValue *value;
+          GError *error;
+
+          value = g_slice_new0(HdTransitionValue);
+          value->string = g_key_file_get_string(ini, group_names[i],
+                                                key_names[j], NULL);
+          if (!value->string)
+            { /* Can't be unescaped, pretend it's not there. */
+              g_slice_free(HdTransitionValue, value);
+              continue;
+            }
+
+          error = NULL;
+          value->int_val = g_key_file_get_integer(ini, group_names[i],
+                                                  key_names[j], &error);
+          if (!error)
+            value->is_int = TRUE;
+          else
+            g_error_free(error);
+
+          error = NULL;
+          value->double_val = g_key_file_get_double(ini, group_names[i],
+                                                    key_names[j], &error);
+          if (!error)
+            value->is_double = TRUE;
+          else
+            g_error_free(error);
+
+          if (strchr(value->string, ','))
+            value->keyframes = hd_key_frame_list_create(value->string);
+
+          g_hash_table_insert(keys, g_strdup(key_names[j]), value);
+        }
+      g_strfreev(key_names);
+
+      g_hash_table_insert(groups, g_strdup(group_names[i]), keys);
+    }
+  g_strfreev(group_names);
+
+  return groups;
+}
+
+/* Returns the current @transitions_ini, loading it if it's not loaded
+ * yet or it's changed, or %NULL if it's never been loaded successfully. */
+static GHashTable *
+hd_transition_get_config(void)
 {
-  static GKeyFile *transitions_ini;
   static GIOChannel *transitions_ini_watcher;
   GError *error;
   GKeyFile *ini;
@@ -1992,8 +2136,10 @@ hd_transition_get_keyfile(void)
 
   /* Use the new @transitions_ini. */
   if (transitions_ini)
-    g_key_file_free(transitions_ini);
-  transitions_ini = ini;
+    g_hash_table_destroy(transitions_ini);
+  transitions_ini = hd_transition_compile(ini);
+  transitions_ini_generation++;
+  g_key_file_free(ini);
 
   if (!transitions_ini_watcher || transitions_ini_is_dirty > TRUE)
     {
@@ -2037,52 +2183,55 @@ out:
   return transitions_ini;
 }
 
-gint
-hd_transition_get_int(const gchar *transition, const char *key,
-                      gint default_val)
+/* Returns the value of @transition::@key or %NULL if it's not set. */
+static const HdTransitionValue *
+hd_transition_lookup(const gchar *transition, const char *key)
 {
-  gint value;
-  GError *error;
-  GKeyFile *ini;
-
-  if (!(ini = hd_transition_get_keyfile()))
-    return default_val;
+  GHashTable *ini, *keys;
 
-  error = NULL;
-  value = g_key_file_get_integer(ini, transition, key, &error);
-  if (error)
+  hd_stats_count(HD_STATS_TRANSITION_LOOKUPS);
+  if (In_new_frame)
     {
-      g_debug("couldn't read int %s::%s from transitions.ini: %s",
-                transition, key, error->message);
-      g_error_free(error);
-      return default_val;
+      if (!hd_stats_get_count(HD_STATS_TRANSITION_FRAME_LOOKUPS))
+        g_warning("%s: %s::%s looked up in a new-frame callback",
+                  __FUNCTION__, transition, key);
+      hd_stats_count(HD_STATS_TRANSITION_FRAME_LOOKUPS);
     }
 
-  return value;
+  if (!(ini = hd_transition_get_config()))
+    return NULL;
+  if (!(keys = g_hash_table_lookup(ini, transition)))
+    return NULL;
+  return g_hash_table_lookup(keys, key);
+}
+
+/* Returns a number that changes whenever transitions.ini is reloaded,
+ * so callers can keep what they parsed out of it until then. */
+guint
+hd_transition_get_generation(void)
+{
+  hd_transition_get_config();
+  return transitions_ini_generation;
+}
+
+gint
+hd_transition_get_int(const gchar *transition, const char *key,
+                      gint default_val)
+{
+  const HdTransitionValue *value;
+
+  value = hd_transition_lookup(transition, key);
+  return value && value->is_int ? value->int_val : default_val;
 }
 
 gdouble
 hd_transition_get_double(const gchar *transition,
                          const char *key, gdouble default_val)
 {
-  gdouble value;
-  GError *error;
-  GKeyFile *ini;
-
-  if (!(ini = hd_transition_get_keyfile()))
-    return default_val;
-
-  error = NULL;
-  value = g_key_file_get_double (ini, transition, key, &error);
-  if (error)
-    {
-      g_debug("couldn't read double %s::%s from transitions.ini: %s",
-                transition, key, error->message);
-      g_error_free(error);
-      return default_val;
-    }
+  const HdTransitionValue *value;
 
-  return value;
+  value = hd_transition_lookup(transition, key);
+  return value && value->is_double ? value->double_val : default_val;
 }
 
 /* Returns a newly-allocated string that must *always* be freed by the caller */
@@ -2090,39 +2239,26 @@ gchar *
 hd_transition_get_string(const gchar *transition, const char *key,
                       gchar *default_val)
 {
-  gchar *value;
-  GError *error;
-  GKeyFile *ini;
+  const HdTransitionValue *value;
 
-  if (!(ini = hd_transition_get_keyfile())) {
-    /* It sould be a newly allocated string.
-     * Fixes BMO #12722: hildon-desktop crashes on malformed transitions.ini.
-     */
-    gchar *new_val = g_strdup(default_val);
-    return new_val;
-  }
-
-  error = NULL;
-  value = g_key_file_get_string (ini, transition, key, &error);
-  if (error)
-    {
-      g_debug("couldn't read string %s::%s from transitions.ini: %s",
-                transition, key, error->message);
-      g_error_free(error);
-      return g_strdup(default_val);
-    }
-
-  return value;
+  /* It sould be a newly allocated string.
+   * Fixes BMO #12722: hildon-desktop crashes on malformed transitions.ini.
+   */
+  value = hd_transition_lookup(transition, key);
+  return g_strdup(value ? value->string : default_val);
 }
 
+/* Returns a newly-allocated list the caller must free */
 HdKeyFrameList *
 hd_transition_get_keyframes(const gchar *transition, const char *key,
                             gchar *default_val)
 {
-  char *keyframetext = hd_transition_get_string(transition, key, default_val);
-  HdKeyFrameList *keyframes = hd_key_frame_list_create(keyframetext);
-  g_free(keyframetext);
-  return keyframes;
+  const HdTransitionValue *value;
+
+  value = hd_transition_lookup(transition, key);
+  if (value && value->keyframes)
+    return hd_key_frame_list_copy(value->keyframes);
+  return hd_key_frame_list_create(value ? value->string : default_val);
 }
 
 void
@@ -122,6 +122,9 @@ hd_transition_get_keyframes(const gchar *transition, const char *key,
 void
 hd_transition_set_file_changed(void);
 
+guint
+hd_transition_get_generation(void);
+
 void
 hd_transition_play_tactile(gboolean is_map, MBWMClientType c_type);
 
@@ -14,8 +14,10 @@
 #include "hd-note.h"
 #include "hd-transition.h"
 #include "hd-render-manager.h"
+#include "hd-stats.h"
 
 #include <gdk/gdk.h>
+#include <math.h>
 #include <GLES2/gl2.h>
 
 void *
@@ -560,16 +562,151 @@ hd_util_click (const MBWindowManagerClient *c)
   XSendEvent(xdpy, xwin, False, ButtonPressMask, (XEvent *)&ev);
 }
 
+/* The transformation of an actor relative to its parent, cached by
+ * hd_util_get_actor_transform() until one of the properties it's made
+ * of changes.  A point (x, y) of the actor is at
+ * (xx*x + xy*y + x0, yx*x + yy*y + y0) in its parent. */
+typedef struct
+{
+  gdouble xx, xy, yx, yy, x0, y0;
+  /* Whether the above are out of date. */
+  gboolean dirty;
+  /* FALSE if the actor is rotated in a way we can't represent. */
+  gboolean valid;
+} HdUtilTransform;
+
+static void
+hd_util_free_transform (gpointer transform)
+{
+  g_slice_free (HdUtilTransform, transform);
+}
+
+/* The properties of ClutterActor which affect its transformation.
+ * @name must be interned, as the names of #GParamSpec:s are, so this
+ * needn't take the lock of g_intern_string() for every notification. */
+static gboolean
+hd_util_is_transform_property (const gchar *name)
+{
+  static const gchar *props[] = {
+    "x", "y", "position", "allocation",
+    "scale-x", "scale-y", "scale-center-x", "scale-center-y", "scale-gravity",
+    "rotation-angle-x", "rotation-angle-y", "rotation-angle-z",
+    "rotation-center-x", "rotation-center-y", "rotation-center-z",
+    "rotation-center-z-gravity",
+    "anchor-x", "anchor-y", "anchor-gravity",
+  };
+  static const gchar *interned[G_N_ELEMENTS (props)];
+  guint i;
+
+  if (!interned[0])
+    for (i = 0; i < G_N_ELEMENTS (props); i++)
+      interned[i] = g_intern_static_string (props[i]);
+
+  for (i = 0; i < G_N_ELEMENTS (interned); i++)
+    if (interned[i] == name)
+      return TRUE;
+  return FALSE;
+}
+
+static void
+hd_util_transform_changed (ClutterActor *actor, GParamSpec *pspec,
+                           HdUtilTransform *transform)
+{
+  if (!transform->dirty && hd_util_is_transform_property (pspec->name))
+    transform->dirty = TRUE;
+}
+
+/* Returns the sine and cosine of @angle if it's a multiple of 90 degrees,
+ * which is all the rotation the partial redraw code can cope with. */
+static gboolean
+hd_util_right_angle (gdouble angle, gint *sinp, gint *cosp)
+{
+  static const gint sines[] = { 0, 1, 0, -1 };
+  gdouble quarters;
+  gint n;
+
+  quarters = angle / 90;
+  n = (gint)floor (quarters + 0.5);
+  if (fabs (quarters - n) > 0.0001)
+    return FALSE;
+  n = ((n % 4) + 4) % 4;
+  *sinp = sines[n];
+  *cosp = sines[(n + 1) % 4];
+  return TRUE;
+}
+
+/* Returns @actor's transformation relative to its parent, recalculating
+ * it only if it has changed since the last call. */
+static const HdUtilTransform *
+hd_util_get_actor_transform (ClutterActor *actor)
+{
+  static GQuark quark;
+  HdUtilTransform *t;
+  gfloat px, py, anchorx, anchory, cx, cy, cz;
+  gdouble scalex, scaley, angle;
+  gint s, c;
+
+  if (!quark)
+    quark = g_quark_from_static_string ("HD-stage-transform");
+
+  if (!(t = g_object_get_qdata (G_OBJECT (actor), quark)))
+    {
+      t = g_slice_new (HdUtilTransform);
+      t->dirty = TRUE;
+      g_object_set_qdata_full (G_OBJECT (actor), quark, t,
+                               hd_util_free_transform);
+      g_signal_connect (actor, "notify",
+                        G_CALLBACK (hd_util_transform_changed), t);
+    }
+  if (!t->dirty)
+    return t;
+  t->dirty = FALSE;
+
+  /* We can't do anything about perspective, but X/Y rotation by
+   * 0 degrees is fine. */
+  t->valid = clutter_actor_get_rotation_angle (actor, CLUTTER_X_AXIS) == 0
+          && clutter_actor_get_rotation_angle (actor, CLUTTER_Y_AXIS) == 0;
+  angle = clutter_actor_get_rotation (actor, CLUTTER_Z_AXIS, &cx, &cy, &cz);
+  if (!hd_util_right_angle (angle, &s, &c))
+    t->valid = FALSE;
+  if (!t->valid)
+    return t;
+
+  clutter_actor_get_position (actor, &px, &py);
+  clutter_actor_get_anchor_point (actor, &anchorx, &anchory);
+  clutter_actor_get_scale (actor, &scalex, &scaley);
+
+  /*
+   * Clutter applies these in the order of: anchor point, rotation about
+   * its centre (cx, cy), scaling about its centre (scx, scy) and finally
+   * position, so
+   * x' = scalex * (c*(x-anchorx-cx) - s*(y-anchory-cy) + cx - scx) + scx + px
+   * y' = scaley * (s*(x-anchorx-cx) + c*(y-anchory-cy) + cy - scy) + scy + py
+   */
+  t->xx = scalex * c;
+  t->xy = scalex * -s;
+  t->yx = scaley * s;
+  t->yy = scaley * c;
+  t->x0 = scalex * (c * (-anchorx - cx) - s * (-anchory - cy) + cx);
+  t->y0 = scaley * (s * (-anchorx - cx) + c * (-anchory - cy) + cy);
+
+  clutter_actor_get_scale_center (actor, &cx, &cy);
+  t->x0 += (1 - scalex) * cx + px;
+  t->y0 += (1 - scaley) * cy + py;
+
+  return t;
+}
+
 /* Try and get the translated bounds for an actor (the actual pixel position
  * of it on the screen). If geo is 0 or width/height are 0, this func will
  * use the full bounds of the actor. Otherwise we translate the bounds given
  * in geo (eg. for updating an area of an actor). Returns false if it failed
- * (because the actor or its parents were rotated) */
+ * (because the actor or its parents were rotated by something other than
+ * a multiple of 90 degrees) */
 static gboolean
 hd_util_get_actor_bounds(ClutterActor *actor, ClutterGeometry *geo, gboolean *is_visible)
 {
-  gdouble x, y;
-  gdouble width, height;
+  gdouble x1, y1, x2, y2;
   ClutterActor *it = actor;
   ClutterActor *stage = clutter_actor_get_stage(actor);
   gboolean visible = TRUE;
@@ -577,52 +714,54 @@ hd_util_get_actor_bounds(ClutterActor *actor, ClutterGeometry *geo, gboolean *is
 
   if (geo && geo->width && geo->height)
     {
-      x = geo->x;
-      y = geo->y;
-      width = geo->width;
-      height = geo->height;
+      x1 = geo->x;
+      y1 = geo->y;
+      x2 = x1 + geo->width;
+      y2 = y1 + geo->height;
     }
   else
     {
       gfloat w,h;
       clutter_actor_get_size(actor, &w, &h);
-      x = 0;
-      y = 0;
-      width = w;
-      height = h;
+      x1 = 0;
+      y1 = 0;
+      x2 = w;
+      y2 = h;
     }
 
+  /* Since all the rotations are right angles the rectangle stays
+   * axis-aligned, so it's enough to transform two opposite corners. */
   while (it && it != stage)
     {
-      gfloat px,py;
-      gdouble scalex, scaley;
-      gfloat anchorx, anchory;
-
-      /* Big safety check here - don't attempt to work out bounds if anything
-       * is rotated, as we'll probably get it wrong. */
-      clutter_actor_get_scale(it, &scalex, &scaley);
-      clutter_actor_get_anchor_point(it, &anchorx, &anchory);
-      if (clutter_actor_get_rotation_angle(it, CLUTTER_X_AXIS)!=0 ||
-          clutter_actor_get_rotation_angle(it, CLUTTER_Y_AXIS)!=0 ||
-          clutter_actor_get_rotation_angle(it, CLUTTER_Z_AXIS)!=0)
-        valid = FALSE;
-
-      clutter_actor_get_position(it, &px, &py);
-      x = (x - anchorx) * scalex + px;
-      y = (y - anchory) * scaley + py;
-      width *= scalex;
-      height *= scaley;
+      const HdUtilTransform *t;
+      gdouble tx1, ty1, tx2, ty2;
+
+      t = hd_util_get_actor_transform(it);
+      if (!t->valid)
+        {
+          valid = FALSE;
+          break;
+        }
+
+      tx1 = t->xx * x1 + t->xy * y1 + t->x0;
+      ty1 = t->yx * x1 + t->yy * y1 + t->y0;
+      tx2 = t->xx * x2 + t->xy * y2 + t->x0;
+      ty2 = t->yx * x2 + t->yy * y2 + t->y0;
+      x1 = MIN(tx1, tx2);
+      y1 = MIN(ty1, ty2);
+      x2 = MAX(tx1, tx2);
+      y2 = MAX(ty1, ty2);
 
       it = clutter_actor_get_parent(it);
     }
 
   if (geo)
     {
-      /* Do some simple rounding */
-      geo->x = (int)(x + 0.5);
-      geo->y = (int)(y + 0.5);
-      geo->width = (int)(width + 0.5);
-      geo->height = (int)(height + 0.5);
+      /* Round outwards so we don't leave stale pixels at the edges */
+      geo->x = (int)floor(x1);
+      geo->y = (int)floor(y1);
+      geo->width = (int)ceil(x2) - geo->x;
+      geo->height = (int)ceil(y2) - geo->y;
     }
   if (is_visible)
     {
@@ -659,9 +798,13 @@ hd_util_partial_redraw_if_possible(ClutterActor *actor, ClutterGeometry *bounds)
       };
 
       clutter_actor_queue_redraw_with_clip(stage, &clip);
+      hd_stats_count(HD_STATS_REDRAW_CLIPPED);
     }
   else
+    {
       clutter_actor_queue_redraw(stage);
+      hd_stats_count(HD_STATS_REDRAW_FULL);
+    }
 }
 
 /* Check to see whether clients above this one totally obscure it */
@@ -760,6 +903,15 @@ fail:
   return k;
 }
 
+/* Duplicate a keyframe list, so it needn't be parsed again */
+HdKeyFrameList *hd_key_frame_list_copy(const HdKeyFrameList *k)
+{
+  HdKeyFrameList *copy = g_new(HdKeyFrameList, 1);
+  copy->count = k->count;
+  copy->keyframes = g_memdup(k->keyframes, sizeof(float) * k->count);
+  return copy;
+}
+
 void hd_key_frame_list_free(HdKeyFrameList *k)
 {
   if (k)
@@ -45,6 +45,7 @@ gboolean hd_util_client_obscured(MBWindowManagerClient *client);
 /* Functions for loading and interpolating from a list of keyframes */
 typedef struct _HdKeyFrameList HdKeyFrameList;
 HdKeyFrameList *hd_key_frame_list_create(const char *keys);
+HdKeyFrameList *hd_key_frame_list_copy(const HdKeyFrameList *k);
 void hd_key_frame_list_free(HdKeyFrameList *k);
 float hd_key_frame_interpolate(HdKeyFrameList *k, float x);
 
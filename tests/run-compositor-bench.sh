@@ -0,0 +1,82 @@
+#!/bin/sh
+# Runs test-compositor-bench against hildon-desktop on a virtual X server
+# with Mesa's software rasterizer, so no GPU or device is needed.
+#   ./run-compositor-bench.sh [report] [windows] [repeats]
+# The report (stdout by default) can be diffed against the one of another
+# build, and the script fails if a scenario did.  hildon-desktop only takes
+# the state changes of the scenarios from the session bus if it's connected
+# to a system bus too, so if there isn't one we start a private one.
+# Set HILDON_DESKTOP to the binary to test, BENCH_CLIENT to
+# test-compositor-bench if it's not next to this script and BENCH_DISPLAY
+# to the X display to use (:99).  `make bench' runs it on the built tree.
+
+set -e
+
+report=${1:--}
+[ $# -eq 0 ] || shift
+
+dir=$(cd "$(dirname "$0")" && pwd)
+hd=${HILDON_DESKTOP:-$dir/../src/hildon-desktop}
+bench=${BENCH_CLIENT:-$dir/test-compositor-bench}
+display=${BENCH_DISPLAY:-:99}
+
+LIBGL_ALWAYS_SOFTWARE=1
+GALLIUM_DRIVER=llvmpipe
+DISPLAY=$display
+export LIBGL_ALWAYS_SOFTWARE GALLIUM_DRIVER DISPLAY
+
+xvfb_pid=
+hd_pid=
+cleanup ()
+{
+  [ -z "$hd_pid" ] || kill "$hd_pid" 2>/dev/null || true
+  [ -z "$xvfb_pid" ] || kill "$xvfb_pid" 2>/dev/null || true
+  [ -z "$DBUS_SESSION_BUS_PID" ] || kill "$DBUS_SESSION_BUS_PID" 2>/dev/null \
+    || true
+  [ -z "$BENCH_SYSTEM_BUS_PID" ] || kill "$BENCH_SYSTEM_BUS_PID" 2>/dev/null \
+    || true
+}
+trap cleanup EXIT INT TERM
+
+Xvfb "$display" -screen 0 800x480x24 +extension GLX +extension XTEST \
+  -nolisten tcp >/dev/null 2>&1 &
+xvfb_pid=$!
+eval $(dbus-launch --sh-syntax)
+if ! dbus-send --system --print-reply --dest=org.freedesktop.DBus \
+       /org/freedesktop/DBus org.freedesktop.DBus.GetId >/dev/null 2>&1; then
+  eval $(dbus-launch --sh-syntax | sed 's/DBUS_SESSION_BUS/BENCH_SYSTEM_BUS/g')
+  DBUS_SYSTEM_BUS_ADDRESS=$BENCH_SYSTEM_BUS_ADDRESS
+  export DBUS_SYSTEM_BUS_ADDRESS
+  dbus-send --system --print-reply --dest=org.freedesktop.DBus \
+      /org/freedesktop/DBus org.freedesktop.DBus.GetId >/dev/null 2>&1 \
+    || { echo "couldn't start a system bus" >&2; exit 1; }
+fi
+
+# Wait for the X server, then for hildon-desktop to claim its name.
+i=0
+until xdpyinfo >/dev/null 2>&1; do
+  i=$((i + 1))
+  [ $i -lt 50 ] || { echo "Xvfb didn't start" >&2; exit 1; }
+  sleep 0.1
+done
+
+"$hd" >/dev/null 2>&1 &
+hd_pid=$!
+
+i=0
+until dbus-send --session --print-reply --dest=org.freedesktop.DBus \
+        /org/freedesktop/DBus org.freedesktop.DBus.NameHasOwner \
+        string:com.nokia.HildonDesktop.Home 2>/dev/null | grep -q true; do
+  i=$((i + 1))
+  [ $i -lt 300 ] || { echo "hildon-desktop didn't start" >&2; exit 1; }
+  kill -0 "$hd_pid" 2>/dev/null || { echo "hildon-desktop died" >&2; exit 1; }
+  sleep 0.1
+done
+# Let the startup animations finish.
+sleep 3
+
+if [ "$report" = "-" ]; then
+  "$bench" "$@"
+else
+  "$bench" "$@" > "$report"
+fi
@@ -0,0 +1,205 @@
+/* Benchmark of TidyBlurEffect: blurs an 800x480 stage full of coloured
+ * rectangles at every blur level, both by iterating the full-size filter
+ * and with the dual filter pyramid, and prints the number of shader passes
+ * and the time per frame.  Frames are read back so the GPU has finished
+ * by the time they are measured.  Works on a headless box with software
+ * GL as well, eg.
+ *   xvfb-run -s '-screen 0 800x480x24' \
+ *     env LIBGL_ALWAYS_SOFTWARE=1 ./test-blur-speed [frames] [max-blur]
+ * (the "blur ms" column is the CPU side only, "frame ms" includes
+ * waiting for the rendering).  Finally it checks that damaging one
+ * rectangle only re-blurs around it: another rectangle changed without
+ * damage mustn't show up in the blurred image, but where the damaged
+ * one was must when it's moved as well. */
+
+#include <clutter/clutter.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "tidy/tidy-blur-effect.h"
+#include "util/hd-stats.h"
+
+#define AREAW 800
+#define AREAH 480
+
+static ClutterActor *
+create_scene (ClutterActor *stage)
+{
+  ClutterActor *group;
+  guint x, y;
+
+  group = clutter_actor_new ();
+  for (y = 0; y < AREAH; y += 40)
+    for (x = 0; x < AREAW; x += 40)
+      {
+        ClutterActor *rect;
+        ClutterColor color;
+
+        color.red   = x * 255 / AREAW;
+        color.green = y * 255 / AREAH;
+        color.blue  = ((x + y) / 40) & 1 ? 255 : 0;
+        color.alpha = 255;
+
+        rect = clutter_actor_new ();
+        clutter_actor_set_background_color (rect, &color);
+        clutter_actor_set_position (rect, x, y);
+        clutter_actor_set_size (rect, 40, 40);
+        clutter_actor_add_child (group, rect);
+      }
+  clutter_actor_add_child (stage, group);
+
+  return group;
+}
+
+/* Paints @frames frames of @group and prints how long they took. */
+static void
+measure (ClutterActor *stage, ClutterActor *group, ClutterEffect *effect,
+         guint levels, guint blur, guint frames)
+{
+  const HdStatsHistogram *blur_time;
+  gint64 start;
+  guint i;
+
+  tidy_blur_effect_set_pyramid_levels (effect, levels);
+  tidy_blur_effect_set_blur (effect, blur);
+  hd_stats_reset ();
+
+  start = hd_stats_now ();
+  for (i = 0; i < frames; i++)
+    {
+      /* Reading the stage paints it and waits for the result. */
+      clutter_actor_queue_redraw (group);
+      g_free (clutter_stage_read_pixels (CLUTTER_STAGE (stage),
+                                         0, 0, 1, 1));
+    }
+
+  blur_time = hd_stats_get_timer (HD_STATS_BLUR);
+  printf ("%-9s %4u %7.1f %8.3f %9.3f\n",
+          levels ? "pyramid" : "iterative", blur,
+          (gdouble)hd_stats_get_count (HD_STATS_BLUR_PASSES) / frames,
+          blur_time->n ? blur_time->sum / 1000.0 / blur_time->n : 0.0,
+          (hd_stats_now () - start) / 1000.0 / frames);
+}
+
+/* Returns the colour of the stage at @x, @y as 0xRRGGBB. */
+static guint
+read_pixel (ClutterActor *stage, gint x, gint y)
+{
+  guchar *pixel;
+  guint rgb;
+
+  pixel = clutter_stage_read_pixels (CLUTTER_STAGE (stage), x, y, 1, 1);
+  rgb = (pixel[0] << 16) | (pixel[1] << 8) | pixel[2];
+  g_free (pixel);
+  return rgb;
+}
+
+/* Blurs @group, then changes its first and last rectangle but reports
+ * only the first one as damage, the way a blur group sees a damaged
+ * texture.  Returns whether only the first one changed on the screen.
+ * Then moves the first one and reports its new place as damage, and
+ * checks that it disappears from the old one. */
+static gboolean
+measure_damage (ClutterActor *stage, ClutterActor *group,
+                ClutterEffect *effect, guint levels, guint blur)
+{
+  static const ClutterColor white = { 255, 255, 255, 255 };
+  ClutterActor *damaged, *undamaged;
+  ClutterColor color[2];
+  cairo_rectangle_int_t area;
+  guint before[2], after[2];
+  gboolean ok, moved_ok;
+  gfloat x, y;
+  gint64 start;
+
+  damaged = clutter_actor_get_first_child (group);
+  undamaged = clutter_actor_get_last_child (group);
+
+  tidy_blur_effect_set_pyramid_levels (effect, levels);
+  tidy_blur_effect_set_blur (effect, blur);
+  tidy_blur_effect_invalidate (effect);
+  /* Let the effect see where @damaged is. */
+  tidy_blur_effect_queue_invalidate (effect, damaged);
+  clutter_actor_queue_redraw (group);
+
+  clutter_actor_get_background_color (damaged, &color[0]);
+  clutter_actor_get_background_color (undamaged, &color[1]);
+  clutter_actor_get_position (undamaged, &x, &y);
+  before[0] = read_pixel (stage, 20, 20);
+  before[1] = read_pixel (stage, x + 20, y + 20);
+
+  clutter_actor_set_background_color (damaged, &white);
+  clutter_actor_set_background_color (undamaged, &white);
+  tidy_blur_effect_queue_invalidate (effect, damaged);
+  area.x = area.y = 0;
+  area.width = area.height = 40;
+  tidy_blur_effect_add_damage (effect, damaged, &area);
+
+  hd_stats_reset ();
+  start = hd_stats_now ();
+  after[0] = read_pixel (stage, 20, 20);
+  after[1] = read_pixel (stage, x + 20, y + 20);
+  ok = after[0] != before[0] && after[1] == before[1];
+  printf ("%-9s %4u %7u %8s %9.3f damage %s\n",
+          levels ? "pyramid" : "iterative", blur,
+          hd_stats_get_count (HD_STATS_BLUR_PASSES), "",
+          (hd_stats_now () - start) / 1000.0, ok ? "ok" : "FAILED");
+
+  /* Move it two rectangles to the right.  Only its new place is damaged,
+   * but its old place must be re-blurred too. */
+  before[0] = after[0];
+  clutter_actor_set_position (damaged, 80, 0);
+  tidy_blur_effect_queue_invalidate (effect, damaged);
+  area.x = 80;
+  tidy_blur_effect_add_damage (effect, damaged, &area);
+
+  hd_stats_reset ();
+  start = hd_stats_now ();
+  after[0] = read_pixel (stage, 20, 20);
+  moved_ok = after[0] != before[0];
+  printf ("%-9s %4u %7u %8s %9.3f move %s\n",
+          levels ? "pyramid" : "iterative", blur,
+          hd_stats_get_count (HD_STATS_BLUR_PASSES), "",
+          (hd_stats_now () - start) / 1000.0, moved_ok ? "ok" : "FAILED");
+
+  clutter_actor_set_position (damaged, 0, 0);
+  clutter_actor_set_background_color (damaged, &color[0]);
+  clutter_actor_set_background_color (undamaged, &color[1]);
+  return ok && moved_ok;
+}
+
+int
+main (int argc, char **argv)
+{
+  ClutterActor *stage, *group;
+  ClutterEffect *effect;
+  guint frames, max_blur, blur;
+  gboolean ok;
+
+  if (clutter_init (&argc, &argv) != CLUTTER_INIT_SUCCESS)
+    return 1;
+
+  frames = argc > 1 ? atoi (argv[1]) : 50;
+  max_blur = argc > 2 ? atoi (argv[2]) : 16;
+
+  stage = clutter_stage_get_default ();
+  clutter_actor_set_size (stage, AREAW, AREAH);
+  clutter_actor_show (stage);
+
+  group = create_scene (stage);
+  effect = tidy_blur_effect_new ();
+  clutter_actor_add_effect (group, effect);
+
+  printf ("%-9s %4s %7s %8s %9s\n",
+          "mode", "blur", "passes", "blur ms", "frame ms");
+  measure (stage, group, effect, 0, 0, frames);
+  for (blur = 1; blur <= max_blur; blur++)
+    measure (stage, group, effect, 0, blur, frames);
+  for (blur = 1; blur <= max_blur; blur++)
+    measure (stage, group, effect, 6, blur, frames);
+
+  ok = measure_damage (stage, group, effect, 0, 4);
+  ok &= measure_damage (stage, group, effect, 6, 4);
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,466 @@
+/* Scripted benchmark of the compositor: drives a running hildon-desktop
+ * through a fixed set of scenarios with X requests, XTest input and D-Bus
+ * signals, and after each one fetches its frame statistics with
+ * GetFrameStats.  The report has one "<scenario> <metric> <value>" line
+ * per measurement, so reports of two builds can be diffed or joined.
+ *   ./test-compositor-bench [windows] [repeats]
+ * The scenarios are:
+ *   stack     map @windows stackable windows one by one
+ *   tasknav   enter and leave the task navigator @repeats times
+ *   launcher  open the launcher and scroll it up and down @repeats times
+ *   rotate    request portrait and landscape @repeats times
+ *   live-bg   animate a live background for @repeats seconds
+ * Besides the histograms and counters of hd-stats every scenario reports
+ * its wall time and the CPU time hildon-desktop used meanwhile.  If
+ * hildon-desktop didn't change state as many times as a scenario asked it
+ * to, the scenario is reported as "<scenario> failed 1" and we exit with
+ * an error, because its numbers are of an idle compositor.  It's meant to
+ * be run by run-compositor-bench.sh on a headless box, but works against
+ * any hildon-desktop on $DISPLAY and the session bus. */
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XTest.h>
+#include <dbus/dbus.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/* HDRMStateEnum */
+#define STATE_HOME      (1 << 0)
+#define STATE_APP       (1 << 4)
+#define STATE_TASK_NAV  (1 << 6)
+#define STATE_LAUNCHER  (1 << 7)
+
+#define MAX_WINDOWS     64
+
+static Display *Dpy;
+static DBusConnection *Bus;
+static unsigned Compositor_pid;
+static int Scrw, Scrh;
+static int Failed;
+
+static double now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Returns the user+system CPU time of hildon-desktop in milliseconds. */
+static double cpu_ms (void)
+{
+  char fname[64], buf[1024], *p;
+  unsigned long utime, stime;
+  FILE *f;
+
+  snprintf (fname, sizeof (fname), "/proc/%u/stat", Compositor_pid);
+  if (!(f = fopen (fname, "r")))
+    return 0;
+  p = fgets (buf, sizeof (buf), f);
+  fclose (f);
+
+  /* Skip the command name, it can have spaces. */
+  if (!p || !(p = strrchr (buf, ')'))
+      || sscanf (p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                 &utime, &stime) != 2)
+    return 0;
+  return (utime + stime) * 1000.0 / sysconf (_SC_CLK_TCK);
+}
+
+/* Handles X events for @secs seconds, so hildon-desktop can finish what
+ * it's doing. */
+static void settle (double secs)
+{
+  double until = now () + secs;
+
+  while (now () < until)
+    {
+      while (XPending (Dpy))
+        {
+          XEvent ev;
+          XNextEvent (Dpy, &ev);
+        }
+      usleep (5000);
+    }
+}
+
+static void wait_for_map (Window w)
+{
+  double until = now () + 5;
+  XEvent ev;
+
+  while (now () < until)
+    {
+      if (XCheckTypedWindowEvent (Dpy, w, MapNotify, &ev))
+        return;
+      usleep (5000);
+    }
+  fprintf (stderr, "window 0x%lx was not mapped\n", w);
+}
+
+static void set_card_prop (Window w, const char *name, Atom type, long value)
+{
+  XChangeProperty (Dpy, w, XInternAtom (Dpy, name, False), type, 32,
+                   PropModeReplace, (unsigned char *) &value, 1);
+}
+
+static Window create_window (const char *title, int stack_index)
+{
+  Window w;
+  Atom type;
+  XClassHint class = { "test-compositor-bench", "TestCompositorBench" };
+
+  w = XCreateSimpleWindow (Dpy, DefaultRootWindow (Dpy), 0, 0, Scrw, Scrh,
+                           0, 0, WhitePixel (Dpy, DefaultScreen (Dpy)));
+  XStoreName (Dpy, w, title);
+  XSetClassHint (Dpy, w, &class);
+  type = XInternAtom (Dpy, "_NET_WM_WINDOW_TYPE_NORMAL", False);
+  XChangeProperty (Dpy, w, XInternAtom (Dpy, "_NET_WM_WINDOW_TYPE", False),
+                   XA_ATOM, 32, PropModeReplace, (unsigned char *) &type, 1);
+  if (stack_index >= 0)
+    set_card_prop (w, "_HILDON_STACKABLE_WINDOW", XA_INTEGER, stack_index);
+  XSelectInput (Dpy, w, StructureNotifyMask | ExposureMask);
+  return w;
+}
+
+/* Fills @w with something to look at, different for every @frame. */
+static void draw (Window w, GC gc, int frame)
+{
+  int i;
+
+  for (i = 0; i < 8; i++)
+    {
+      XSetForeground (Dpy, gc, ((frame + i) * 0x3050a0) & 0xffffff);
+      XFillRectangle (Dpy, w, gc, (frame * 8 + i * Scrw / 8) % Scrw,
+                      i * Scrh / 8, Scrw / 8, Scrh / 8);
+    }
+}
+
+static void send_state (int state)
+{
+  DBusMessage *msg;
+  dbus_int32_t arg = state;
+
+  msg = dbus_message_new_signal ("/com/nokia/hildon_desktop",
+                                 "com.nokia.hildon_desktop", "set_state");
+  dbus_message_append_args (msg, DBUS_TYPE_INT32, &arg, DBUS_TYPE_INVALID);
+  dbus_connection_send (Bus, msg, NULL);
+  dbus_connection_flush (Bus);
+  dbus_message_unref (msg);
+}
+
+/* Returns GetFrameStats(@reset) as a string to free(), or NULL. */
+static char *get_frame_stats (int reset)
+{
+  DBusMessage *msg, *reply;
+  dbus_bool_t arg = reset;
+  const char *str;
+  char *ret;
+  DBusError err;
+
+  msg = dbus_message_new_method_call ("com.nokia.HildonDesktop.Home",
+                                      "/com/nokia/HildonDesktop/Home",
+                                      "com.nokia.HildonDesktop.Home",
+                                      "GetFrameStats");
+  dbus_message_append_args (msg, DBUS_TYPE_BOOLEAN, &arg, DBUS_TYPE_INVALID);
+  dbus_error_init (&err);
+  reply = dbus_connection_send_with_reply_and_block (Bus, msg, 10000, &err);
+  dbus_message_unref (msg);
+  if (!reply)
+    {
+      fprintf (stderr, "GetFrameStats: %s\n", err.message);
+      dbus_error_free (&err);
+      return NULL;
+    }
+
+  ret = dbus_message_get_args (reply, &err, DBUS_TYPE_STRING, &str,
+                               DBUS_TYPE_INVALID) ? strdup (str) : NULL;
+  dbus_error_free (&err);
+  dbus_message_unref (reply);
+  return ret;
+}
+
+static unsigned get_compositor_pid (void)
+{
+  DBusMessage *msg, *reply;
+  const char *name = "com.nokia.HildonDesktop.Home";
+  dbus_uint32_t pid = 0;
+  DBusError err;
+
+  msg = dbus_message_new_method_call (DBUS_SERVICE_DBUS, DBUS_PATH_DBUS,
+                                      DBUS_INTERFACE_DBUS,
+                                      "GetConnectionUnixProcessID");
+  dbus_message_append_args (msg, DBUS_TYPE_STRING, &name, DBUS_TYPE_INVALID);
+  dbus_error_init (&err);
+  reply = dbus_connection_send_with_reply_and_block (Bus, msg, 10000, &err);
+  dbus_message_unref (msg);
+  if (reply)
+    {
+      dbus_message_get_args (reply, &err, DBUS_TYPE_UINT32, &pid,
+                             DBUS_TYPE_INVALID);
+      dbus_message_unref (reply);
+    }
+  dbus_error_free (&err);
+  return pid;
+}
+
+/* Prints the hd-stats text @stats as report lines of @scenario.
+ *   name: n=N avg=Aus p50=Bus p95=Cus p99=Dus max=Eus
+ * becomes name.n, name.avg_us etc., and "name: N" stays as it is.
+ * Returns the number of state changes in @stats. */
+static unsigned report_stats (const char *scenario, char *stats)
+{
+  unsigned state_changes = 0;
+  char *line, *next;
+
+  for (line = stats; line && *line; line = next)
+    {
+      char name[64];
+      long long n, avg, p50, p95, p99, max;
+      double period, rate;
+      unsigned count;
+
+      if ((next = strchr (line, '\n')))
+        *next++ = '\0';
+
+      if (sscanf (line, "period: %lfs, redraws/s: %lf", &period, &rate) == 2)
+        printf ("%s redraws_per_s %.1f\n", scenario, rate);
+      else if (sscanf (line, "%63[^:]: n=%lld avg=%lldus p50=%lldus "
+                       "p95=%lldus p99=%lldus max=%lldus",
+                       name, &n, &avg, &p50, &p95, &p99, &max) == 7)
+        {
+          printf ("%s %s.n %lld\n", scenario, name, n);
+          printf ("%s %s.avg_us %lld\n", scenario, name, avg);
+          printf ("%s %s.p50_us %lld\n", scenario, name, p50);
+          printf ("%s %s.p95_us %lld\n", scenario, name, p95);
+          printf ("%s %s.p99_us %lld\n", scenario, name, p99);
+          printf ("%s %s.max_us %lld\n", scenario, name, max);
+        }
+      else if (sscanf (line, "%63[^:]: %u", name, &count) == 2)
+        {
+          printf ("%s %s %u\n", scenario, name, count);
+          if (!strcmp (name, "state-changes"))
+            state_changes = count;
+        }
+    }
+
+  return state_changes;
+}
+
+/* Runs @run(@arg) as @scenario and reports what it cost.  It fails
+ * unless hildon-desktop changed state at least @state_changes times. */
+static void measure (const char *scenario, void (*run) (int), int arg,
+                     unsigned state_changes)
+{
+  unsigned changed = 0;
+  double start, cpu;
+  char *stats;
+
+  settle (1);
+  free (get_frame_stats (1));
+  cpu = cpu_ms ();
+  start = now ();
+
+  run (arg);
+
+  stats = get_frame_stats (1);
+  printf ("%s wall_ms %.0f\n", scenario, (now () - start) * 1000);
+  printf ("%s cpu_ms %.0f\n", scenario, cpu_ms () - cpu);
+  if (stats)
+    {
+      changed = report_stats (scenario, stats);
+      free (stats);
+    }
+  if (changed < state_changes)
+    {
+      fprintf (stderr, "%s: hildon-desktop changed state %u times "
+               "instead of %u, is it listening to set_state?\n",
+               scenario, changed, state_changes);
+      printf ("%s failed 1\n", scenario);
+      Failed = 1;
+    }
+  fflush (stdout);
+}
+
+static Window Windows[MAX_WINDOWS];
+static int N_windows;
+
+static void scenario_stack (int n)
+{
+  GC gc;
+  int i;
+
+  for (i = 0; i < n; i++)
+    {
+      char title[32];
+
+      snprintf (title, sizeof (title), "bench %d", i);
+      Windows[i] = create_window (title, i);
+      XMapWindow (Dpy, Windows[i]);
+      wait_for_map (Windows[i]);
+      gc = XCreateGC (Dpy, Windows[i], 0, NULL);
+      draw (Windows[i], gc, i);
+      XFreeGC (Dpy, gc);
+      XFlush (Dpy);
+      settle (0.5);
+    }
+  N_windows = n;
+}
+
+static void scenario_tasknav (int repeats)
+{
+  int i;
+
+  for (i = 0; i < repeats; i++)
+    {
+      send_state (STATE_TASK_NAV);
+      settle (0.8);
+      send_state (STATE_APP);
+      settle (0.8);
+    }
+}
+
+/* Drags the pointer from (@x, @y0) to (@x, @y1) in 60 Hz steps. */
+static void drag (int x, int y0, int y1)
+{
+  int i, steps = 20;
+
+  XTestFakeMotionEvent (Dpy, -1, x, y0, 0);
+  XTestFakeButtonEvent (Dpy, 1, True, 0);
+  XFlush (Dpy);
+  for (i = 1; i <= steps; i++)
+    {
+      usleep (16000);
+      XTestFakeMotionEvent (Dpy, -1, x, y0 + (y1 - y0) * i / steps, 0);
+      XFlush (Dpy);
+    }
+  XTestFakeButtonEvent (Dpy, 1, False, 0);
+  XFlush (Dpy);
+}
+
+static void scenario_launcher (int repeats)
+{
+  int i;
+
+  send_state (STATE_LAUNCHER);
+  settle (1);
+  for (i = 0; i < repeats; i++)
+    {
+      drag (Scrw / 2, Scrh * 3 / 4, Scrh / 4);
+      settle (1);
+      drag (Scrw / 2, Scrh / 4, Scrh * 3 / 4);
+      settle (1);
+    }
+  send_state (N_windows ? STATE_APP : STATE_HOME);
+  settle (1);
+}
+
+static void scenario_rotate (int repeats)
+{
+  Window w;
+  int i;
+
+  /* The topmost window decides the orientation. */
+  w = N_windows ? Windows[N_windows - 1] : None;
+  if (!w)
+    return;
+
+  set_card_prop (w, "_HILDON_PORTRAIT_MODE_SUPPORT", XA_CARDINAL, 1);
+  for (i = 0; i < repeats; i++)
+    {
+      set_card_prop (w, "_HILDON_PORTRAIT_MODE_REQUEST", XA_CARDINAL, 1);
+      XFlush (Dpy);
+      settle (2);
+      set_card_prop (w, "_HILDON_PORTRAIT_MODE_REQUEST", XA_CARDINAL, 0);
+      XFlush (Dpy);
+      settle (2);
+    }
+}
+
+static void scenario_live_bg (int seconds)
+{
+  Window w;
+  Atom state;
+  double until;
+  GC gc;
+  int frame;
+
+  w = create_window ("bench live-bg", -1);
+  state = XInternAtom (Dpy, "_NET_WM_STATE_FULLSCREEN", False);
+  XChangeProperty (Dpy, w, XInternAtom (Dpy, "_NET_WM_STATE", False),
+                   XA_ATOM, 32, PropModeReplace, (unsigned char *) &state, 1);
+  set_card_prop (w, "_HILDON_LIVE_DESKTOP_BACKGROUND", XA_INTEGER, 1);
+  XMapWindow (Dpy, w);
+  wait_for_map (w);
+  send_state (STATE_HOME);
+  settle (1);
+
+  gc = XCreateGC (Dpy, w, 0, NULL);
+  until = now () + seconds;
+  for (frame = 0; now () < until; frame++)
+    {
+      draw (w, gc, frame);
+      XFlush (Dpy);
+      settle (1.0 / 60);
+    }
+  XFreeGC (Dpy, gc);
+  XDestroyWindow (Dpy, w);
+  XFlush (Dpy);
+}
+
+int main (int argc, char **argv)
+{
+  int windows, repeats, ev, err, major, minor, i;
+  DBusError dberr;
+
+  windows = argc > 1 ? atoi (argv[1]) : 10;
+  repeats = argc > 2 ? atoi (argv[2]) : 5;
+  if (windows <= 0 || windows > MAX_WINDOWS || repeats <= 0)
+    {
+      fprintf (stderr, "usage: %s [windows (1-%d)] [repeats]\n",
+               argv[0], MAX_WINDOWS);
+      return 1;
+    }
+
+  if (!(Dpy = XOpenDisplay (NULL)))
+    {
+      fprintf (stderr, "%s: couldn't open display\n", argv[0]);
+      return 1;
+    }
+  if (!XTestQueryExtension (Dpy, &ev, &err, &major, &minor))
+    {
+      fprintf (stderr, "%s: no XTest\n", argv[0]);
+      return 1;
+    }
+  Scrw = DisplayWidth (Dpy, DefaultScreen (Dpy));
+  Scrh = DisplayHeight (Dpy, DefaultScreen (Dpy));
+
+  dbus_error_init (&dberr);
+  if (!(Bus = dbus_bus_get (DBUS_BUS_SESSION, &dberr)))
+    {
+      fprintf (stderr, "%s: %s\n", argv[0], dberr.message);
+      return 1;
+    }
+  if (!(Compositor_pid = get_compositor_pid ()))
+    {
+      fprintf (stderr, "%s: hildon-desktop is not running\n", argv[0]);
+      return 1;
+    }
+
+  measure ("stack", scenario_stack, windows, 0);
+  measure ("tasknav", scenario_tasknav, repeats, 2 * repeats);
+  measure ("launcher", scenario_launcher, repeats, 2);
+  measure ("rotate", scenario_rotate, repeats, 0);
+  measure ("live-bg", scenario_live_bg, repeats, 0);
+
+  for (i = 0; i < N_windows; i++)
+    XDestroyWindow (Dpy, Windows[i]);
+  XCloseDisplay (Dpy);
+
+  return Failed;
+}
@@ -0,0 +1,280 @@
+/* Offline simulator of application prestarting: replays a launch trace
+ * against several prestart policies and prints how much launch latency
+ * each of them would have saved compared to not prestarting at all.
+ *   ./test-prestart-sim trace [budget-mb]
+ * The trace has one event per line, times in seconds:
+ *   <time> launch <app-id> <cold-ms> <warm-ms> <size-kb>
+ *   <time> close <app-id>
+ * where cold-ms and warm-ms are how long the first window of the app takes
+ * to appear when it's started from scratch and when it was prestarted.
+ * hildon-desktop records such a trace of the real use of the device if
+ * HILDON_DESKTOP_PRESTART_TRACE names the file to append it to.  Events
+ * needn't be in order; launches are logged when the window has appeared.
+ * After every event the simulator prestarts the apps the policy ranks best
+ * among those not running, as long as they fit in budget-mb (default 32),
+ * and kills the prestarted ones which don't make it anymore.  Every app of
+ * the trace is taken as prestartable, and prestarting is instantaneous. */
+
+#include <glib.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "launcher/hd-prestart-policy.h"
+
+typedef enum
+{
+  POLICY_NONE,      /* never prestart */
+  POLICY_ORDER,     /* in the order the apps first appeared */
+  POLICY_FREQUENCY, /* the most often launched first */
+  POLICY_SCORE,     /* hd_prestart_policy_score() */
+  N_POLICIES
+} Policy;
+
+static const gchar *Policy_names[N_POLICIES] =
+  { "none", "order", "frequency", "score" };
+
+typedef struct
+{
+  gint64 time;
+  guint seq;
+  gboolean launch;
+  guint app;
+} Event;
+
+typedef struct
+{
+  gchar *id;
+  guint order;
+  guint cold_ms, warm_ms, size_kb;
+
+  /* Simulation state. */
+  gboolean seen, running, prestarted;
+  gdouble rank;
+} App;
+
+static GArray *Events;
+static GPtrArray *Apps;
+
+static guint
+find_app (const gchar *id)
+{
+  guint i;
+
+  for (i = 0; i < Apps->len; i++)
+    if (!strcmp (((App *)Apps->pdata[i])->id, id))
+      return i;
+
+  g_ptr_array_add (Apps, g_new0 (App, 1));
+  ((App *)Apps->pdata[i])->id = g_strdup (id);
+  ((App *)Apps->pdata[i])->order = i;
+  return i;
+}
+
+static gint
+cmp_time (gconstpointer a, gconstpointer b)
+{
+  const Event *event_a = a, *event_b = b;
+
+  /* Earlier first, then in the order of the trace. */
+  if (event_a->time != event_b->time)
+    return event_a->time < event_b->time ? -1 : 1;
+  return event_a->seq < event_b->seq ? -1 : event_a->seq > event_b->seq;
+}
+
+static gboolean
+load_trace (const gchar *fname)
+{
+  gchar *contents, **lines;
+  guint i;
+
+  if (!g_file_get_contents (fname, &contents, NULL, NULL))
+    return FALSE;
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i]; i++)
+    {
+      gdouble secs;
+      gchar what[16], id[256];
+      guint cold, warm, size;
+      Event event;
+      App *app;
+
+      if (lines[i][0] == '#'
+          || sscanf (lines[i], "%lf %15s %255s", &secs, what, id) != 3)
+        continue;
+
+      event.time = secs * G_USEC_PER_SEC;
+      event.seq = Events->len;
+      event.app = find_app (id);
+      event.launch = !strcmp (what, "launch");
+      app = Apps->pdata[event.app];
+      if (event.launch)
+        {
+          if (sscanf (lines[i], "%*f %*s %*s %u %u %u",
+                      &cold, &warm, &size) != 3)
+            {
+              fprintf (stderr, "%s:%u: bad launch\n", fname, i + 1);
+              continue;
+            }
+          app->cold_ms = cold;
+          app->warm_ms = warm;
+          app->size_kb = size;
+        }
+      g_array_append_val (Events, event);
+    }
+  g_strfreev (lines);
+  g_free (contents);
+  g_array_sort (Events, cmp_time);
+
+  return TRUE;
+}
+
+static gint
+cmp_rank (gconstpointer a, gconstpointer b)
+{
+  const App *app_a = *(App **)a, *app_b = *(App **)b;
+
+  /* Higher first, then in the order of appearance. */
+  if (app_a->rank != app_b->rank)
+    return app_a->rank > app_b->rank ? -1 : 1;
+  return app_a->order < app_b->order ? -1 : app_a->order > app_b->order;
+}
+
+/* Decides which apps are prestarted after an event at @now.
+ * Returns the number of apps newly prestarted. */
+static guint
+schedule (Policy policy, HdPrestartPolicy *history, gint64 now,
+          guint budget_kb)
+{
+  GPtrArray *candidates;
+  guint i, used_kb, started;
+
+  if (policy == POLICY_NONE)
+    return 0;
+
+  candidates = g_ptr_array_new ();
+  for (i = 0; i < Apps->len; i++)
+    {
+      App *app = Apps->pdata[i];
+
+      if (!app->seen || app->running)
+        continue;
+
+      if (policy == POLICY_ORDER)
+        app->rank = 0;
+      else if (policy == POLICY_FREQUENCY)
+        app->rank = hd_prestart_policy_frequency (history, app->id, now);
+      else
+        app->rank = hd_prestart_policy_score (history, app->id, now);
+      g_ptr_array_add (candidates, app);
+    }
+  g_ptr_array_sort (candidates, cmp_rank);
+
+  used_kb = started = 0;
+  for (i = 0; i < candidates->len; i++)
+    {
+      App *app = candidates->pdata[i];
+      guint size_kb = hd_prestart_policy_get_size (history, app->id);
+      gboolean fits = used_kb + size_kb <= budget_kb;
+
+      if (fits)
+        {
+          used_kb += size_kb;
+          if (!app->prestarted)
+            started++;
+        }
+      app->prestarted = fits;
+    }
+  g_ptr_array_free (candidates, TRUE);
+
+  return started;
+}
+
+static void
+simulate (Policy policy, guint budget_kb, gdouble *total_ms,
+          guint *launches, guint *prestarts)
+{
+  HdPrestartPolicy *history;
+  guint i;
+
+  for (i = 0; i < Apps->len; i++)
+    {
+      App *app = Apps->pdata[i];
+      app->seen = app->running = app->prestarted = FALSE;
+    }
+
+  *total_ms = 0;
+  *launches = *prestarts = 0;
+  history = hd_prestart_policy_new ();
+  for (i = 0; i < Events->len; i++)
+    {
+      const Event *event = &g_array_index (Events, Event, i);
+      App *app = Apps->pdata[event->app];
+
+      if (event->launch && !app->running)
+        {
+          guint ms = app->prestarted ? app->warm_ms : app->cold_ms;
+
+          hd_prestart_policy_launched (history, app->id, event->time,
+                                       app->prestarted
+                                       ? HD_PRESTART_LAUNCH_WARM
+                                       : HD_PRESTART_LAUNCH_COLD);
+          hd_prestart_policy_shown (history, app->id,
+                                    event->time + ms * 1000);
+          hd_prestart_policy_set_size (history, app->id, app->size_kb);
+
+          *total_ms += ms;
+          (*launches)++;
+          app->seen = app->running = TRUE;
+          app->prestarted = FALSE;
+        }
+      else if (!event->launch)
+        app->running = FALSE;
+
+      *prestarts += schedule (policy, history, event->time, budget_kb);
+    }
+  hd_prestart_policy_free (history);
+}
+
+int
+main (int argc, char **argv)
+{
+  guint budget_mb;
+  gdouble baseline_ms;
+  Policy policy;
+
+  if (argc < 2)
+    {
+      fprintf (stderr, "usage: %s <trace> [budget-mb]\n", argv[0]);
+      return 1;
+    }
+  budget_mb = argc > 2 ? atoi (argv[2]) : 32;
+
+  Events = g_array_new (FALSE, FALSE, sizeof (Event));
+  Apps = g_ptr_array_new ();
+  if (!load_trace (argv[1]))
+    {
+      fprintf (stderr, "%s: couldn't read %s\n", argv[0], argv[1]);
+      return 1;
+    }
+
+  printf ("%-9s %8s %8s %9s %9s\n",
+          "policy", "launches", "mean ms", "saved %", "prestarts");
+  baseline_ms = 0;
+  for (policy = 0; policy < N_POLICIES; policy++)
+    {
+      gdouble total_ms;
+      guint launches, prestarts;
+
+      simulate (policy, budget_mb * 1024, &total_ms, &launches, &prestarts);
+      if (policy == POLICY_NONE)
+        baseline_ms = total_ms;
+      printf ("%-9s %8u %8.1f %9.1f %9u\n", Policy_names[policy], launches,
+              launches ? total_ms / launches : 0.0,
+              baseline_ms ? 100 * (baseline_ms - total_ms) / baseline_ms : 0.0,
+              prestarts);
+    }
+
+  return 0;
+}
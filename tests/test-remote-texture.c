@@ -0,0 +1,239 @@
+/* Stub remote texture client pushing frames through a double-buffered
+ * memfd, to benchmark the SHM_FD/SWAP path of HdRemoteTexture.  The
+ * memfd must be sealed against shrinking or hildon-desktop rejects it.  Every frame is fully redrawn and damaged.
+ *   ./test-remote-texture [fps] [seconds] [width] [height]
+ * It prints how many frames it could push and how long it had to wait
+ * for hildon-desktop to release a buffer. */
+
+#define _GNU_SOURCE
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BPP 4
+
+static Atom shm_fd_atom, swap_atom, release_atom, show_atom, position_atom;
+
+static double now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int create_buffer (size_t size)
+{
+  int fd;
+
+  fd = memfd_create ("test-remote-texture", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd < 0)
+    return -1;
+
+  if (ftruncate (fd, size) < 0
+      || fcntl (fd, F_ADD_SEALS, F_SEAL_SHRINK) < 0)
+    {
+      close (fd);
+      return -1;
+    }
+  return fd;
+}
+
+static void send_message (Display *dpy, Window w, Atom type,
+                          long l0, long l1, long l2, long l3, long l4)
+{
+  XEvent ev;
+
+  memset (&ev, 0, sizeof (ev));
+  ev.xclient.type = ClientMessage;
+  ev.xclient.window = w;
+  ev.xclient.message_type = type;
+  ev.xclient.format = 32;
+  ev.xclient.data.l[0] = l0;
+  ev.xclient.data.l[1] = l1;
+  ev.xclient.data.l[2] = l2;
+  ev.xclient.data.l[3] = l3;
+  ev.xclient.data.l[4] = l4;
+  XSendEvent (dpy, w, False, StructureNotifyMask, &ev);
+}
+
+static void wait_until_ready (Display *dpy, Window w)
+{
+  Atom ready, type;
+  int format;
+  unsigned long items, left;
+  unsigned char *value;
+
+  ready = XInternAtom (dpy, "_HILDON_TEXTURE_CLIENT_READY", False);
+  for (;;)
+    {
+      XEvent ev;
+
+      value = NULL;
+      if (XGetWindowProperty (dpy, w, ready, 0, 1, False, XA_ATOM,
+                              &type, &format, &items, &left,
+                              &value) == Success && value)
+        {
+          XFree (value);
+          return;
+        }
+      XNextEvent (dpy, &ev);
+    }
+}
+
+/* Draws a gradient scrolling by @frame pixels. */
+static void draw (unsigned char *pixels, int width, int height, int frame)
+{
+  int x, y;
+
+  for (y = 0; y < height; y++)
+    {
+      unsigned char *p = pixels + y * width * BPP;
+
+      for (x = 0; x < width; x++, p += BPP)
+        {
+          p[0] = (x + frame) & 0xff;
+          p[1] = (y + frame) & 0xff;
+          p[2] = frame & 0xff;
+          p[3] = 0xff;
+        }
+    }
+}
+
+/* Handles the events which have arrived, blocking until there's one if
+ * @block.  Marks the released buffers in @free_buffers. */
+static void handle_events (Display *dpy, int block, int *free_buffers)
+{
+  while (block || XPending (dpy))
+    {
+      XEvent ev;
+
+      XNextEvent (dpy, &ev);
+      if (ev.type == ClientMessage
+          && ev.xclient.message_type == release_atom
+          && ev.xclient.data.l[0] >= 0 && ev.xclient.data.l[0] < 2)
+        {
+          free_buffers[ev.xclient.data.l[0]] = 1;
+          block = 0;
+        }
+    }
+}
+
+int main (int argc, char **argv)
+{
+  Display *dpy;
+  Window win;
+  Atom win_type, remote_texture;
+  long pid;
+  unsigned char *pixels;
+  size_t frame_size;
+  int fd, width, height, seconds, frames, free_buffers[2];
+  double fps, start, next, waited, max_wait;
+
+  fps = argc > 1 ? atof (argv[1]) : 60;
+  seconds = argc > 2 ? atoi (argv[2]) : 10;
+  width = argc > 3 ? atoi (argv[3]) : 800;
+  height = argc > 4 ? atoi (argv[4]) : 480;
+  if (fps <= 0 || seconds <= 0 || width <= 0 || height <= 0)
+    {
+      fprintf (stderr, "usage: %s [fps] [seconds] [width] [height]\n",
+               argv[0]);
+      return 1;
+    }
+
+  if (!(dpy = XOpenDisplay (NULL)))
+    {
+      fprintf (stderr, "%s: couldn't open display\n", argv[0]);
+      return 1;
+    }
+  shm_fd_atom = XInternAtom (dpy, "_HILDON_TEXTURE_CLIENT_MESSAGE_SHM_FD",
+                             False);
+  swap_atom = XInternAtom (dpy, "_HILDON_TEXTURE_CLIENT_MESSAGE_SWAP", False);
+  release_atom = XInternAtom (dpy, "_HILDON_TEXTURE_CLIENT_MESSAGE_RELEASE",
+                              False);
+  show_atom = XInternAtom (dpy, "_HILDON_TEXTURE_CLIENT_MESSAGE_SHOW", False);
+  position_atom = XInternAtom (dpy, "_HILDON_TEXTURE_CLIENT_MESSAGE_POSITION",
+                               False);
+
+  win = XCreateSimpleWindow (dpy, DefaultRootWindow (dpy),
+                             0, 0, width, height, 0, 0, 0);
+  win_type = XInternAtom (dpy, "_NET_WM_WINDOW_TYPE", False);
+  remote_texture = XInternAtom (dpy, "_HILDON_WM_WINDOW_TYPE_REMOTE_TEXTURE",
+                                False);
+  XChangeProperty (dpy, win, win_type, XA_ATOM, 32, PropModeReplace,
+                   (unsigned char *) &remote_texture, 1);
+  /* The SHM_FD message is only accepted from the owner of the window. */
+  pid = getpid ();
+  XChangeProperty (dpy, win, XInternAtom (dpy, "_NET_WM_PID", False),
+                   XA_CARDINAL, 32, PropModeReplace,
+                   (unsigned char *) &pid, 1);
+  XSelectInput (dpy, win, PropertyChangeMask);
+  XMapWindow (dpy, win);
+  wait_until_ready (dpy, win);
+
+  frame_size = (size_t) width * height * BPP;
+  if ((fd = create_buffer (2 * frame_size)) < 0)
+    {
+      perror ("create_buffer");
+      return 1;
+    }
+  pixels = mmap (NULL, 2 * frame_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                 fd, 0);
+  if (pixels == MAP_FAILED)
+    {
+      perror ("mmap");
+      return 1;
+    }
+
+  /* hildon-desktop starts showing the first frame. */
+  draw (pixels, width, height, 0);
+  send_message (dpy, win, shm_fd_atom, fd, width, height, BPP, getpid ());
+  send_message (dpy, win, position_atom, 0, 0, width, height, 0);
+  send_message (dpy, win, show_atom, 1, 255, 0, 0, 0);
+  XFlush (dpy);
+  free_buffers[0] = 0;
+  free_buffers[1] = 1;
+
+  waited = max_wait = 0;
+  start = next = now ();
+  for (frames = 1; now () - start < seconds; frames++)
+    {
+      double t;
+      int b;
+
+      t = now ();
+      handle_events (dpy, !free_buffers[0] && !free_buffers[1],
+                     free_buffers);
+      t = now () - t;
+      waited += t;
+      if (t > max_wait)
+        max_wait = t;
+
+      b = free_buffers[0] ? 0 : 1;
+      draw (pixels + b * frame_size, width, height, frames);
+      free_buffers[b] = 0;
+      send_message (dpy, win, swap_atom, b, 0, 0, width, height);
+      XFlush (dpy);
+
+      next += 1 / fps;
+      t = next - now ();
+      if (t > 0)
+        usleep (t * 1e6);
+    }
+
+  printf ("%dx%d: %d frames in %.1f s (%.1f fps, asked %.1f), "
+          "waited for release %.3f ms/frame, at most %.3f ms\n",
+          width, height, frames - 1, now () - start,
+          (frames - 1) / (now () - start), fps,
+          1000 * waited / (frames - 1), 1000 * max_wait);
+
+  return 0;
+}
@@ -12,7 +12,11 @@
 
 /* This just attempts to paint itself at FPS fps and outputs the actual fps it
    has managed. You can then run 'xresponse -i' to check 
-   how fast hildon-desktop is rendering it, or top to see CPU usage. */
+   how fast hildon-desktop is rendering it, or top to see CPU usage.
+   hildon-desktop's own frame timings are printed on SIGUSR1, or fetched with
+   dbus-send --print-reply --dest=com.nokia.HildonDesktop.Home
+     /com/nokia/HildonDesktop/Home com.nokia.HildonDesktop.Home.GetFrameStats
+     boolean:true */
 
 #define FPS 25
 